@@ -0,0 +1,18 @@
+#include "engine/mesh/cpu_skinning.hpp"
+#include <cstdlib>
+#include <string>
+
+// Usage: skinning_benchmark [vertices] [joints] [iterations]
+// Logs the throughput of CPU skinning against the reference implementation,
+// failing if the results differ.
+int main(int argc, char** argv) {
+  size_t vertices = argc > 1 ? std::stoull(argv[1]) : 1 << 20;
+  uint32_t joints = argc > 2 ? static_cast<uint32_t>(std::stoul(argv[2])) : 64;
+  uint32_t iterations =
+      argc > 3 ? static_cast<uint32_t>(std::stoul(argv[3])) : 10;
+
+  auto result =
+      engine::mesh::skinning::benchmark(vertices, joints, iterations);
+  return result.vertices > 0 && result.maxError < 1e-3f ? EXIT_SUCCESS
+                                                         : EXIT_FAILURE;
+}
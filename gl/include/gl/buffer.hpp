@@ -2,8 +2,14 @@
 
 #include <gl/bitflag.hpp>
 #include <gl/id.hpp>
+#include <gl/state_cache.hpp>
 #include <glad/glad.h>
 #include <limits>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace gl {
   class Buffer;
@@ -13,29 +19,41 @@ namespace gl {
     void* ptr;
     GLuint size;
     GLuint offset = 0;
+    bool flushExplicit = false;
+    /// <summary>
+    /// Written ranges not yet flushed, as offset and length, when mapped
+    /// with FLUSH_EXPLICIT.
+    /// </summary>
+    mutable std::vector<std::pair<GLuint, GLuint>> dirty;
 
   public:
     Mapping() = default;
     Mapping(gl::Buffer* buffer, void* ptr, GLuint size = 0, GLuint offset = 0,
-            bool persistent = false);
+            bool persistent = false, bool flushExplicit = false);
     ~Mapping();
 
     Mapping(const Mapping&) = delete;
     Mapping& operator=(const Mapping&) = delete;
     inline Mapping(Mapping&& o) noexcept
-        : buffer(o.buffer), ptr(o.ptr), size(o.size) {
+        : buffer(o.buffer), ptr(o.ptr), size(o.size), offset(o.offset),
+          flushExplicit(o.flushExplicit), dirty(std::move(o.dirty)) {
       o.buffer = nullptr;
       o.ptr = nullptr;
       o.size = 0;
+      o.offset = 0;
     }
     inline Mapping& operator=(Mapping&& o) noexcept {
       if (this != &o) {
         buffer = o.buffer;
         ptr = o.ptr;
         size = o.size;
+        offset = o.offset;
+        flushExplicit = o.flushExplicit;
+        dirty = std::move(o.dirty);
         o.buffer = nullptr;
         o.ptr = nullptr;
         o.size = 0;
+        o.offset = 0;
       }
       return *this;
     }
@@ -47,8 +65,35 @@ namespace gl {
     void* get() const;
 
     bool isPersistent() const;
+    /// <summary>
+    /// Whether writes must be flushed for the GPU to see them, tracked
+    /// by markDirty and flushed by flushDirty.
+    /// </summary>
+    inline bool isFlushExplicit() const { return flushExplicit; }
+    /// <summary>
+    /// Size of the mapped range in bytes.
+    /// </summary>
+    inline GLuint getSize() const { return size; }
     void write(const void* data, GLuint length, GLuint offset = 0) const;
+    /// <summary>
+    /// Flushes a range relative to the start of the mapping.
+    /// </summary>
     void flush(GLuint length, GLuint offset = 0) const;
+
+    /// <summary>
+    /// Records a range relative to the start of the mapping as written, for
+    /// the next flushDirty. write and MappingRef's writers call this, it is
+    /// only needed after writing through get. Does nothing unless mapped
+    /// with FLUSH_EXPLICIT. Not thread safe.
+    /// </summary>
+    void markDirty(GLuint offset, GLuint length) const;
+    /// <summary>
+    /// Flushes every range written since the last call, with overlapping
+    /// and adjacent ranges merged. Call once per frame, before the commands
+    /// reading the data.
+    /// </summary>
+    /// <returns>Number of flushes issued</returns>
+    size_t flushDirty();
   };
 
   class MappingRef {
@@ -85,6 +130,49 @@ namespace gl {
     }
 
     inline GLuint getOffset() const { return offset; }
+    /// <summary>
+    /// Number of bytes left in the mapping after this reference's offset.
+    /// </summary>
+    inline GLuint getSize() const {
+      auto size = mapping.getSize();
+      return offset < size ? size - offset : 0;
+    }
+
+    /// <summary>
+    /// Reserves count values of T at this reference's offset and advances
+    /// past them. The range is checked once for the whole batch, and the
+    /// values are then written in place in the mapped memory.
+    /// </summary>
+    /// <returns>The values, empty if they do not fit in the mapping</returns>
+    template <typename T> std::span<T> reserve(size_t count) {
+      static_assert(std::is_trivially_copyable_v<T>,
+                    "Only trivially copyable types can live in a buffer");
+      void* data = claim(static_cast<GLuint>(count * sizeof(T)), alignof(T));
+      if (data == nullptr) {
+        return {};
+      }
+      return std::span<T>(static_cast<T*>(data), count);
+    }
+
+    /// <summary>
+    /// Constructs a T in place at this reference's offset and advances past
+    /// it.
+    /// </summary>
+    /// <returns>The value, nullptr if it does not fit in the mapping</returns>
+    template <typename T, typename... Args> T* emplace(Args&&... args) {
+      auto values = reserve<T>(1);
+      if (values.empty()) {
+        return nullptr;
+      }
+      return std::construct_at(values.data(), std::forward<Args>(args)...);
+    }
+
+  private:
+    /// <summary>
+    /// Checks length bytes fit after the offset and advances past them.
+    /// </summary>
+    /// <returns>Pointer to the bytes, nullptr if they do not fit</returns>
+    void* claim(GLuint length, GLuint alignment);
   };
 
   /// <summary>
@@ -213,7 +301,7 @@ namespace gl {
     /// </summary>
     inline ~Buffer() {
       if (m_id != 0)
-        glDeleteBuffers(1, m_id);
+        gl::deleteBuffer(m_id);
     }
 
     /// <summary>
@@ -231,7 +319,7 @@ namespace gl {
 
     Buffer(Buffer&& other) noexcept {
       if (m_id != 0)
-        glDeleteBuffers(1, m_id);
+        gl::deleteBuffer(m_id);
 
       m_id = std::move(other.m_id);
       other.m_id = gl::Id(0);
@@ -239,7 +327,7 @@ namespace gl {
     Buffer& operator=(Buffer&& other) noexcept {
       if (this != &other) {
         if (m_id != 0)
-          glDeleteBuffers(1, m_id);
+          gl::deleteBuffer(m_id);
         m_id = std::move(other.m_id);
         other.m_id = gl::Id(0);
       }
@@ -320,7 +408,7 @@ namespace gl {
     /// </summary>
     /// <param name="target">Target to bind to.</param>
     inline void bind(BasicTargetBitFlag target) const {
-      glBindBuffer(target, m_id);
+      gl::StateCache::get().bindBuffer(target, m_id);
     }
 
     enum class StorageTarget {
@@ -336,7 +424,7 @@ namespace gl {
     /// <param name="target">Target to bind the buffer to.</param>
     /// <param name="index">Binding to bind the buffer at.</param>
     inline void bindBase(StorageTargetBitFlag target, GLuint index) const {
-      glBindBufferBase(target, index, m_id);
+      gl::StateCache::get().bindBufferBase(target, index, m_id);
     }
     /// <summary>
     /// Bind part of the buffer to the given target at the given index.
@@ -349,7 +437,8 @@ namespace gl {
     /// the offset. Must be at least GL_UNIFORM_BLOCK_SIZE_DATA.</param>
     inline void bindRange(StorageTargetBitFlag target, GLuint index,
                           GLuint offset, GLuint size) const {
-      glBindBufferRange(target, index, m_id, offset, size);
+      gl::StateCache::get().bindBufferRange(target, index, m_id, offset,
+                                            size);
     }
   };
 } // namespace gl
\ No newline at end of file
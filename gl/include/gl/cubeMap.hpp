@@ -1,6 +1,7 @@
 #pragma once
 
 #include "gl/id.hpp"
+#include <gl/state_cache.hpp>
 #include <gl/texture.hpp>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -20,20 +21,20 @@ namespace gl {
     inline CubeMap() { glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, _id); }
     inline ~CubeMap() {
       if (_id != 0)
-        glDeleteTextures(1, _id);
+        gl::deleteTexture(_id);
     }
     CubeMap(const CubeMap&) = delete;
     CubeMap& operator=(const CubeMap&) = delete;
     CubeMap(CubeMap&& other) noexcept {
       if (_id != 0)
-        glDeleteTextures(1, _id);
+        gl::deleteTexture(_id);
       _id = std::move(other._id);
       other._id = gl::Id(0);
     }
     CubeMap& operator=(CubeMap&& other) noexcept {
       if (this != &other) {
         if (_id != 0)
-          glDeleteTextures(1, _id);
+          gl::deleteTexture(_id);
 
         _id = std::move(other._id);
         other._id = 0;
@@ -61,7 +62,9 @@ namespace gl {
 
     inline void generateMipmaps() const { glGenerateTextureMipmap(_id); }
 
-    inline void bind(GLuint unit) const { glBindTextureUnit(unit, _id); }
+    inline void bind(GLuint unit) const {
+      gl::StateCache::get().bindTextureUnit(unit, _id);
+    }
 
     inline const gl::TextureHandle& createHandle() {
       RawTextureHandle rawHandle = glGetTextureHandleARB(_id);
@@ -17,11 +17,7 @@ namespace gl {
 
     Fence(const Fence&) = delete;
     Fence& operator=(const Fence&) = delete;
-    Fence(Fence&& other) noexcept {
-      if (fence != nullptr) {
-        glDeleteSync(fence);
-      }
-      fence = other.fence;
+    Fence(Fence&& other) noexcept : fence(other.fence) {
       other.fence = nullptr;
     }
     Fence& operator=(Fence&& other) noexcept {
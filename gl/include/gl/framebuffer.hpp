@@ -1,6 +1,7 @@
 #pragma once
 
 #include <gl/id.hpp>
+#include <gl/state_cache.hpp>
 #include <gl/texture.hpp>
 #include <glad/glad.h>
 
@@ -20,14 +21,14 @@ namespace gl {
     Framebuffer() { glCreateFramebuffers(1, m_id); }
     ~Framebuffer() {
       if (m_id != 0)
-        glDeleteFramebuffers(1, m_id);
+        gl::deleteFramebuffer(m_id);
     }
 
     Framebuffer(const Framebuffer&) = delete;
     Framebuffer& operator=(const Framebuffer&) = delete;
     Framebuffer(Framebuffer&& other) noexcept {
       if (m_id != 0)
-        glDeleteFramebuffers(1, m_id);
+        gl::deleteFramebuffer(m_id);
       m_id = std::move(other.m_id);
       other.m_id = gl::Id(0);
     }
@@ -35,7 +36,7 @@ namespace gl {
     Framebuffer& operator=(Framebuffer&& other) noexcept {
       if (this != &other) {
         if (m_id != 0)
-          glDeleteFramebuffers(1, m_id);
+          gl::deleteFramebuffer(m_id);
         m_id = std::move(other.m_id);
         other.m_id = gl::Id(0);
       }
@@ -83,23 +84,27 @@ namespace gl {
     /// <param name="target">Target to bind to. Defaults to GL_FRAMEBUFFER (Read
     /// and Draw)</param>
     void bind(GLenum target = GL_FRAMEBUFFER) const {
-      glBindFramebuffer(target, m_id);
+      gl::StateCache::get().bindFramebuffer(target, m_id);
     }
     /// <summary>
     /// Binds the framebuffer as the read framebuffer.
     /// </summary>
-    void bindRead() const { glBindFramebuffer(GL_READ_FRAMEBUFFER, m_id); }
+    void bindRead() const {
+      gl::StateCache::get().bindFramebuffer(GL_READ_FRAMEBUFFER, m_id);
+    }
     /// <summary>
     /// Binds the framebuffer as the draw framebuffer.
     /// </summary>
-    void bindDraw() const { glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_id); }
+    void bindDraw() const {
+      gl::StateCache::get().bindFramebuffer(GL_DRAW_FRAMEBUFFER, m_id);
+    }
     /// <summary>
     /// Unbinds all framebuffers from the given target.
     /// Returns to the default framebuffer.
     /// </summary>
     /// <param name="target"></param>
     static void unbind(GLenum target = GL_FRAMEBUFFER) {
-      glBindFramebuffer(target, 0);
+      gl::StateCache::get().bindFramebuffer(target, 0);
     }
 
     /// <summary>
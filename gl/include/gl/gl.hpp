@@ -9,7 +9,9 @@
 #include <gl/cubeMap.hpp>
 #include <gl/fence.hpp>
 #include <gl/framebuffer.hpp>
+#include <gl/query.hpp>
 #include <gl/shaders.hpp>
+#include <gl/state_cache.hpp>
 #include <gl/structs.hpp>
 #include <gl/texture.hpp>
 #include <gl/vao.hpp>
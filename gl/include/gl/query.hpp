@@ -0,0 +1,78 @@
+#pragma once
+
+#include <gl/id.hpp>
+
+namespace gl {
+  /// <summary>
+  /// Query object, e.g. GL_TIME_ELAPSED used with begin and end, or
+  /// GL_TIMESTAMP written with timestamp.
+  /// </summary>
+  class Query {
+    GLuint query = 0;
+    GLenum target;
+
+  public:
+    explicit Query(GLenum target) : target(target) {
+      glCreateQueries(target, 1, &query);
+    }
+
+    ~Query() {
+      if (query != 0) {
+        glDeleteQueries(1, &query);
+      }
+    }
+
+    Query(const Query&) = delete;
+    Query& operator=(const Query&) = delete;
+    Query(Query&& other) noexcept : query(other.query), target(other.target) {
+      other.query = 0;
+    }
+    Query& operator=(Query&& other) noexcept {
+      if (this != &other) {
+        if (query != 0) {
+          glDeleteQueries(1, &query);
+        }
+
+        query = other.query;
+        target = other.target;
+        other.query = 0;
+      }
+      return *this;
+    }
+
+    GLuint get() const { return query; }
+    operator GLuint() const { return query; }
+    GLenum getTarget() const { return target; }
+
+    void begin() const { glBeginQuery(target, query); }
+    void end() const { glEndQuery(target); }
+
+    /// <summary>
+    /// Records the GPU time once all previous commands have completed.
+    /// </summary>
+    void timestamp() const { glQueryCounter(query, GL_TIMESTAMP); }
+
+    /// <summary>
+    /// Whether result can be read without waiting for the GPU.
+    /// </summary>
+    bool available() const {
+      GLuint value = GL_FALSE;
+      glGetQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE, &value);
+      return value == GL_TRUE;
+    }
+
+    /// <summary>
+    /// The query's result, nanoseconds for timer queries. Waits for the GPU
+    /// if not yet available.
+    /// </summary>
+    GLuint64 result() const {
+      GLuint64 value = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &value);
+      return value;
+    }
+
+    void label(const char* name) const {
+      glObjectLabel(GL_QUERY, query, -1, name);
+    }
+  };
+} // namespace gl
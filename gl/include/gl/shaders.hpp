@@ -2,6 +2,7 @@
 
 #include <expected>
 #include <gl/id.hpp>
+#include <gl/state_cache.hpp>
 #include <glad/glad.h>
 #include <optional>
 #include <span>
@@ -79,7 +80,7 @@ namespace gl {
     explicit Program() = default;
     ~Program() {
       if (m_id != 0)
-        glDeleteProgram(m_id);
+        gl::deleteProgram(m_id);
     }
 
     Program(const Program&) = delete;
@@ -87,7 +88,7 @@ namespace gl {
 
     Program(Program&& other) noexcept {
       if (m_id != 0)
-        glDeleteProgram(m_id);
+        gl::deleteProgram(m_id);
       m_id = std::move(other.m_id);
       other.m_id = gl::Id(0);
     }
@@ -95,7 +96,7 @@ namespace gl {
     Program& operator=(Program&& other) noexcept {
       if (this != &other) {
         if (m_id != 0)
-          glDeleteProgram(m_id);
+          gl::deleteProgram(m_id);
         m_id = std::move(other.m_id);
         other.m_id = gl::Id(0);
       }
@@ -143,7 +144,7 @@ namespace gl {
     /// <summary>
     /// Binds the current program.
     /// </summary>
-    void bind() const { glUseProgram(m_id); }
+    void bind() const { gl::StateCache::get().useProgram(m_id); }
 
     /// <summary>
     /// Creates shaders from the given file paths and types, then links them
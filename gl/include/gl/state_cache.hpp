@@ -0,0 +1,175 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glad/glad.h>
+
+namespace gl {
+  /// <summary>
+  /// Shadow of the context's binding state, so binds that would not change
+  /// anything are skipped instead of reaching the driver. The wrappers bind
+  /// through it (Program, Vao, Framebuffer, Buffer, Texture, Sampler).
+  /// </summary>
+  /// <remarks>
+  /// One cache per thread, matching the thread's current context. GL calls
+  /// made around the wrappers (e.g. the ImGui renderer) must be followed by
+  /// invalidate. Deleting an object forgets its bindings, as GL unbinds it
+  /// and may reuse its name.
+  /// </remarks>
+  class StateCache {
+  public:
+    constexpr static uint32_t MAX_TEXTURE_UNITS = 32;
+    constexpr static uint32_t MAX_BUFFER_BINDINGS = 32;
+
+    struct Stats {
+      uint64_t issued = 0;
+      uint64_t skipped = 0;
+    };
+
+    /// <summary>
+    /// This thread's cache.
+    /// </summary>
+    static StateCache& get();
+
+    void useProgram(GLuint program);
+    /// <summary>
+    /// Binds a VAO. Binding the VAO a BindGuard released is skipped, it was
+    /// never unbound.
+    /// </summary>
+    void bindVertexArray(GLuint vao);
+    /// <summary>
+    /// Marks the bound VAO as no longer needed. It stays bound until another
+    /// VAO is, or until an element array buffer is bound outside one.
+    /// </summary>
+    void releaseVertexArray();
+    void bindFramebuffer(GLenum target, GLuint framebuffer);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                         GLintptr offset, GLsizeiptr size);
+    void bindTextureUnit(GLuint unit, GLuint texture);
+    void bindSampler(GLuint unit, GLuint sampler);
+
+    /// <summary>
+    /// Forgets all state, so every following bind is issued. Call after GL
+    /// calls that bypass the cache.
+    /// </summary>
+    void invalidate();
+
+    void onDeleteProgram(GLuint program);
+    void onDeleteVertexArray(GLuint vao);
+    void onDeleteFramebuffer(GLuint framebuffer);
+    void onDeleteBuffer(GLuint buffer);
+    void onDeleteTexture(GLuint texture);
+    void onDeleteSampler(GLuint sampler);
+
+    /// <summary>
+    /// Ends the frame's counting. Call once per frame.
+    /// </summary>
+    void newFrame();
+    /// <summary>
+    /// Calls issued and skipped during the last completed frame.
+    /// </summary>
+    const Stats& getFrameStats() const { return lastFrame; }
+    /// <summary>
+    /// Calls issued and skipped so far this frame.
+    /// </summary>
+    const Stats& getStats() const { return frame; }
+
+    /// <summary>
+    /// Disables skipping, issuing every call, to compare against.
+    /// </summary>
+    void setEnabled(bool enable);
+    bool isEnabled() const { return enabled; }
+
+  protected:
+    /// <summary>
+    /// Binding value the cache does not know, never equal to a real name.
+    /// </summary>
+    constexpr static GLuint UNKNOWN = ~0u;
+
+    /// <summary>
+    /// Non-indexed buffer targets the cache tracks.
+    /// </summary>
+    constexpr static uint32_t BUFFER_TARGETS = 12;
+
+    /// <summary>
+    /// Indexed buffer binding, size -1 when bound whole with bindBufferBase.
+    /// </summary>
+    struct RangeBinding {
+      GLuint buffer = UNKNOWN;
+      GLintptr offset = 0;
+      GLsizeiptr size = 0;
+
+      bool operator==(const RangeBinding&) const = default;
+    };
+
+    GLuint program = UNKNOWN;
+    GLuint vertexArray = UNKNOWN;
+    bool vertexArrayReleased = false;
+    GLuint readFramebuffer = UNKNOWN;
+    GLuint drawFramebuffer = UNKNOWN;
+    std::array<GLuint, BUFFER_TARGETS> buffers;
+    std::array<RangeBinding, MAX_BUFFER_BINDINGS> uniformBuffers;
+    std::array<RangeBinding, MAX_BUFFER_BINDINGS> storageBuffers;
+    std::array<GLuint, MAX_TEXTURE_UNITS> textures;
+    std::array<GLuint, MAX_TEXTURE_UNITS> samplers;
+
+    Stats frame;
+    Stats lastFrame;
+    bool enabled = true;
+
+    StateCache();
+
+    /// <summary>
+    /// Updates a cached value, counting the call.
+    /// </summary>
+    /// <returns>Whether the call must be issued</returns>
+    template <typename T> bool update(T& cached, const T& value) {
+      if (enabled && cached == value) {
+        ++frame.skipped;
+        return false;
+      }
+      cached = value;
+      ++frame.issued;
+      return true;
+    }
+
+    /// <summary>
+    /// Slot of a non-indexed buffer target, BUFFER_TARGETS if untracked.
+    /// </summary>
+    static uint32_t bufferSlot(GLenum target);
+    /// <summary>
+    /// Indexed bindings of a target, nullptr if untracked.
+    /// </summary>
+    std::array<RangeBinding, MAX_BUFFER_BINDINGS>*
+    rangeBindings(GLenum target);
+  };
+
+  // Delete an object and forget its bindings in this thread's cache
+
+  inline void deleteProgram(GLuint id) {
+    StateCache::get().onDeleteProgram(id);
+    glDeleteProgram(id);
+  }
+  inline void deleteVertexArray(GLuint id) {
+    StateCache::get().onDeleteVertexArray(id);
+    glDeleteVertexArrays(1, &id);
+  }
+  inline void deleteFramebuffer(GLuint id) {
+    StateCache::get().onDeleteFramebuffer(id);
+    glDeleteFramebuffers(1, &id);
+  }
+  inline void deleteBuffer(GLuint id) {
+    StateCache::get().onDeleteBuffer(id);
+    glDeleteBuffers(1, &id);
+  }
+  inline void deleteTexture(GLuint id) {
+    StateCache::get().onDeleteTexture(id);
+    glDeleteTextures(1, &id);
+  }
+  inline void deleteSampler(GLuint id) {
+    StateCache::get().onDeleteSampler(id);
+    glDeleteSamplers(1, &id);
+  }
+} // namespace gl
@@ -17,4 +17,17 @@ namespace gl {
     GLuint baseVertex;
     GLuint baseInstance;
   };
+
+  /// <summary>
+  /// Element types usable in an index buffer. Draws using different types
+  /// cannot share a MultiDraw call.
+  /// </summary>
+  enum class IndexType : GLenum {
+    U16 = GL_UNSIGNED_SHORT,
+    U32 = GL_UNSIGNED_INT,
+  };
+
+  constexpr inline GLuint indexTypeSize(IndexType type) {
+    return type == IndexType::U16 ? sizeof(GLushort) : sizeof(GLuint);
+  }
 } // namespace gl
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <cmath>
 #include <gl/attribs.hpp>
 #include <gl/id.hpp>
+#include <gl/state_cache.hpp>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
@@ -30,7 +31,7 @@ namespace gl {
     inline Sampler() { glCreateSamplers(1, m_id); }
     ~Sampler() {
       if (m_id != 0)
-        glDeleteSamplers(1, m_id);
+        gl::deleteSampler(m_id);
     }
     Sampler(const Sampler&) = delete;
     Sampler& operator=(const Sampler&) = delete;
@@ -42,8 +43,12 @@ namespace gl {
       glSamplerParameteri(m_id, pname, param);
     }
 
-    inline void bind(GLuint unit) const { glBindSampler(unit, m_id); }
-    inline static void unbind(GLuint unit) { glBindSampler(unit, 0); }
+    inline void bind(GLuint unit) const {
+      gl::StateCache::get().bindSampler(unit, m_id);
+    }
+    inline static void unbind(GLuint unit) {
+      gl::StateCache::get().bindSampler(unit, 0);
+    }
 
   protected:
     gl::Id m_id = gl::Id(0);
@@ -73,7 +78,7 @@ namespace gl {
 
     ~Texture() {
       if (m_id != 0)
-        glDeleteTextures(1, m_id);
+        gl::deleteTexture(m_id);
     }
 
     inline static GLint calcMipLevels(GLsizei width, GLsizei height) {
@@ -86,7 +91,7 @@ namespace gl {
     Texture& operator=(const Texture&) = delete;
     Texture(Texture&& other) noexcept {
       if (m_id == 0)
-        glDeleteTextures(1, m_id);
+        gl::deleteTexture(m_id);
       m_id = std::move(other.m_id);
       other.m_id = gl::Id(0);
     }
@@ -94,7 +99,7 @@ namespace gl {
     Texture& operator=(Texture&& other) noexcept {
       if (this != &other) {
         if (m_id != 0)
-          glDeleteTextures(1, m_id);
+          gl::deleteTexture(m_id);
         m_id = std::move(other.m_id);
         other.m_id = gl::Id(0);
       }
@@ -158,12 +163,16 @@ namespace gl {
     /// Binds the texture to the given texture unit.
     /// </summary>
     /// <param name="unit">Unit to bind to</param>
-    inline void bind(uint8_t unit) const { glBindTextureUnit(unit, m_id); }
+    inline void bind(uint8_t unit) const {
+      gl::StateCache::get().bindTextureUnit(unit, m_id);
+    }
     /// <summary>
     /// Unbinds all textures from the given texture unit.
     /// </summary>
     /// <param name="unit"></param>
-    inline static void unbind(GLenum unit) { glBindTextureUnit(unit, 0); }
+    inline static void unbind(GLenum unit) {
+      gl::StateCache::get().bindTextureUnit(unit, 0);
+    }
     /// <summary>
     /// Sets an integer texture parameter.
     /// </summary>
@@ -205,6 +214,22 @@ namespace gl {
                   GLsizei height, GLenum format, GLenum type,
                   const void* pixels) const;
     /// <summary>
+    /// Writes block compressed data to a sub-region of the texture. The
+    /// region must be aligned to the format's blocks, or reach the edge of
+    /// the level.
+    /// </summary>
+    /// <param name="level">Texture level</param>
+    /// <param name="xoffset">X Offset</param>
+    /// <param name="yoffset">Y Offset</param>
+    /// <param name="width">Width</param>
+    /// <param name="height">Height</param>
+    /// <param name="format">Compressed internal format of the storage</param>
+    /// <param name="imageSize">Size of the data in bytes</param>
+    /// <param name="data">Pointer to the compressed blocks</param>
+    void compressedSubImage(GLint level, GLint xoffset, GLint yoffset,
+                            GLsizei width, GLsizei height, GLenum format,
+                            GLsizei imageSize, const void* data) const;
+    /// <summary>
     /// Get the texture dimensions.
     /// </summary>
     /// <returns>Texture dimensions</returns>
@@ -222,9 +247,36 @@ namespace gl {
   protected:
     gl::Id m_id = gl::Id(0);
     Size m_size{};
+    gl::TextureHandle _handle = 0;
 
   public:
     TextureArray() { glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_id); }
+    ~TextureArray() {
+      if (m_id != 0)
+        gl::deleteTexture(m_id);
+    }
+
+    TextureArray(const TextureArray&) = delete;
+    TextureArray& operator=(const TextureArray&) = delete;
+    TextureArray(TextureArray&& other) noexcept
+        : m_id(std::move(other.m_id)), m_size(other.m_size),
+          _handle(other._handle) {
+      other.m_id = gl::Id(0);
+      other._handle = 0;
+    }
+    TextureArray& operator=(TextureArray&& other) noexcept {
+      if (this != &other) {
+        if (m_id != 0)
+          gl::deleteTexture(m_id);
+        m_id = std::move(other.m_id);
+        m_size = other.m_size;
+        _handle = other._handle;
+        other.m_id = gl::Id(0);
+        other._handle = 0;
+      }
+      return *this;
+    }
+
     TextureArray(Size size, GLenum format, GLenum internalFormat, void* data) {
       glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, m_id);
 
@@ -240,8 +292,12 @@ namespace gl {
 
     inline void generateMipmap() const { glGenerateTextureMipmap(m_id); }
 
-    void bind(uint8_t unit) const { glBindTextureUnit(unit, m_id); }
-    static void unbind(GLenum unit) { glBindTextureUnit(unit, 0); }
+    void bind(uint8_t unit) const {
+      gl::StateCache::get().bindTextureUnit(unit, m_id);
+    }
+    static void unbind(GLenum unit) {
+      gl::StateCache::get().bindTextureUnit(unit, 0);
+    }
     void setParameter(GLenum pname, GLint param) const {
       glTextureParameteri(m_id, pname, param);
     }
@@ -258,5 +314,16 @@ namespace gl {
     }
 
     const Size& size() const { return m_size; }
+
+    /// <summary>
+    /// Creates the bindless handle of the array, sampled as a
+    /// sampler2DArray. Parameters are frozen once the handle exists.
+    /// </summary>
+    inline const gl::TextureHandle& createHandle() {
+      _handle = TextureHandle(glGetTextureHandleARB(m_id));
+      return _handle;
+    }
+    inline TextureHandle handle() const { return _handle; }
+    inline RawTextureHandle rawHandle() const { return _handle.handle(); }
   };
 } // namespace gl
\ No newline at end of file
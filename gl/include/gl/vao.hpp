@@ -1,6 +1,7 @@
 #pragma once
 
 #include <gl/id.hpp>
+#include <gl/state_cache.hpp>
 #include <glad/glad.h>
 #include <optional>
 
@@ -26,20 +27,20 @@ namespace gl {
     /// </summary>
     inline ~Vao() {
       if (m_id != 0)
-        glDeleteVertexArrays(1, m_id);
+        gl::deleteVertexArray(m_id);
     }
     Vao(const Vao&) = delete;
     Vao& operator=(const Vao&) = delete;
     Vao(Vao&& other) noexcept {
       if (m_id != 0)
-        glDeleteVertexArrays(1, m_id);
+        gl::deleteVertexArray(m_id);
       m_id = std::move(other.m_id);
       other.m_id = gl::Id(0);
     }
     Vao& operator=(Vao&& other) noexcept {
       if (this != &other) {
         if (m_id != 0)
-          glDeleteVertexArrays(1, m_id);
+          gl::deleteVertexArray(m_id);
         m_id = std::move(other.m_id);
         other.m_id = gl::Id(0);
       }
@@ -54,7 +55,9 @@ namespace gl {
     /// <summary>
     /// Binds this VAO.
     /// </summary>
-    inline void bind() const { glBindVertexArray(m_id); }
+    inline void bind() const {
+      gl::StateCache::get().bindVertexArray(m_id);
+    }
     /// <summary>
     /// Unbinds all VAOs.
     /// </summary>
@@ -105,12 +108,13 @@ namespace gl {
     void label(const char name[]) const;
 
     /// <summary>
-    ///  RAII guard for unbinding a VAO.
+    ///  RAII guard for unbinding a VAO. The unbind is deferred by the state
+    ///  cache, so binding the same VAO again costs nothing.
     /// </summary>
     class BindGuard {
     public:
       BindGuard() = default;
-      ~BindGuard() { Vao::unbind(); }
+      ~BindGuard() { gl::StateCache::get().releaseVertexArray(); }
       BindGuard(const BindGuard&) = delete;
       BindGuard& operator=(const BindGuard&) = delete;
       BindGuard(BindGuard&&) = delete;
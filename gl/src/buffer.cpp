@@ -1,4 +1,5 @@
 #include "logger.hpp"
+#include <algorithm>
 #include <gl/buffer.hpp>
 
 namespace {
@@ -39,8 +40,9 @@ namespace {
 namespace gl {
 
   Mapping::Mapping(gl::Buffer* buffer, void* ptr, GLuint size, GLuint offset,
-                   bool persistent)
-      : buffer(buffer), ptr(ptr), size(size), offset(offset) {
+                   bool persistent, bool flushExplicit)
+      : buffer(buffer), ptr(ptr), size(size), offset(offset),
+        flushExplicit(flushExplicit) {
     if (persistent) {
       this->ptr = setPersistentBit(ptr);
     }
@@ -48,6 +50,7 @@ namespace gl {
 
   Mapping::~Mapping() {
     if (isValid() && !isPersistent()) {
+      flushDirty();
       buffer->unmap();
     }
   }
@@ -83,10 +86,78 @@ namespace gl {
 #endif
     char* dst = ptr + offset;
     memcpy(dst, data, length);
+    markDirty(offset, length);
+  }
+
+  void* MappingRef::claim(GLuint length, GLuint alignment) {
+    auto* base = static_cast<char*>(mapping.get());
+    if (base == nullptr) {
+      gl::Logger::error("Attempted to write to unmapped buffer");
+      return nullptr;
+    }
+    if (length > getSize()) {
+      gl::Logger::error("Attempted to write beyond mapped range");
+      return nullptr;
+    }
+
+    char* ptr = base + offset;
+#ifndef NDEBUG
+    if (reinterpret_cast<uintptr_t>(ptr) % alignment != 0) {
+      gl::Logger::warn("Mapped write at offset {} is not aligned to {}",
+                       offset, alignment);
+    }
+#endif
+    mapping.markDirty(offset, length);
+    offset += length;
+    return ptr;
   }
 
   void Mapping::flush(GLuint length, GLuint offset) const {
-    glFlushMappedNamedBufferRange(buffer->id(), offset + this->offset, length);
+    // The range is relative to the mapping, not the buffer
+    glFlushMappedNamedBufferRange(buffer->id(), offset, length);
+  }
+
+  void Mapping::markDirty(GLuint offset, GLuint length) const {
+    if (!flushExplicit || length == 0) {
+      return;
+    }
+
+    // Sequential writes extend the last range instead of adding one
+    if (!dirty.empty()) {
+      auto& [lastOffset, lastLength] = dirty.back();
+      if (offset >= lastOffset && offset <= lastOffset + lastLength) {
+        lastLength = std::max(lastLength, offset + length - lastOffset);
+        return;
+      }
+    }
+    dirty.emplace_back(offset, length);
+  }
+
+  size_t Mapping::flushDirty() {
+    if (dirty.empty()) {
+      return 0;
+    }
+
+    std::sort(dirty.begin(), dirty.end());
+    size_t flushes = 0;
+    auto [start, end] = dirty.front();
+    end += start;
+    for (size_t i = 1; i < dirty.size(); ++i) {
+      auto [offset, length] = dirty[i];
+      if (offset <= end) {
+        end = std::max(end, offset + length);
+        continue;
+      }
+      flush(end - start, start);
+      ++flushes;
+      start = offset;
+      end = offset + length;
+    }
+    flush(end - start, start);
+    ++flushes;
+
+    dirty.clear();
+    return flushes;
   }
 
   void gl::Buffer::init(GLuint size, const void* data, UsageBitFlag flags) {
@@ -113,7 +184,8 @@ namespace gl {
     auto ptr = glMapNamedBufferRange(m_id, offset, length, flags);
 
     return gl::Mapping(this, ptr, length, offset,
-                       (flags & GL_MAP_PERSISTENT_BIT) != 0);
+                       (flags & GL_MAP_PERSISTENT_BIT) != 0,
+                       (flags & GL_MAP_FLUSH_EXPLICIT_BIT) != 0);
   }
 
   inline void gl::Buffer::unmap() {
@@ -125,7 +197,9 @@ namespace gl {
     glUnmapNamedBuffer(m_id);
   }
 
-  void gl::Buffer::unbind(GLenum target) { glBindBuffer(target, 0); }
+  void gl::Buffer::unbind(GLenum target) {
+    gl::StateCache::get().bindBuffer(target, 0);
+  }
 
   void gl::Buffer::label(const char name[]) const {
     glObjectLabel(GL_BUFFER, m_id, -1, name);
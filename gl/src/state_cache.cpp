@@ -0,0 +1,243 @@
+#include <gl/state_cache.hpp>
+
+namespace gl {
+  StateCache::StateCache() { invalidate(); }
+
+  StateCache& StateCache::get() {
+    thread_local StateCache cache;
+    return cache;
+  }
+
+  void StateCache::useProgram(GLuint id) {
+    if (update(program, id)) {
+      glUseProgram(id);
+    }
+  }
+
+  void StateCache::bindVertexArray(GLuint vao) {
+    vertexArrayReleased = false;
+    if (update(vertexArray, vao)) {
+      glBindVertexArray(vao);
+    }
+  }
+
+  void StateCache::releaseVertexArray() {
+    if (!enabled) {
+      bindVertexArray(0);
+      return;
+    }
+    vertexArrayReleased = true;
+    ++frame.skipped;
+  }
+
+  void StateCache::bindFramebuffer(GLenum target, GLuint framebuffer) {
+    if (target == GL_FRAMEBUFFER) {
+      // Binds both read and draw
+      if (enabled && readFramebuffer == framebuffer &&
+          drawFramebuffer == framebuffer) {
+        ++frame.skipped;
+        return;
+      }
+      readFramebuffer = drawFramebuffer = framebuffer;
+      ++frame.issued;
+      glBindFramebuffer(target, framebuffer);
+      return;
+    }
+
+    auto& bound =
+        target == GL_READ_FRAMEBUFFER ? readFramebuffer : drawFramebuffer;
+    if (update(bound, framebuffer)) {
+      glBindFramebuffer(target, framebuffer);
+    }
+  }
+
+  void StateCache::bindBuffer(GLenum target, GLuint buffer) {
+    if (target == GL_ELEMENT_ARRAY_BUFFER) {
+      // Part of the bound VAO, so the released one must really be unbound
+      if (vertexArrayReleased && vertexArray != 0) {
+        bindVertexArray(0);
+      }
+      ++frame.issued;
+      glBindBuffer(target, buffer);
+      return;
+    }
+
+    auto slot = bufferSlot(target);
+    if (slot == BUFFER_TARGETS) {
+      ++frame.issued;
+      glBindBuffer(target, buffer);
+      return;
+    }
+    if (update(buffers[slot], buffer)) {
+      glBindBuffer(target, buffer);
+    }
+  }
+
+  void StateCache::bindBufferBase(GLenum target, GLuint index, GLuint buffer) {
+    // Binding the whole buffer, GL's size for it is -1
+    bindBufferRange(target, index, buffer, 0, -1);
+  }
+
+  void StateCache::bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                   GLintptr offset, GLsizeiptr size) {
+    auto* bindings = rangeBindings(target);
+    if (bindings != nullptr && index < MAX_BUFFER_BINDINGS) {
+      RangeBinding binding{.buffer = buffer, .offset = offset, .size = size};
+      if (!update((*bindings)[index], binding)) {
+        return;
+      }
+    } else {
+      ++frame.issued;
+    }
+
+    if (size < 0) {
+      glBindBufferBase(target, index, buffer);
+    } else {
+      glBindBufferRange(target, index, buffer, offset, size);
+    }
+    // Also binds the target's generic binding point
+    if (auto slot = bufferSlot(target); slot != BUFFER_TARGETS) {
+      buffers[slot] = buffer;
+    }
+  }
+
+  void StateCache::bindTextureUnit(GLuint unit, GLuint texture) {
+    if (unit >= MAX_TEXTURE_UNITS) {
+      ++frame.issued;
+      glBindTextureUnit(unit, texture);
+      return;
+    }
+    if (update(textures[unit], texture)) {
+      glBindTextureUnit(unit, texture);
+    }
+  }
+
+  void StateCache::bindSampler(GLuint unit, GLuint sampler) {
+    if (unit >= MAX_TEXTURE_UNITS) {
+      ++frame.issued;
+      glBindSampler(unit, sampler);
+      return;
+    }
+    if (update(samplers[unit], sampler)) {
+      glBindSampler(unit, sampler);
+    }
+  }
+
+  void StateCache::invalidate() {
+    program = UNKNOWN;
+    vertexArray = UNKNOWN;
+    vertexArrayReleased = false;
+    readFramebuffer = UNKNOWN;
+    drawFramebuffer = UNKNOWN;
+    buffers.fill(UNKNOWN);
+    uniformBuffers.fill({});
+    storageBuffers.fill({});
+    textures.fill(UNKNOWN);
+    samplers.fill(UNKNOWN);
+  }
+
+  void StateCache::onDeleteProgram(GLuint id) {
+    if (program == id) {
+      program = UNKNOWN;
+    }
+  }
+
+  void StateCache::onDeleteVertexArray(GLuint vao) {
+    if (vertexArray == vao) {
+      vertexArray = UNKNOWN;
+    }
+  }
+
+  void StateCache::onDeleteFramebuffer(GLuint framebuffer) {
+    if (readFramebuffer == framebuffer) {
+      readFramebuffer = UNKNOWN;
+    }
+    if (drawFramebuffer == framebuffer) {
+      drawFramebuffer = UNKNOWN;
+    }
+  }
+
+  void StateCache::onDeleteBuffer(GLuint buffer) {
+    for (auto& bound : buffers) {
+      if (bound == buffer) {
+        bound = UNKNOWN;
+      }
+    }
+    for (auto* bindings : {&uniformBuffers, &storageBuffers}) {
+      for (auto& binding : *bindings) {
+        if (binding.buffer == buffer) {
+          binding = {};
+        }
+      }
+    }
+  }
+
+  void StateCache::onDeleteTexture(GLuint texture) {
+    for (auto& bound : textures) {
+      if (bound == texture) {
+        bound = UNKNOWN;
+      }
+    }
+  }
+
+  void StateCache::onDeleteSampler(GLuint sampler) {
+    for (auto& bound : samplers) {
+      if (bound == sampler) {
+        bound = UNKNOWN;
+      }
+    }
+  }
+
+  void StateCache::newFrame() {
+    lastFrame = frame;
+    frame = {};
+  }
+
+  void StateCache::setEnabled(bool enable) {
+    enabled = enable;
+    invalidate();
+  }
+
+  uint32_t StateCache::bufferSlot(GLenum target) {
+    switch (target) {
+    case GL_ARRAY_BUFFER:
+      return 0;
+    case GL_ATOMIC_COUNTER_BUFFER:
+      return 1;
+    case GL_COPY_READ_BUFFER:
+      return 2;
+    case GL_COPY_WRITE_BUFFER:
+      return 3;
+    case GL_DISPATCH_INDIRECT_BUFFER:
+      return 4;
+    case GL_DRAW_INDIRECT_BUFFER:
+      return 5;
+    case GL_PIXEL_PACK_BUFFER:
+      return 6;
+    case GL_PIXEL_UNPACK_BUFFER:
+      return 7;
+    case GL_QUERY_BUFFER:
+      return 8;
+    case GL_SHADER_STORAGE_BUFFER:
+      return 9;
+    case GL_TEXTURE_BUFFER:
+      return 10;
+    case GL_UNIFORM_BUFFER:
+      return 11;
+    default:
+      return BUFFER_TARGETS;
+    }
+  }
+
+  std::array<StateCache::RangeBinding, StateCache::MAX_BUFFER_BINDINGS>*
+  StateCache::rangeBindings(GLenum target) {
+    switch (target) {
+    case GL_UNIFORM_BUFFER:
+      return &uniformBuffers;
+    case GL_SHADER_STORAGE_BUFFER:
+      return &storageBuffers;
+    default:
+      return nullptr;
+    }
+  }
+} // namespace gl
@@ -58,4 +58,12 @@ namespace gl {
                         type, pixels);
   }
 
+  void Texture::compressedSubImage(GLint level, GLint xoffset, GLint yoffset,
+                                   GLsizei width, GLsizei height,
+                                   GLenum format, GLsizei imageSize,
+                                   const void* data) const {
+    glCompressedTextureSubImage2D(m_id, level, xoffset, yoffset, width, height,
+                                  format, imageSize, data);
+  }
+
 } // namespace gl
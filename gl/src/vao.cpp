@@ -1,7 +1,7 @@
 #include <gl/vao.hpp>
 
 namespace gl {
-  void gl::Vao::unbind() { glBindVertexArray(0); }
+  void gl::Vao::unbind() { gl::StateCache::get().bindVertexArray(0); }
 
   void gl::Vao::bindVertexBuffer(GLuint index, const gl::Id& bufferId,
                                  GLuint offset, GLuint stride) const {
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <engine/frustum.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+
+namespace engine {
+  /// <summary>
+  /// Decides how often animated nodes advance their animation, from their
+  /// distance to the camera and whether they are in view.
+  /// Nodes skipped on a frame keep their elapsed time and catch up in O(1)
+  /// when they next update, so reduced rates never drift out of sync.
+  /// </summary>
+  class AnimationLod {
+  public:
+    struct Settings {
+      /// <summary>
+      /// Nodes closer than this update every frame.
+      /// </summary>
+      float fullRateDistance = 25.0f;
+      /// <summary>
+      /// Nodes closer than this (and past fullRateDistance) update every
+      /// nearInterval frames, further nodes every farInterval frames.
+      /// </summary>
+      float nearDistance = 75.0f;
+      uint32_t nearInterval = 2;
+      uint32_t farInterval = 4;
+      /// <summary>
+      /// Interval of nodes outside the frustum. 0 pauses them until they are
+      /// back in view.
+      /// </summary>
+      uint32_t offscreenInterval = 0;
+    };
+
+    AnimationLod() = default;
+    explicit AnimationLod(const Settings& settings) : settings(settings) {}
+
+    /// <summary>
+    /// Sets the view the intervals are computed against. Until a view is set
+    /// every node updates every frame.
+    /// </summary>
+    void setView(const engine::Frustum& frustum, const glm::vec3& position) {
+      this->frustum = frustum;
+      this->position = position;
+    }
+
+    /// <summary>
+    /// Number of frames between updates of a node's animation, 0 for none.
+    /// </summary>
+    /// <param name="centre">World space centre of the node</param>
+    /// <param name="radius">Bounding radius of the node</param>
+    uint32_t getUpdateInterval(const glm::vec3& centre, float radius) const;
+
+    /// <summary>
+    /// Whether a node should advance its animation this frame. Nodes are
+    /// spread over the frames of their interval by their phase, so a reduced
+    /// rate does not update every distant node on the same frame.
+    /// </summary>
+    bool shouldUpdate(uint32_t frameIndex, uint32_t phase,
+                      const glm::vec3& centre, float radius) const {
+      return shouldUpdate(frameIndex, phase,
+                          getUpdateInterval(centre, radius));
+    }
+
+    /// <summary>
+    /// Whether a node with the given update interval should advance its
+    /// animation this frame.
+    /// </summary>
+    static bool shouldUpdate(uint32_t frameIndex, uint32_t phase,
+                             uint32_t interval) {
+      return interval != 0 && (frameIndex + phase) % interval == 0;
+    }
+
+    inline const Settings& getSettings() const { return settings; }
+    inline void setSettings(const Settings& newSettings) {
+      settings = newSettings;
+    }
+
+  protected:
+    Settings settings = {};
+    std::optional<engine::Frustum> frustum;
+    glm::vec3 position = {};
+  };
+} // namespace engine
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "engine/camera.hpp"
+#include "engine/cpu_profiler.hpp"
 #include "engine/frame_info.hpp"
+#include "engine/gpu_profiler.hpp"
 #include "engine/gui.hpp"
 #include "engine/input.hpp"
 #include "engine/scene_graph.hpp"
@@ -80,9 +83,16 @@ namespace engine {
     /// and clearing input states.
     /// </summary>
     void postRender() {
-      input.frameEnd();
-      gui.endFrame();
-      window.swapBuffers();
+      {
+        ENGINE_PROFILE_ZONE("Present");
+        input.frameEnd();
+        gui.endFrame();
+        window.swapBuffers();
+      }
+      gl::StateCache::get().newFrame();
+      engine::Camera::endFrame();
+      engine::GpuProfiler::global().nextFrame();
+      engine::CpuProfiler::global().nextFrame();
 
       ++frameIndex;
     }
@@ -158,9 +168,15 @@ namespace engine {
 
       FrameInfo frameInfo{app.getFrameIndex(), delta};
 
-      if (app.update(frameInfo))
-        continue;
-      app.render(frameInfo);
+      {
+        ENGINE_PROFILE_ZONE("Update");
+        if (app.update(frameInfo))
+          continue;
+      }
+      {
+        ENGINE_PROFILE_ZONE("Render");
+        app.render(frameInfo);
+      }
       app.postRender();
     }
 
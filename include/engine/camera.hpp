@@ -1,4 +1,5 @@
 #pragma once
+#include "engine/frame_ring.hpp"
 #include "engine/frustum.hpp"
 #include "engine/input.hpp"
 #include <gl/buffer.hpp>
@@ -15,6 +16,12 @@ namespace engine {
   public:
     using Rotation = glm::vec2;
 
+    /// <summary>
+    /// Matrix writes each camera fits in one frame, e.g. a resize and an
+    /// update.
+    /// </summary>
+    constexpr static uint32_t MAX_WRITES_PER_FRAME = 4;
+
     /// <summary>
     /// Matrices struct sent to the GPU.
     /// </summary>
@@ -80,11 +87,23 @@ namespace engine {
     }
 
     /// <summary>
-    /// Binds the camera's matrix UBO to the given binding point.
+    /// Moves every camera's matrix ring on to the next frame's slice, at
+    /// their next write. Call once per frame after rendering, which
+    /// App::postRender does.
+    /// </summary>
+    static void endFrame();
+
+    /// <summary>
+    /// Binds the camera's latest matrices to the given UBO binding point.
+    /// Every write moves the matrices, so bind after the frame's last write
+    /// (update, onResize), i.e. every frame before drawing.
     /// </summary>
     /// <param name="bindingPoint">Index to bind the buffer to</param>
     inline void bindMatrixBuffer(GLuint bindingPoint) const {
-      matrixBuffer.bindBase(gl::Buffer::StorageTarget::UNIFORM, bindingPoint);
+      if (matrixAllocation) {
+        matrixRing.bindRange(gl::Buffer::StorageTarget::UNIFORM, bindingPoint,
+                             *matrixAllocation);
+      }
     }
 
     /// <summary>
@@ -135,19 +154,24 @@ namespace engine {
     }
 
     /// <summary>
-    /// Writes the current matrices to the matrix buffer.
+    /// Writes the current matrices to the matrix ring, moving to the next
+    /// slice on the first write of a frame, so frames still in flight keep
+    /// reading their own copy. Later writes in the same frame are bumped
+    /// within the slice, and skipped with an error once it is full.
     /// Does not update the matrices member, buildMatrices should be called
     /// first if required.
     /// </summary>
-    inline void writeMatrices() const {
-      matrixMapping.write(&matrices, sizeof(Matrices));
-    }
+    void writeMatrices();
 
     glm::quat rotation;
     glm::vec3 position;
     Matrices matrices;
-    gl::Buffer matrixBuffer;
-    gl::Mapping matrixMapping;
+    FrameRing matrixRing;
+    std::optional<FrameRing::Allocation> matrixAllocation;
+    /// <summary>
+    /// Frame the matrix ring's current slice belongs to.
+    /// </summary>
+    uint32_t matrixFrame;
     float delta = 0.0f;
     int polygonType = 0;
     bool vsync = true;
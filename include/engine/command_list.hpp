@@ -0,0 +1,167 @@
+#pragma once
+
+#include "engine/thread_pool.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// GL commands recorded into a compact byte arena to be issued later.
+  /// Recording makes no GL calls, so lists can be filled on worker threads
+  /// and replayed in order on the GL thread.
+  /// </summary>
+  /// <remarks>
+  /// Each command is a small header followed by its arguments. clear keeps
+  /// the arena's memory, so a list reused every frame stops allocating once
+  /// it has grown to its largest frame. Uniforms are set on the program used
+  /// last in the list.
+  /// </remarks>
+  class CommandList {
+  public:
+    CommandList() = default;
+
+    CommandList(const CommandList&) = delete;
+    CommandList& operator=(const CommandList&) = delete;
+    CommandList(CommandList&&) noexcept = default;
+    CommandList& operator=(CommandList&&) noexcept = default;
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vao);
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindBufferBase(GLenum target, GLuint index, GLuint buffer);
+    void bindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                         GLintptr offset, GLsizeiptr size);
+    void bindTextureUnit(GLuint unit, GLuint texture);
+
+    void setUniform(GLint location, GLint value);
+    void setUniform(GLint location, GLuint value);
+    void setUniform(GLint location, float value);
+    void setUniform(GLint location, const glm::vec2& value);
+    void setUniform(GLint location, const glm::vec3& value);
+    void setUniform(GLint location, const glm::vec4& value);
+    void setUniform(GLint location, const glm::mat4& value);
+
+    /// <summary>
+    /// Draws count indirect commands from the bound draw indirect buffer.
+    /// </summary>
+    /// <param name="offset">Byte offset of the first command</param>
+    void multiDrawElementsIndirect(GLenum mode, GLenum type, GLintptr offset,
+                                   GLsizei count, GLsizei stride = 0);
+    void dispatchCompute(GLuint x, GLuint y = 1, GLuint z = 1);
+    /// <summary>
+    /// Dispatches from the bound dispatch indirect buffer.
+    /// </summary>
+    void dispatchComputeIndirect(GLintptr offset);
+    void memoryBarrier(GLbitfield barriers);
+
+    /// <summary>
+    /// Issues the recorded commands. Must be called on the GL thread, binds
+    /// go through its StateCache.
+    /// </summary>
+    void replay() const;
+
+    /// <summary>
+    /// Removes the commands, keeping the arena's memory.
+    /// </summary>
+    void clear() {
+      data.clear();
+      commands = 0;
+    }
+
+    bool empty() const { return commands == 0; }
+    uint32_t getCommandCount() const { return commands; }
+    size_t getSize() const { return data.size(); }
+    size_t getCapacity() const { return data.capacity(); }
+
+  protected:
+    enum class Op : uint16_t {
+      USE_PROGRAM,
+      BIND_VERTEX_ARRAY,
+      BIND_BUFFER,
+      BIND_BUFFER_RANGE,
+      BIND_TEXTURE_UNIT,
+      UNIFORM_INT,
+      UNIFORM_UINT,
+      UNIFORM_FLOAT,
+      UNIFORM_VEC2,
+      UNIFORM_VEC3,
+      UNIFORM_VEC4,
+      UNIFORM_MAT4,
+      MULTI_DRAW_ELEMENTS_INDIRECT,
+      DISPATCH_COMPUTE,
+      DISPATCH_COMPUTE_INDIRECT,
+      MEMORY_BARRIER,
+    };
+
+    /// <summary>
+    /// Precedes each command's arguments.
+    /// </summary>
+    struct Header {
+      Op op;
+      /// <summary>
+      /// Bytes of arguments following the header.
+      /// </summary>
+      uint16_t size;
+    };
+
+    std::vector<uint8_t> data;
+    uint32_t commands = 0;
+
+    /// <summary>
+    /// Appends a command with its arguments.
+    /// </summary>
+    template <typename T> void push(Op op, const T& args);
+  };
+
+  /// <summary>
+  /// Records work into command lists on the thread pool, one list per batch,
+  /// and replays them in batch order. Batches do not depend on the number of
+  /// threads, so the replayed order is the same as recording serially.
+  /// </summary>
+  /// <remarks>
+  /// The lists are kept across frames. Call clear once per frame, record any
+  /// number of times, then replay on the GL thread.
+  /// </remarks>
+  class CommandRecorder {
+  public:
+    using RecordFunction =
+        std::function<void(CommandList& list, size_t begin, size_t end)>;
+
+    /// <summary>
+    /// Records count items, batchSize items per command list, in parallel.
+    /// Lists follow those of previous calls since clear.
+    /// </summary>
+    /// <param name="func">Records items [begin, end) into the list. Must not
+    /// make GL calls</param>
+    void record(size_t count, size_t batchSize, const RecordFunction& func,
+                ThreadPool& pool = ThreadPool::global());
+
+    /// <summary>
+    /// Replays the recorded lists in order, on the GL thread.
+    /// </summary>
+    void replay() const;
+
+    /// <summary>
+    /// Removes the recorded commands, keeping the lists for reuse.
+    /// </summary>
+    void clear();
+
+    uint32_t getListCount() const { return used; }
+    uint32_t getCommandCount() const;
+    /// <summary>
+    /// Bytes reserved by all lists, including unused ones.
+    /// </summary>
+    size_t getCapacity() const;
+
+  protected:
+    std::vector<CommandList> lists;
+    /// <summary>
+    /// Lists holding commands since clear, the rest are kept for reuse.
+    /// </summary>
+    uint32_t used = 0;
+  };
+} // namespace engine
@@ -0,0 +1,206 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#ifdef ENGINE_PROFILING
+#define ENGINE_PROFILE_CONCAT_(a, b) a##b
+#define ENGINE_PROFILE_CONCAT(a, b) ENGINE_PROFILE_CONCAT_(a, b)
+/// <summary>
+/// Profiles the rest of the enclosing scope as a zone.
+/// </summary>
+#define ENGINE_PROFILE_ZONE(name)                                              \
+  engine::CpuProfiler::Zone ENGINE_PROFILE_CONCAT(profileZone, __LINE__)(name)
+/// <summary>
+/// Names the calling thread in the profiler and traces.
+/// </summary>
+#define ENGINE_PROFILE_THREAD(name) engine::CpuProfiler::setThreadName(name)
+#else
+#define ENGINE_PROFILE_ZONE(name)
+#define ENGINE_PROFILE_THREAD(name)
+#endif
+
+namespace engine {
+  /// <summary>
+  /// Hierarchical CPU profiler. Zones are recorded into a ring buffer per
+  /// thread, written only by that thread, so recording takes no locks. Once
+  /// per frame the buffers are read into per zone statistics, and into a
+  /// capture if one is running.
+  /// </summary>
+  /// <remarks>
+  /// Use through ENGINE_PROFILE_ZONE, which compiles to nothing unless
+  /// ENGINE_PROFILING is defined. Zone names must outlive the profiler, e.g.
+  /// string literals. A thread recording more than EVENTS_PER_THREAD zones
+  /// between two frames loses the oldest.
+  /// </remarks>
+  class CpuProfiler {
+  public:
+    constexpr static uint32_t EVENTS_PER_THREAD = 1u << 14;
+    constexpr static uint32_t DEFAULT_CAPTURE_FRAMES = 120;
+
+    struct Event {
+      const char* name;
+      uint64_t startNs;
+      uint64_t endNs;
+      uint32_t depth;
+    };
+
+    struct ZoneStats {
+      /// <summary>
+      /// Calls in the last frame, over all threads.
+      /// </summary>
+      uint32_t calls = 0;
+      /// <summary>
+      /// Time in the zone in the last frame, summed over threads.
+      /// </summary>
+      double totalMs = 0.0;
+      /// <summary>
+      /// Moving average of totalMs.
+      /// </summary>
+      double averageMs = 0.0;
+      /// <summary>
+      /// Longest single call in the last frame.
+      /// </summary>
+      double maxMs = 0.0;
+    };
+
+    /// <summary>
+    /// Events recorded by one thread.
+    /// </summary>
+    struct ThreadBuffer {
+      std::unique_ptr<Event[]> events =
+          std::make_unique<Event[]>(EVENTS_PER_THREAD);
+      /// <summary>
+      /// Events ever written. Only the owning thread stores to it.
+      /// </summary>
+      std::atomic<uint64_t> written = 0;
+      /// <summary>
+      /// Events already read by nextFrame.
+      /// </summary>
+      uint64_t read = 0;
+      uint32_t depth = 0;
+      uint32_t id = 0;
+      const char* name = nullptr;
+    };
+
+    /// <summary>
+    /// Measures a zone on the calling thread from construction to
+    /// destruction.
+    /// </summary>
+    class Zone {
+      ThreadBuffer& buffer;
+      const char* name;
+      uint64_t start;
+
+    public:
+      explicit Zone(const char* name)
+          : buffer(threadBuffer()), name(name), start(now()) {
+        ++buffer.depth;
+      }
+      ~Zone() {
+        --buffer.depth;
+        auto index = buffer.written.load(std::memory_order_relaxed);
+        buffer.events[index % EVENTS_PER_THREAD] = {
+            .name = name,
+            .startNs = start,
+            .endNs = now(),
+            .depth = buffer.depth,
+        };
+        buffer.written.store(index + 1, std::memory_order_release);
+      }
+
+      Zone(const Zone&) = delete;
+      Zone& operator=(const Zone&) = delete;
+    };
+
+    /// <summary>
+    /// Engine wide profiler, created on first use.
+    /// </summary>
+    static CpuProfiler& global();
+
+    /// <summary>
+    /// Names the calling thread.
+    /// </summary>
+    static void setThreadName(const char* name);
+
+    /// <summary>
+    /// Reads the zones recorded since the last call into the statistics.
+    /// Call once per frame, from the thread whose zones should show as the
+    /// frame's hierarchy.
+    /// </summary>
+    void nextFrame();
+
+    /// <summary>
+    /// Records the next frames' zones of all threads, then writes them to
+    /// path as a Chrome trace (chrome://tracing, Perfetto).
+    /// </summary>
+    void startCapture(const std::filesystem::path& path,
+                      uint32_t frames = DEFAULT_CAPTURE_FRAMES);
+    bool isCapturing() const { return captureFramesLeft > 0; }
+
+    double getFrameMs() const { return frameMs; }
+    const std::unordered_map<std::string_view, ZoneStats>& getStats() const {
+      return stats;
+    }
+    /// <summary>
+    /// Events lost to full thread buffers.
+    /// </summary>
+    uint64_t getDropped() const { return dropped; }
+
+    /// <summary>
+    /// Shows the zone statistics and the last frame's hierarchy. Expects an
+    /// active ImGui frame, as it does not create its own.
+    /// </summary>
+    void DebugUI();
+
+    /// <summary>
+    /// Nanoseconds on the profiler's clock.
+    /// </summary>
+    static uint64_t now();
+
+  protected:
+    /// <summary>
+    /// An event with the thread that recorded it.
+    /// </summary>
+    struct ThreadEvent {
+      Event event;
+      uint32_t thread;
+    };
+
+    /// <summary>
+    /// Buffers are shared with their thread, so either may end first.
+    /// </summary>
+    std::vector<std::shared_ptr<ThreadBuffer>> threads;
+    std::mutex threadsMutex;
+
+    std::vector<ThreadEvent> frameEvents;
+    std::unordered_map<std::string_view, ZoneStats> stats;
+    uint32_t frameThread = 0;
+    uint64_t frameStart = 0;
+    double frameMs = 0.0;
+    uint64_t dropped = 0;
+
+    std::vector<ThreadEvent> capture;
+    /// <summary>
+    /// Start and end of each captured frame.
+    /// </summary>
+    std::vector<std::pair<uint64_t, uint64_t>> captureFrames;
+    std::filesystem::path capturePath;
+    uint32_t captureFramesLeft = 0;
+
+    CpuProfiler();
+
+    /// <summary>
+    /// The calling thread's buffer, registered on first use.
+    /// </summary>
+    static ThreadBuffer& threadBuffer();
+    void readThread(ThreadBuffer& buffer);
+    bool writeTrace(const std::filesystem::path& path);
+  };
+} // namespace engine
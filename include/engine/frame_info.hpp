@@ -1,11 +1,17 @@
 #pragma once
 
 namespace engine {
+  class AnimationLod;
+
   /// <summary>
   /// Data about the current frame.
   /// </summary>
   struct FrameInfo {
     uint32_t frameIndex;
     float frameDelta;
+    /// <summary>
+    /// Reduces the animation rate of distant and off-screen nodes when set.
+    /// </summary>
+    const engine::AnimationLod* animationLod = nullptr;
   };
 } // namespace engine
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <gl/buffer.hpp>
+#include <gl/fence.hpp>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Persistently mapped buffer split into a slice per frame in flight, for
+  /// data rewritten every frame (matrices, instances, indirect draws).
+  /// Each frame bump allocates from its own slice, so the CPU never writes
+  /// memory the GPU may still be reading. A slice is fenced when the ring
+  /// moves past it and only waited on when it is reused.
+  /// </summary>
+  /// <remarks>
+  /// Must be used on the GL thread.
+  /// </remarks>
+  class FrameRing {
+  public:
+    constexpr static uint32_t DEFAULT_FRAMES = 3;
+
+    /// <summary>
+    /// Space reserved in the current slice.
+    /// </summary>
+    struct Allocation {
+      std::span<uint8_t> data;
+      /// <summary>
+      /// Offset in the buffer, to bind or draw from.
+      /// </summary>
+      GLuint offset;
+    };
+
+    /// <summary>
+    /// Creates the ring, persistently mapped.
+    /// </summary>
+    /// <param name="frameSize">Bytes each frame may allocate</param>
+    /// <param name="frames">Frames in flight, the number of slices</param>
+    FrameRing(GLuint frameSize, uint32_t frames = DEFAULT_FRAMES);
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+    FrameRing(FrameRing&&) noexcept = default;
+    FrameRing& operator=(FrameRing&&) = default;
+
+    /// <summary>
+    /// Fences the current slice and moves to the next one, waiting for the
+    /// GPU if it has not finished with it. Call once per frame before
+    /// allocating, after the previous frame's commands were issued.
+    /// </summary>
+    void nextFrame();
+
+    /// <summary>
+    /// Reserves space in the current slice.
+    /// </summary>
+    /// <param name="alignment">Power of two the offset is aligned to</param>
+    /// <returns>The space, or nullopt if the slice is full</returns>
+    std::optional<Allocation> allocate(GLuint bytes, GLuint alignment = 16);
+
+    /// <summary>
+    /// Copies value into the current slice.
+    /// </summary>
+    template <typename T>
+    std::optional<Allocation> write(const T& value, GLuint alignment = 16) {
+      auto allocation = allocate(sizeof(T), alignment);
+      if (allocation) {
+        std::memcpy(allocation->data.data(), &value, sizeof(T));
+      }
+      return allocation;
+    }
+
+    /// <summary>
+    /// Reference to an allocation, for functions writing through a mapping
+    /// such as Mesh::writeBatchedDraws.
+    /// </summary>
+    gl::MappingRef ref(const Allocation& allocation) const {
+      return gl::MappingRef(mapping, allocation.offset);
+    }
+
+    /// <summary>
+    /// Binds an allocation to a uniform or storage binding. Its offset must
+    /// have been allocated with the target's offset alignment.
+    /// </summary>
+    void bindRange(gl::Buffer::StorageTarget target, GLuint index,
+                   const Allocation& allocation) const {
+      buffer.bindRange(target, index, allocation.offset,
+                       static_cast<GLuint>(allocation.data.size()));
+    }
+
+    const gl::Buffer& getBuffer() const { return buffer; }
+    GLuint getFrameSize() const { return frameSize; }
+    uint32_t getFrameCount() const {
+      return static_cast<uint32_t>(fences.size());
+    }
+    /// <summary>
+    /// Bytes allocated from the current slice, padding included.
+    /// </summary>
+    GLuint getUsedBytes() const { return head - slice * frameSize; }
+    /// <summary>
+    /// Times nextFrame had to wait for the GPU.
+    /// </summary>
+    uint64_t getStalls() const { return stalls; }
+
+  protected:
+    GLuint frameSize;
+    gl::Buffer buffer;
+    gl::Mapping mapping;
+    uint8_t* base = nullptr;
+    std::vector<std::optional<gl::Fence>> fences;
+    uint32_t slice = 0;
+    /// <summary>
+    /// Next free offset in the current slice.
+    /// </summary>
+    GLuint head = 0;
+    uint64_t stalls = 0;
+  };
+} // namespace engine
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "engine/tlsf_allocator.hpp"
+#include <cstdint>
+#include <gl/buffer.hpp>
+#include <memory>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Sub-allocates GPU memory from a few large immutable buffers (heaps)
+  /// instead of one buffer object per resource. Each heap is managed by a
+  /// TlsfAllocator. New heaps are created as the existing ones fill, and
+  /// allocations larger than a heap get a heap of their own.
+  /// </summary>
+  /// <remarks>
+  /// Movable allocations may be relocated by defragment, so owners must read
+  /// their buffer and offset through get before binding rather than keep
+  /// them. Must be used on the GL thread.
+  /// </remarks>
+  class GpuHeap {
+  public:
+    using Handle = uint32_t;
+    constexpr static Handle INVALID_HANDLE = ~0u;
+    constexpr static uint32_t DEFAULT_DEFRAGMENT_BLOCKS = 256;
+
+    /// <summary>
+    /// Where an allocation currently lives.
+    /// </summary>
+    struct Block {
+      const gl::Buffer* buffer = nullptr;
+      GLuint offset = 0;
+      GLuint size = 0;
+    };
+
+    struct Stats {
+      uint32_t heaps = 0;
+      uint32_t allocations = 0;
+      uint64_t capacity = 0;
+      uint64_t usedBytes = 0;
+      uint64_t largestFreeBlock = 0;
+      /// <summary>
+      /// Free space not in each heap's largest free block, over all free
+      /// space.
+      /// </summary>
+      float fragmentation = 0.0f;
+    };
+
+    /// <summary>
+    /// Creates the heap manager. Heaps are created on first use.
+    /// </summary>
+    /// <param name="heapSize">Size of each heap buffer</param>
+    explicit GpuHeap(GLuint heapSize = 64u << 20);
+
+    GpuHeap(const GpuHeap&) = delete;
+    GpuHeap& operator=(const GpuHeap&) = delete;
+
+    /// <summary>
+    /// Allocates size bytes, copying data into them if not nullptr.
+    /// </summary>
+    /// <param name="alignment">Power of two the offset is aligned to</param>
+    /// <param name="movable">Whether defragment may relocate it</param>
+    /// <returns>The allocation, INVALID_HANDLE on failure</returns>
+    Handle allocate(GLuint size, GLuint alignment = 16,
+                    const void* data = nullptr, bool movable = true);
+    void free(Handle handle);
+
+    Block get(Handle handle) const;
+
+    /// <summary>
+    /// Moves allocations towards the start of their heap, into free space
+    /// before them, copying on the GPU. Heaps left empty are released.
+    /// Incremental: each call carries on from where the last one stopped,
+    /// walking every heap from its end to its start, then starting over.
+    /// </summary>
+    /// <param name="maxBytes">Most bytes to copy, to spread the work over
+    /// frames</param>
+    /// <param name="maxBlocks">Most allocations and free blocks to look at,
+    /// which bounds the call's CPU time</param>
+    /// <returns>Bytes copied</returns>
+    uint64_t defragment(uint64_t maxBytes,
+                        uint32_t maxBlocks = DEFAULT_DEFRAGMENT_BLOCKS);
+
+    Stats getStats() const;
+
+    /// <summary>
+    /// Shows the heap usage and fragmentation. Expects an active ImGui
+    /// frame, as it does not create its own.
+    /// </summary>
+    void DebugUI() const;
+
+  protected:
+    struct Heap {
+      gl::Buffer buffer;
+      TlsfAllocator allocator;
+      /// <summary>
+      /// Handle owning each allocator block, to update on moves.
+      /// </summary>
+      std::vector<Handle> owners;
+
+      explicit Heap(GLuint size);
+    };
+
+    struct Slot {
+      uint32_t heap = 0;
+      TlsfAllocator::Allocation allocation;
+      GLuint alignment = 16;
+      bool movable = true;
+      bool live = false;
+    };
+
+    GLuint heapSize;
+    /// <summary>
+    /// Released heaps leave a nullptr so heap indices stay valid.
+    /// </summary>
+    std::vector<std::unique_ptr<Heap>> heaps;
+    std::vector<Slot> slots;
+    std::vector<Handle> freeSlots;
+
+    /// <summary>
+    /// Heap defragment is walking.
+    /// </summary>
+    uint32_t defragHeap = 0;
+    /// <summary>
+    /// Allocator block defragment visits next, NO_BLOCK for the heap's last
+    /// allocation. Always an allocated block, so freeing it moves it on.
+    /// </summary>
+    uint32_t defragNext = TlsfAllocator::NO_BLOCK;
+
+    uint32_t createHeap(GLuint size);
+    void setOwner(Heap& heap, uint32_t block, Handle handle);
+    /// <summary>
+    /// Moves the defragment cursor to the allocation before block, or on to
+    /// the next heap after the first one.
+    /// </summary>
+    void stepDefragCursor(const Heap& heap, uint32_t block);
+  };
+
+  /// <summary>
+  /// Owns an allocation of a GpuHeap, freeing it on destruction.
+  /// </summary>
+  class HeapAllocation {
+    GpuHeap* heap = nullptr;
+    GpuHeap::Handle handle = GpuHeap::INVALID_HANDLE;
+
+  public:
+    HeapAllocation() = default;
+    HeapAllocation(GpuHeap& heap, GpuHeap::Handle handle)
+        : heap(&heap), handle(handle) {}
+    ~HeapAllocation() { reset(); }
+
+    HeapAllocation(const HeapAllocation&) = delete;
+    HeapAllocation& operator=(const HeapAllocation&) = delete;
+    HeapAllocation(HeapAllocation&& other) noexcept
+        : heap(other.heap), handle(other.handle) {
+      other.handle = GpuHeap::INVALID_HANDLE;
+    }
+    HeapAllocation& operator=(HeapAllocation&& other) noexcept {
+      if (this != &other) {
+        reset();
+        heap = other.heap;
+        handle = other.handle;
+        other.handle = GpuHeap::INVALID_HANDLE;
+      }
+      return *this;
+    }
+
+    bool isValid() const { return handle != GpuHeap::INVALID_HANDLE; }
+    /// <summary>
+    /// Current buffer and offset, which defragment may change.
+    /// </summary>
+    GpuHeap::Block get() const { return heap->get(handle); }
+
+    void reset() {
+      if (isValid()) {
+        heap->free(handle);
+        handle = GpuHeap::INVALID_HANDLE;
+      }
+    }
+  };
+} // namespace engine
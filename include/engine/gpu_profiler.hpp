@@ -0,0 +1,169 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <gl/query.hpp>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Measures GPU time of named zones (passes) with timestamp queries. Each
+  /// frame's queries are read back a few frames later, once available, so
+  /// measuring never waits for the GPU. Zones are also pushed as debug
+  /// groups, so they show up in frame debuggers.
+  /// </summary>
+  /// <remarks>
+  /// Must be used on the GL thread. Zones may nest. Zone names must outlive
+  /// the profiler, e.g. string literals.
+  /// </remarks>
+  class GpuProfiler {
+  public:
+    /// <summary>
+    /// Frames recorded before the oldest is read back.
+    /// </summary>
+    constexpr static uint32_t DEFAULT_LATENCY = 4;
+    /// <summary>
+    /// Read back frames kept for the UI and trace export.
+    /// </summary>
+    constexpr static uint32_t HISTORY = 120;
+
+    struct ZoneResult {
+      const char* name;
+      uint32_t depth;
+      /// <summary>
+      /// Milliseconds since the start of the frame.
+      /// </summary>
+      double startMs;
+      double durationMs;
+    };
+
+    struct FrameResult {
+      uint64_t frame = 0;
+      /// <summary>
+      /// GPU timestamp of the frame's start, nanoseconds.
+      /// </summary>
+      uint64_t startNs = 0;
+      double durationMs = 0.0;
+      std::vector<ZoneResult> zones;
+    };
+
+    /// <summary>
+    /// Measures a zone from construction to destruction.
+    /// </summary>
+    class Zone {
+      GpuProfiler& profiler;
+
+    public:
+      explicit Zone(const char* name, GpuProfiler& profiler = global())
+          : profiler(profiler) {
+        profiler.beginZone(name);
+      }
+      ~Zone() { profiler.endZone(); }
+
+      Zone(const Zone&) = delete;
+      Zone& operator=(const Zone&) = delete;
+    };
+
+    explicit GpuProfiler(uint32_t latency = DEFAULT_LATENCY);
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    void beginZone(const char* name);
+    void endZone();
+
+    /// <summary>
+    /// Ends the frame and starts the next, reading back the oldest frame if
+    /// its queries are available. Call once per frame.
+    /// </summary>
+    void nextFrame();
+
+    /// <summary>
+    /// Disabling stops issuing queries and debug groups. Frames in flight
+    /// are discarded.
+    /// </summary>
+    void setEnabled(bool enable);
+    bool isEnabled() const { return enabled; }
+
+    /// <summary>
+    /// Disables the profiler and deletes its queries. Call while the GL
+    /// context is still current, as global() outlives it. App's destructor
+    /// does so for the global profiler.
+    /// </summary>
+    void shutdown();
+
+    /// <summary>
+    /// Latest read back frame, nullptr if there is none yet.
+    /// </summary>
+    const FrameResult* getLatest() const;
+    /// <summary>
+    /// Frames whose queries were not available when they were due, so were
+    /// dropped instead of waited for.
+    /// </summary>
+    uint64_t getDropped() const { return dropped; }
+
+    /// <summary>
+    /// Writes the kept frames as a Chrome trace (chrome://tracing,
+    /// Perfetto).
+    /// </summary>
+    /// <returns>Whether the file was written</returns>
+    bool writeTrace(const std::filesystem::path& path) const;
+
+    /// <summary>
+    /// Shows the frame time graph and the latest frame's zones. Expects an
+    /// active ImGui frame, as it does not create its own.
+    /// </summary>
+    void DebugUI();
+
+    /// <summary>
+    /// Engine wide profiler, created on first use.
+    /// </summary>
+    static GpuProfiler& global();
+
+  protected:
+    struct PendingZone {
+      const char* name;
+      uint32_t depth;
+      uint32_t begin;
+      uint32_t end;
+    };
+
+    /// <summary>
+    /// Queries of a frame in flight, reused when it is read back.
+    /// </summary>
+    struct Frame {
+      std::vector<gl::Query> queries;
+      uint32_t usedQueries = 0;
+      std::vector<PendingZone> zones;
+      uint64_t frame = 0;
+      bool recorded = false;
+    };
+
+    std::vector<Frame> frames;
+    uint32_t current = 0;
+    uint64_t frameIndex = 0;
+    /// <summary>
+    /// Open zones of the current frame.
+    /// </summary>
+    std::vector<uint32_t> stack;
+
+    std::vector<FrameResult> history;
+    /// <summary>
+    /// Where the next read back frame goes in history.
+    /// </summary>
+    uint32_t historyHead = 0;
+    uint32_t historyCount = 0;
+
+    uint64_t dropped = 0;
+    bool enabled = true;
+    bool paused = false;
+
+    /// <summary>
+    /// Writes a timestamp into the next free query of the current frame.
+    /// </summary>
+    /// <returns>The query's index</returns>
+    uint32_t timestamp();
+    void beginFrame();
+    void resolve(Frame& frame);
+  };
+} // namespace engine
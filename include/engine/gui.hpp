@@ -33,6 +33,15 @@ namespace engine::gui {
     /// </summary>
     /// <param name="ms">Time in milliseconds</param>
     void sleep(int ms);
+
+    /// <summary>
+    /// Shows the CPU and GPU profilers in a window, drawn by endFrame.
+    /// </summary>
+    void setShowProfiler(bool show) { showProfiler = show; }
+    bool isShowingProfiler() const { return showProfiler; }
+
+  private:
+    bool showProfiler = false;
   };
 
   class GuiWindow {
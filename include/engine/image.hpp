@@ -1,21 +1,39 @@
 #pragma once
 
+#include "engine/texture/mip_generator.hpp"
 #include <expected>
 #include <gl/texture.hpp>
 #include <glm/glm.hpp>
+#include <span>
 #include <stb/image.h>
+#include <string>
 #include <string_view>
+#include <vector>
 
 namespace engine {
+  namespace texture {
+    class UploadRing;
+  } // namespace texture
+
   /// <summary>
-  /// An image loaded from disk.
+  /// How Image::decode interprets a file. Options are per call, so decodes
+  /// on different threads do not affect each other.
   /// </summary>
-  class Image {
+  struct ImageDecodeOptions {
     /// <summary>
-    /// Whether stb_image has been initialized.
+    /// Store the bottom row first, as OpenGL expects.
     /// </summary>
-    static bool yFlipped;
+    bool flipY = false;
+    /// <summary>
+    /// Number of channels to convert to, 0 to keep the file's.
+    /// </summary>
+    int desiredChannels = 0;
+  };
 
+  /// <summary>
+  /// An image loaded from disk.
+  /// </summary>
+  class Image {
     Image(glm::ivec2 dim, int channels, unsigned char* data)
         : dimensions(dim), channels(channels), data(data) {}
 
@@ -40,6 +58,31 @@ namespace engine {
       return *this;
     }
 
+    /// <summary>
+    /// Decodes an image file. Safe to call from any thread, no global decoder
+    /// state is touched.
+    /// </summary>
+    /// <returns>Image on success, error string on failure</returns>
+    static std::expected<Image, std::string>
+    decode(std::string_view file, const ImageDecodeOptions& options = {});
+
+    /// <summary>
+    /// Decodes an image already in memory (a PNG, JPEG etc file's bytes).
+    /// Safe to call from any thread.
+    /// </summary>
+    static std::expected<Image, std::string>
+    decode(std::span<const uint8_t> bytes,
+           const ImageDecodeOptions& options = {});
+
+    /// <summary>
+    /// Decodes several files at once on the pool's workers.
+    /// </summary>
+    /// <returns>The result of each file, in the order given</returns>
+    static std::vector<std::expected<Image, std::string>>
+    decodeAll(std::span<const std::string> files,
+              const ImageDecodeOptions& options = {},
+              ThreadPool& pool = ThreadPool::global());
+
     /// <summary>
     /// Creates an image from a file.
     /// </summary>
@@ -50,22 +93,7 @@ namespace engine {
     static inline std::expected<Image, std::string>
     fromFile(std::string_view file, bool flipY = false,
              int desiredChannels = 0) {
-      if (flipY != yFlipped) {
-        stbi_set_flip_vertically_on_load(flipY);
-        yFlipped = flipY;
-      }
-
-      int width, height, channels;
-      unsigned char* data =
-          stbi_load(file.data(), &width, &height, &channels, desiredChannels);
-      if (data == nullptr) {
-        auto err = stbi_failure_reason();
-        return std::unexpected(std::string("Failed to load image from ") +
-                               file.data() + "\n" + err);
-      }
-      Image img(glm::ivec2(width, height),
-                desiredChannels == 0 ? channels : desiredChannels, data);
-      return img;
+      return decode(file, {.flipY = flipY, .desiredChannels = desiredChannels});
     }
 
     ~Image() { stbi_image_free(data); }
@@ -77,24 +105,25 @@ namespace engine {
     /// Set mipmaps to 0 for no mipmaps.
     /// Set mipmaps to >0 to generate that many mipmap levels.
     /// Set mipmaps to -1 to generate full mipmap chain.
+    /// Mipmaps are generated on the CPU with the given settings, then every
+    /// level is uploaded as is.
     /// </summary>
+    /// <param name="ring">Ring to stage the texels through, nullptr to
+    /// upload from client memory</param>
     /// <returns>gl::Texture holding this image</returns>
-    gl::Texture toTexture(int mipmaps = 0) const {
-      if (mipmaps == -1) {
-        mipmaps = gl::Texture::calcMipLevels(dimensions.x, dimensions.y);
-      }
-      gl::Texture tex{};
-      tex.storage(mipmaps + 1,
-                  gl::Texture::internalFormatFromChannels(channels),
-                  dimensions);
-      tex.subImage(0, 0, 0, dimensions.x, dimensions.y,
-                   gl::Texture::formatFromChannels(channels), GL_UNSIGNED_BYTE,
-                   data);
-      if (mipmaps > 0) {
-        tex.generateMipmap();
-      }
+    gl::Texture toTexture(int mipmaps = 0,
+                          engine::texture::MipSettings settings = {},
+                          engine::texture::UploadRing* ring = nullptr) const;
 
-      return tex;
+    /// <summary>
+    /// Generates the mip chain below this image on the CPU.
+    /// </summary>
+    std::vector<engine::texture::MipLevel>
+    generateMips(const engine::texture::MipSettings& settings = {}) const {
+      return engine::texture::generateMips(
+          std::span(data, static_cast<size_t>(dimensions.x) * dimensions.y *
+                              channels),
+          dimensions, channels, settings);
     }
 
     const glm::ivec2& getDimensions() const { return dimensions; }
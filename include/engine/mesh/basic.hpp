@@ -1,24 +1,54 @@
 #pragma once
 
+#include <engine/gpu_heap.hpp>
 #include <engine/mesh/mesh_data.hpp>
 #include <gl/gl.hpp>
+#include <optional>
 
 namespace engine::mesh {
   class BasicMesh {
   public:
     BasicMesh() = default;
     BasicMesh(const engine::mesh::Data& meshData);
+    /// <summary>
+    /// Creates a mesh whose vertices and indices are sub-allocated from the
+    /// heap instead of buffers of their own. The heap must outlive the mesh.
+    /// </summary>
+    BasicMesh(const engine::mesh::Data& meshData, engine::GpuHeap& heap);
 
-    void bind() const { vao.bind(); }
+    void bind() const {
+      rebindHeapBuffers();
+      vao.bind();
+    }
     void unbind() const { vao.unbind(); }
-    gl::Vao::BindGuard bindGuard() const { return vao.bindGuard(); }
+    gl::Vao::BindGuard bindGuard() const {
+      rebindHeapBuffers();
+      return vao.bindGuard();
+    }
     void draw() const;
 
   protected:
-    gl::Buffer vertices = {};
-    gl::Buffer indices = {};
+    /// <summary>
+    /// Buffers of a mesh not allocated from a heap.
+    /// </summary>
+    std::optional<gl::Buffer> vertices;
+    std::optional<gl::Buffer> indices;
     GLuint vertexCount = 0;
     GLuint indexCount = 0;
+    gl::IndexType indexType = gl::IndexType::U32;
     gl::Vao vao = {};
+
+    engine::HeapAllocation heapVertices = {};
+    engine::HeapAllocation heapIndices = {};
+    /// <summary>
+    /// Heap blocks the VAO was last bound to, to notice defragmentation.
+    /// </summary>
+    mutable engine::GpuHeap::Block boundVertices = {};
+    mutable engine::GpuHeap::Block boundIndices = {};
+
+    /// <summary>
+    /// Rebinds the heap blocks to the VAO if they have moved.
+    /// </summary>
+    void rebindHeapBuffers() const;
   };
 } // namespace engine::mesh
\ No newline at end of file
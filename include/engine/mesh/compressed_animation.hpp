@@ -0,0 +1,117 @@
+#pragma once
+
+#include "engine/mesh/mesh_animation.hpp"
+#include <array>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace engine::mesh {
+  /// <summary>
+  /// How much error keyframe reduction may introduce per channel.
+  /// </summary>
+  struct AnimationCompressionSettings {
+    /// <summary>
+    /// Max rotation error, in radians.
+    /// </summary>
+    float rotationTolerance = 0.001f;
+    /// <summary>
+    /// Max translation error, in mesh units.
+    /// </summary>
+    float translationTolerance = 0.0005f;
+    /// <summary>
+    /// Max scale error, as a ratio.
+    /// </summary>
+    float scaleTolerance = 0.0005f;
+  };
+
+  /// <summary>
+  /// Skeletal animation stored as per joint rotation / translation / scale
+  /// tracks instead of a matrix per joint per frame.
+  /// Rotations are quantised to 48 bits (smallest three), translations and
+  /// scales to 16 bits per component within the track's range, and keys that
+  /// interpolation can reproduce within tolerance are dropped.
+  /// Sampled at any time, interpolating between keys.
+  /// </summary>
+  class CompressedAnimation {
+  public:
+    CompressedAnimation() = default;
+
+    /// <summary>
+    /// Compresses baked joint matrices. Matrices must be decomposable into
+    /// translation, rotation and (non-negative) scale.
+    /// </summary>
+    static CompressedAnimation
+    compress(const Animation& animation,
+             const AnimationCompressionSettings& settings = {});
+
+    unsigned int GetJointCount() const { return jointCount; }
+    unsigned int GetFrameCount() const { return frameCount; }
+    float GetFrameRate() const { return frameRate; }
+    /// <summary>
+    /// Length of one loop in seconds.
+    /// </summary>
+    float GetDuration() const {
+      return frameRate > 0.0f ? static_cast<float>(frameCount) / frameRate
+                              : 0.0f;
+    }
+
+    /// <summary>
+    /// Samples every joint at a time, wrapping around the end of the clip
+    /// (the last frame blends back into the first).
+    /// </summary>
+    /// <param name="time">Time in seconds</param>
+    /// <param name="joints">Joint transforms, GetJointCount() long</param>
+    void sample(float time, std::span<glm::mat4> joints) const;
+
+    /// <summary>
+    /// Samples a skinning palette (joint transform * inverse bind pose).
+    /// The palette is left unwritten if the inverse bind pose has fewer than
+    /// GetJointCount() joints.
+    /// </summary>
+    /// <param name="time">Time in seconds</param>
+    /// <param name="inverseBindPose">Inverse bind pose of the mesh</param>
+    /// <param name="palette">Output, GetJointCount() long</param>
+    void samplePalette(float time, std::span<const glm::mat4> inverseBindPose,
+                       std::span<glm::mat4> palette) const;
+
+    /// <summary>
+    /// Bytes used by the compressed tracks.
+    /// </summary>
+    size_t memoryUsage() const;
+
+    /// <summary>
+    /// Three 16 bit words. Quantised vec3, or a smallest three quaternion.
+    /// </summary>
+    using PackedKey = std::array<uint16_t, 3>;
+
+    struct Track {
+      uint32_t firstKey = 0;
+      uint32_t keyCount = 0;
+      /// <summary>
+      /// Dequantisation range, unused for rotations.
+      /// </summary>
+      glm::vec3 min = glm::vec3(0.0f);
+      glm::vec3 extent = glm::vec3(0.0f);
+    };
+
+    /// <summary>
+    /// Every track of one channel type, one per joint, sharing key arrays.
+    /// </summary>
+    struct Channel {
+      std::vector<Track> tracks;
+      std::vector<uint16_t> frames;
+      std::vector<PackedKey> keys;
+    };
+
+  protected:
+    unsigned int jointCount = 0;
+    unsigned int frameCount = 0;
+    float frameRate = 0.0f;
+
+    Channel rotations;
+    Channel translations;
+    Channel scales;
+  };
+} // namespace engine::mesh
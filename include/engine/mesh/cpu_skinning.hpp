@@ -0,0 +1,58 @@
+#pragma once
+
+#include "engine/mesh/mesh.hpp"
+#include "engine/thread_pool.hpp"
+#include <glm/glm.hpp>
+#include <span>
+
+namespace engine::mesh {
+  /// <summary>
+  /// CPU implementation of the skinning compute shader. Blends the four
+  /// weighted joints of each vertex from a joint palette (joint transform *
+  /// inverse bind pose). Used where compute is unavailable and as a reference
+  /// for the GPU path.
+  /// </summary>
+  namespace skinning {
+    /// <summary>
+    /// Skins vertices with SIMD (AVX2 and FMA when the CPU supports them,
+    /// else SSE2), split across the thread pool by vertex range.
+    /// Vertices with no weight are passed through unchanged, and joint
+    /// indices outside the palette are treated as joint 0.
+    /// </summary>
+    /// <param name="input">Bind pose vertices</param>
+    /// <param name="palette">Skinning matrices</param>
+    /// <param name="output">Skinned vertices, at least as long as input.
+    /// Nothing is skinned if it is shorter</param>
+    void skinVertices(std::span<const WeightedVertex> input,
+                      std::span<const glm::mat4> palette,
+                      std::span<Vertex> output,
+                      ThreadPool& pool = ThreadPool::global());
+
+    /// <summary>
+    /// Plain glm implementation, single threaded. The correctness reference.
+    /// </summary>
+    void skinVerticesReference(std::span<const WeightedVertex> input,
+                               std::span<const glm::mat4> palette,
+                               std::span<Vertex> output);
+
+    struct BenchmarkResult {
+      size_t vertices = 0;
+      double seconds = 0.0;
+      double verticesPerSecond = 0.0;
+      double referenceVerticesPerSecond = 0.0;
+      /// <summary>
+      /// Largest difference of any output component from the reference.
+      /// </summary>
+      float maxError = 0.0f;
+    };
+
+    /// <summary>
+    /// Skins random vertices with a random palette, timing skinVertices
+    /// against skinVerticesReference, and logs the throughput.
+    /// </summary>
+    BenchmarkResult benchmark(size_t vertexCount = 1 << 20,
+                              uint32_t jointCount = 64,
+                              uint32_t iterations = 10,
+                              ThreadPool& pool = ThreadPool::global());
+  } // namespace skinning
+} // namespace engine::mesh
@@ -0,0 +1,205 @@
+#pragma once
+
+#include "engine/mesh/mesh_material.hpp"
+#include "engine/texture/texture_atlas.hpp"
+#include "engine/texture/texture_streamer.hpp"
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <gl/buffer.hpp>
+#include <optional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace engine::mesh {
+  /// <summary>
+  /// Index of a material in a MaterialRegistry's GPU table.
+  /// </summary>
+  using MaterialIndex = uint32_t;
+
+  /// <summary>
+  /// Owns the textures of every unique material and a persistent GPU table of
+  /// their handles. Draws reference a material by its 32 bit index, so the
+  /// handles are written once when the material is added rather than per draw
+  /// each frame.
+  /// </summary>
+  /// <remarks>
+  /// Shader interface: SSBO at the binding given to bind,
+  /// struct { uvec2 diffuse; uvec2 bump; uvec2 material; uint layer;
+  /// uint flags; vec2 uvScale; vec2 uvOffset; }[].
+  /// With FLAG_ATLAS set, the handles are sampler2DArray handles of a
+  /// TextureAtlas, sampled at vec3(uv * uvScale + uvOffset, layer).
+  /// With a TextureStreamer set, .ktx2 textures are streamed and their table
+  /// entries rewritten whenever the streamer replaces them.
+  /// </remarks>
+  class MaterialRegistry {
+  public:
+    /// <summary>
+    /// GpuMaterial::flags bit set when the material is packed in an atlas.
+    /// </summary>
+    constexpr static uint32_t FLAG_ATLAS = 1;
+
+    /// <summary>
+    /// A material's entry in the GPU table, std430 compatible.
+    /// </summary>
+    struct GpuMaterial {
+      gl::RawTextureHandle diffuse = 0;
+      gl::RawTextureHandle bump = 0;
+      gl::RawTextureHandle material = 0;
+      uint32_t layer = 0;
+      uint32_t flags = 0;
+      glm::vec2 uvScale = glm::vec2(1.0f);
+      glm::vec2 uvOffset = glm::vec2(0.0f);
+    };
+    static_assert(sizeof(GpuMaterial) == 48,
+                  "GpuMaterial must match the std430 layout");
+
+    /// <summary>
+    /// Creates the material table, persistently mapped.
+    /// </summary>
+    /// <param name="capacity">Most materials the registry can hold</param>
+    explicit MaterialRegistry(uint32_t capacity);
+
+    MaterialRegistry(const MaterialRegistry&) = delete;
+    MaterialRegistry& operator=(const MaterialRegistry&) = delete;
+
+    /// <summary>
+    /// Streams the prebuilt mips of materials loaded from now on through the
+    /// streamer, which must outlive the registry. nullptr loads them whole.
+    /// </summary>
+    void setStreamer(engine::texture::TextureStreamer* textureStreamer) {
+      streamer = textureStreamer;
+    }
+
+    /// <summary>
+    /// Stages texture uploads through the ring, which must outlive the
+    /// registry. nullptr uploads from client memory.
+    /// </summary>
+    void setUploadRing(engine::texture::UploadRing* ring) { uploadRing = ring; }
+
+    /// <summary>
+    /// Packs materials made only of small decoded images into the atlas,
+    /// which must outlive the registry. nullptr gives every texture its own
+    /// texture object.
+    /// </summary>
+    void setAtlas(engine::texture::TextureAtlas* textureAtlas) {
+      atlas = textureAtlas;
+    }
+
+    /// <summary>
+    /// Returns the index of the material, loading its textures if no equal
+    /// material (same base path and entries) has been loaded yet.
+    /// The material is made resident.
+    /// </summary>
+    std::expected<MaterialIndex, std::string>
+    load(const MaterialEntry& entry, const std::string& basePath);
+
+    /// <summary>
+    /// Loads several materials, decoding the textures of every material not
+    /// loaded yet in parallel on the pool, then uploading them in order.
+    /// </summary>
+    /// <returns>The index or error of each entry, in the order given</returns>
+    std::vector<std::expected<MaterialIndex, std::string>>
+    loadAll(std::span<const MaterialEntry> entries, const std::string& basePath,
+            engine::ThreadPool& pool = engine::ThreadPool::global());
+
+    /// <summary>
+    /// Adds a material from decoded textures, streaming the prebuilt mips of
+    /// .ktx2 textures if a streamer is set. It is not shared with other
+    /// materials. Must run on the GL thread.
+    /// </summary>
+    std::expected<MaterialIndex, std::string> add(DecodedTextureSet&& decoded);
+
+    /// <summary>
+    /// Adds a material from already loaded textures. It is not shared with
+    /// other materials. The material is made resident.
+    /// </summary>
+    std::expected<MaterialIndex, std::string> add(TextureSet&& textureSet);
+
+    /// <summary>
+    /// Makes the textures of a material resident or non-resident. Shaders
+    /// must not sample a non-resident material. Streamed textures are left to
+    /// the streamer, atlas materials stay resident.
+    /// </summary>
+    void setResident(MaterialIndex index, bool resident);
+    bool isResident(MaterialIndex index) const {
+      return materials[index].resident;
+    }
+
+    /// <summary>
+    /// Reports the material as drawn this frame at the given on-screen size
+    /// in pixels, so its streamed textures are kept and refined.
+    /// </summary>
+    void reportUsage(MaterialIndex index, float screenSize);
+
+    const TextureSet& get(MaterialIndex index) const {
+      return materials[index].textures;
+    }
+
+    uint32_t size() const { return static_cast<uint32_t>(materials.size()); }
+    uint32_t capacity() const { return maxMaterials; }
+
+    /// <summary>
+    /// Binds the material table to the given shader storage binding.
+    /// </summary>
+    void bind(GLuint binding) const {
+      buffer.bindBase(gl::Buffer::StorageTarget::STORAGE, binding);
+    }
+
+  protected:
+    using HandleSlot = gl::RawTextureHandle TextureHandleSet::*;
+    using StreamedSlots =
+        std::array<std::optional<engine::texture::TextureStreamer::TextureId>,
+                   3>;
+
+    struct Entry {
+      TextureSet textures;
+      /// <summary>
+      /// Streamer ids of the diffuse, bump and material textures, if
+      /// streamed.
+      /// </summary>
+      StreamedSlots streamed;
+      /// <summary>
+      /// Region of the atlas the textures are packed in, if packed.
+      /// </summary>
+      std::optional<engine::texture::AtlasRegion> atlasRegion;
+      bool resident = false;
+    };
+
+    /// <summary>
+    /// Handle slots in the order of Entry::streamed.
+    /// </summary>
+    constexpr static std::array<HandleSlot, 3> HANDLE_SLOTS = {
+        &TextureHandleSet::diffuse,
+        &TextureHandleSet::bump,
+        &TextureHandleSet::material,
+    };
+
+    uint32_t maxMaterials;
+    gl::Buffer buffer;
+    gl::Mapping mapping;
+
+    std::vector<Entry> materials;
+    /// <summary>
+    /// Loaded materials by base path and entries.
+    /// </summary>
+    std::unordered_map<std::string, MaterialIndex> loaded;
+    engine::texture::TextureStreamer* streamer = nullptr;
+    engine::texture::UploadRing* uploadRing = nullptr;
+    engine::texture::TextureAtlas* atlas = nullptr;
+
+    void writeEntry(MaterialIndex index);
+    /// <summary>
+    /// Key of a material in loaded, its base path and entries.
+    /// </summary>
+    static std::string makeKey(const MaterialEntry& entry,
+                               const std::string& basePath);
+    /// <summary>
+    /// Packs the material into the atlas if every channel is a small decoded
+    /// image of one size.
+    /// </summary>
+    std::optional<MaterialIndex> addToAtlas(DecodedTextureSet& decoded);
+  };
+} // namespace engine::mesh
@@ -18,13 +18,18 @@ _-_-_-_-_-_-_-""  ""
 
 #pragma once
 
+#include "engine/mesh/compressed_animation.hpp"
 #include "engine/mesh/mesh_animation.hpp"
 #include "engine/mesh/mesh_data.hpp"
+#include "engine/mesh/material_registry.hpp"
 #include "engine/mesh/mesh_material.hpp"
+#include "engine/mesh/meshlet.hpp"
 #include <array>
 #include <gl/gl.hpp>
 #include <glm/glm.hpp>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -100,10 +105,22 @@ namespace engine::mesh {
     /// </summary>
     void BatchSubmeshes(GLuint offset);
 
-    GLuint writeBatchedDraws(gl::MappingRef& mapping, GLuint baseVertex,
-                             GLuint instances, GLuint baseInstance) const;
+    /// <summary>
+    /// Writes a draw command for each sub mesh stored with the given index
+    /// type, and its material index alongside, so the n-th material index
+    /// matches the n-th draw of the MultiDraw call for that index type.
+    /// </summary>
+    /// <returns>Number of draws written, 0 with neither mapping advanced if
+    /// they do not fit</returns>
+    GLuint writeBatchedDraws(gl::MappingRef& mapping,
+                             gl::MappingRef& materialMapping, GLuint baseVertex,
+                             GLuint instances, GLuint baseInstance,
+                             gl::IndexType indexType) const;
 
-    void writeTextureSets(gl::MappingRef& mapping) const;
+    /// <summary>
+    /// Number of sub meshes stored with the given index type.
+    /// </summary>
+    GLuint GetSubMeshCount(gl::IndexType indexType) const;
 
     unsigned int GetVertexCount() const { return vertexCount; }
 
@@ -116,35 +133,99 @@ namespace engine::mesh {
     bool GetSubMesh(int i, const mesh::SubMesh* s) const;
     bool GetSubMesh(const std::string& name, const mesh::SubMesh* s) const;
 
+    /// <summary>
+    /// Creates a mesh from its data and the MaterialRegistry index of each
+    /// sub mesh's material.
+    /// </summary>
     Mesh(const engine::mesh::Data& meshData,
-         std::vector<TextureSet>&& textureSets);
+         std::vector<MaterialIndex>&& materials);
+
+    MaterialIndex getMaterial(size_t subMesh) const {
+      return materials[subMesh];
+    }
 
     void writeVertexData(const engine::mesh::Data& meshData,
                          GLuint& vertexStartIndex,
                          const gl::MappingRef stagingMapping);
 
+    /// <summary>
+    /// Writes each sub mesh's indices, as 16 bit wherever its vertex range
+    /// fits, and 32 bit otherwise. 32 bit ranges are aligned to 4 bytes.
+    /// </summary>
+    /// <param name="indexOffset">Byte offset into the index buffer the
+    /// mapping starts at. Advanced past the written data, aligned to 4
+    /// bytes.</param>
     void writeIndexData(const engine::mesh::Data& meshData, GLuint& indexOffset,
                         const gl::MappingRef stagingMapping);
 
+    /// <summary>
+    /// Bytes writeIndexData advances indexOffset by, when it starts aligned to
+    /// 4 bytes.
+    /// </summary>
+    GLuint getIndexDataSize() const;
+
     void writeJointData(const engine::mesh::Data& meshData,
                         const engine::mesh::Animation& animation,
                         const gl::MappingRef stagingMapping,
                         uint32_t jointStartIndex);
 
+    /// <summary>
+    /// Animates the mesh with a compressed animation, sampled per instance
+    /// into a joint palette, instead of baked per frame matrices. Left
+    /// unanimated if the inverse bind pose has fewer joints than it.
+    /// </summary>
+    void setAnimation(const engine::mesh::Data& meshData,
+                      std::shared_ptr<const CompressedAnimation> animation);
+
+    /// <summary>
+    /// Compressed animation set by setAnimation, or nullptr.
+    /// </summary>
+    const CompressedAnimation* getAnimation() const { return animation.get(); }
+
+    /// <summary>
+    /// Samples the compressed animation into a skinning palette.
+    /// </summary>
+    /// <param name="time">Time in seconds</param>
+    /// <param name="palette">Output, getJointCount() long</param>
+    void samplePalette(float time, std::span<glm::mat4> palette) const;
+
     GLuint getVertexOffset() const { return vertexOffset; }
     GLuint getFrameCount() const { return frameCount; }
     GLuint getJointCount() const { return jointCount; }
     GLuint getStartJointIndex() const { return startJointIndex; }
     float getOneOverFrameRate() const { return oneOverFrameRate; }
 
+    /// <summary>
+    /// Meshlets of every sub mesh, built from the mesh data on creation.
+    /// Bounds are in bind pose for skinned meshes.
+    /// </summary>
+    const Meshlets& getMeshlets() const { return meshlets; }
+
   protected:
     GLuint vertexOffset = 0;
 
     /// <summary>
-    /// Number of indices into the buffer where index data starts.
-    /// Same as the byte offset / sizeof(uint32_t)
+    /// Where a sub mesh's indices live in the index buffer.
     /// </summary>
-    GLuint indexOffset = 0;
+    struct LayerIndices {
+      gl::IndexType type = gl::IndexType::U32;
+      /// <summary>
+      /// Number of indices, clamped to the index data.
+      /// </summary>
+      GLuint count = 0;
+      /// <summary>
+      /// First index in the buffer, in elements of type (byte offset /
+      /// indexTypeSize(type)).
+      /// </summary>
+      GLuint firstIndex = 0;
+      /// <summary>
+      /// Lowest vertex the sub mesh uses. Subtracted from the stored indices
+      /// and added to the draw's baseVertex, so more sub meshes fit 16 bits.
+      /// </summary>
+      GLuint vertexBias = 0;
+    };
+
+    std::vector<LayerIndices> layerIndices;
 
     /// <summary>
     /// Index of the first joint for this mesh (relative to the other joints in
@@ -165,6 +246,11 @@ namespace engine::mesh {
     std::vector<mesh::SubMesh> meshLayers;
     std::vector<std::string> layerNames;
 
-    std::vector<TextureSet> textureSets;
+    std::vector<MaterialIndex> materials;
+
+    Meshlets meshlets;
+
+    std::shared_ptr<const CompressedAnimation> animation = nullptr;
+    std::vector<glm::mat4> inverseBindPose;
   };
 } // namespace engine::mesh
@@ -1,8 +1,10 @@
 #pragma once
 
+#include "engine/mesh/mesh_optimizer.hpp"
 #include <expected>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <optional>
 #include <string>
 #include <vector>
 
@@ -15,12 +17,17 @@ namespace engine::mesh {
   class Data {
   public:
     /// <summary>
-    /// Loads a .msh file from disk.
+    /// Loads a .msh file from disk, optimizing it unless optimizeSettings is
+    /// nullopt.
     /// </summary>
     /// <param name="name">File path</param>
+    /// <param name="optimizeSettings">Passes of optimize to run on
+    /// load</param>
     /// <returns>Mesh on success, error string on failure</returns>
     static std::expected<Data, std::string>
-    fromFile(const std::string_view& name);
+    fromFile(const std::string_view& name,
+             const std::optional<OptimizeSettings>& optimizeSettings =
+                 OptimizeSettings{});
 
     // static std::expected<Data, std::string>
     // fromGLTFFile(const std::string_view& name);
@@ -36,6 +43,16 @@ namespace engine::mesh {
          std::vector<SubMesh>&& meshLayers,
          std::vector<std::string>&& layerNames);
 
+    /// <summary>
+    /// Welds duplicate vertices, then reorders each sub mesh's triangles for
+    /// vertex cache locality and overdraw, and the vertices for fetch
+    /// locality. Meant to run once at import / cook time, before the data is
+    /// written to the GPU.
+    /// </summary>
+    /// <param name="settings">Which passes to run</param>
+    /// <returns>Simulated vertex cache stats before and after</returns>
+    OptimizeReport optimize(const OptimizeSettings& settings = {});
+
     const std::vector<glm::vec3>& vertices() const { return _vertices; }
     const std::vector<glm::vec4>& colors() const { return _colors; }
     const std::vector<glm::vec2>& textureCoords() const {
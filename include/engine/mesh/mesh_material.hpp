@@ -1,10 +1,14 @@
 #pragma once
 
+#include "engine/image.hpp"
+#include "engine/texture/compressed_image.hpp"
+#include <array>
 #include <expected>
 #include <gl/texture.hpp>
 #include <map>
 #include <optional>
 #include <string>
+#include <variant>
 #include <vector>
 
 namespace engine::mesh {
@@ -25,6 +29,20 @@ namespace engine::mesh {
     TextureHandleSet handles;
   };
 
+  /// <summary>
+  /// A texture decoded on the CPU, not yet uploaded: a decoded image, or the
+  /// prebuilt compressed mips of a .ktx2 file.
+  /// </summary>
+  using DecodedTexture =
+      std::variant<engine::Image, engine::texture::CompressedImage>;
+
+  /// <summary>
+  /// Decoded textures of a material: diffuse, bump and material.
+  /// </summary>
+  struct DecodedTextureSet {
+    std::array<std::optional<DecodedTexture>, 3> channels;
+  };
+
   class MaterialEntry {
   public:
     std::map<std::string, std::string> entries;
@@ -37,6 +55,41 @@ namespace engine::mesh {
       return i->second;
     }
 
+    /// <summary>
+    /// Texture channels in the order of DecodedTextureSet::channels.
+    /// </summary>
+    constexpr static std::array<const char*, 3> CHANNELS = {
+        "Diffuse", "Bump", "Material"};
+
+    /// <summary>
+    /// Reads and decodes every texture of the material in parallel. Touches
+    /// no OpenGL state, so it can run on any thread.
+    /// </summary>
+    std::expected<DecodedTextureSet, std::string>
+    DecodeTextures(const std::string& basePath,
+                   engine::ThreadPool& pool = engine::ThreadPool::global())
+        const;
+
+    /// <summary>
+    /// Uploads a decoded channel with its filtering set up and a bindless
+    /// handle created. Must run on the GL thread.
+    /// </summary>
+    /// <param name="channel">Index into CHANNELS</param>
+    /// <param name="ring">Ring to stage the texels through, if any</param>
+    static gl::Texture
+    UploadTexture(size_t channel, DecodedTexture& texture,
+                  engine::texture::UploadRing* ring = nullptr);
+
+    /// <summary>
+    /// Uploads every decoded channel. Must run on the GL thread.
+    /// </summary>
+    static std::expected<TextureSet, std::string>
+    UploadTextures(DecodedTextureSet&& decoded,
+                   engine::texture::UploadRing* ring = nullptr);
+
+    /// <summary>
+    /// Decodes then uploads the material's textures.
+    /// </summary>
     std::expected<TextureSet, std::string>
     LoadTextures(const std::string& basePath) const;
   };
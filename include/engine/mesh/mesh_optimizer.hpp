@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace engine::mesh {
+  /// <summary>
+  /// Post-transform vertex cache statistics for an index buffer, from a
+  /// simulated FIFO cache.
+  /// </summary>
+  struct VertexCacheStats {
+    /// <summary>
+    /// Average cache miss ratio. Vertex shader invocations per triangle, 0.5
+    /// is ideal for large grids, 3.0 is the worst case.
+    /// </summary>
+    float acmr = 0.0f;
+    /// <summary>
+    /// Average transformed vertex ratio. Vertex shader invocations per
+    /// referenced vertex, 1.0 is ideal.
+    /// </summary>
+    float atvr = 0.0f;
+    uint32_t misses = 0;
+    uint32_t triangles = 0;
+  };
+
+  /// <summary>
+  /// Which stages Data::optimize runs.
+  /// </summary>
+  struct OptimizeSettings {
+    bool weldVertices = true;
+    bool optimizeVertexCache = true;
+    bool optimizeOverdraw = true;
+    bool optimizeVertexFetch = true;
+    /// <summary>
+    /// How much ACMR the overdraw pass may give up, as a ratio (1.05 allows
+    /// 5% worse ACMR).
+    /// </summary>
+    float overdrawThreshold = 1.05f;
+    /// <summary>
+    /// Size of the simulated FIFO cache used for the before / after report.
+    /// </summary>
+    uint32_t reportCacheSize = 16;
+  };
+
+  /// <summary>
+  /// Result of Data::optimize.
+  /// </summary>
+  struct OptimizeReport {
+    VertexCacheStats before;
+    VertexCacheStats after;
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+  };
+
+  /// <summary>
+  /// Index and vertex reordering passes, run on mesh::Data at import or cook
+  /// time. All passes are CPU only.
+  /// </summary>
+  namespace optimizer {
+    /// <summary>
+    /// Simulates a FIFO post-transform cache over a triangle list.
+    /// </summary>
+    /// <param name="indices">Triangle list</param>
+    /// <param name="vertexCount">Number of vertices the indices address</param>
+    /// <param name="cacheSize">Number of entries in the cache</param>
+    VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices,
+                                        size_t vertexCount,
+                                        uint32_t cacheSize = 16);
+
+    /// <summary>
+    /// Reorders triangles in place for post-transform cache locality (Tom
+    /// Forsyth's linear-speed vertex cache optimisation).
+    /// </summary>
+    void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount);
+
+    /// <summary>
+    /// Reorders clusters of triangles in place so outward facing clusters draw
+    /// first, reducing overdraw. Should run after optimizeVertexCache, as it
+    /// only splits the order where that costs little cache efficiency.
+    /// </summary>
+    /// <param name="threshold">Allowed ACMR ratio over the input order</param>
+    void optimizeOverdraw(std::span<uint32_t> indices,
+                          std::span<const glm::vec3> positions,
+                          float threshold = 1.05f);
+
+    /// <summary>
+    /// Builds a remap table putting vertices in the order the index buffer
+    /// first uses them. Unreferenced vertices are kept, after all referenced
+    /// ones.
+    /// </summary>
+    /// <returns>remap[oldIndex] = newIndex</returns>
+    std::vector<uint32_t>
+    generateVertexFetchRemap(std::span<const uint32_t> indices,
+                             size_t vertexCount);
+
+    /// <summary>
+    /// Applies a remap table to a vertex stream. Empty streams are left
+    /// untouched.
+    /// </summary>
+    template <typename T>
+    void remapVertexStream(std::vector<T>& stream,
+                           std::span<const uint32_t> remap,
+                           size_t newVertexCount) {
+      if (stream.empty()) {
+        return;
+      }
+      std::vector<T> remapped(newVertexCount);
+      for (size_t i = 0; i < remap.size() && i < stream.size(); ++i) {
+        remapped[remap[i]] = stream[i];
+      }
+      stream = std::move(remapped);
+    }
+
+    /// <summary>
+    /// Rewrites indices in place through a remap table.
+    /// </summary>
+    void remapIndices(std::span<uint32_t> indices,
+                      std::span<const uint32_t> remap);
+  } // namespace optimizer
+} // namespace engine::mesh
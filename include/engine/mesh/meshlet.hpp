@@ -0,0 +1,111 @@
+#pragma once
+
+#include "engine/frustum.hpp"
+#include "engine/mesh/mesh_data.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+namespace engine::mesh {
+  /// <summary>
+  /// A small cluster of triangles from one sub mesh. std430 compatible, so the
+  /// array can be uploaded as is for a GPU culling pass.
+  /// </summary>
+  struct Meshlet {
+    /// <summary>
+    /// Offset into Meshlets::vertices
+    /// </summary>
+    uint32_t vertexOffset;
+    /// <summary>
+    /// Offset into Meshlets::triangles, in bytes (3 per triangle)
+    /// </summary>
+    uint32_t triangleOffset;
+    uint32_t vertexCount;
+    uint32_t triangleCount;
+  };
+
+  /// <summary>
+  /// Culling bounds of a meshlet, in mesh space. std430 compatible.
+  /// </summary>
+  struct MeshletBounds {
+    /// <summary>
+    /// xyz centre, w radius
+    /// </summary>
+    glm::vec4 sphere;
+    /// <summary>
+    /// xyz apex of the normal cone, w unused
+    /// </summary>
+    glm::vec4 coneApex;
+    /// <summary>
+    /// xyz cone axis, w cutoff. The meshlet is entirely backfacing when
+    /// dot(normalize(apex - eye), axis) >= cutoff. A cutoff of 1 disables the
+    /// test.
+    /// </summary>
+    glm::vec4 cone;
+  };
+
+  static_assert(sizeof(Meshlet) == 16, "Meshlet must match the std430 layout");
+  static_assert(sizeof(MeshletBounds) == 48,
+                "MeshletBounds must match the std430 layout");
+
+  /// <summary>
+  /// Meshlets for every sub mesh of a mesh, with their bounds.
+  /// </summary>
+  class Meshlets {
+  public:
+    constexpr static uint32_t MAX_VERTICES = 64;
+    constexpr static uint32_t MAX_TRIANGLES = 124;
+
+    Meshlets() = default;
+
+    /// <summary>
+    /// Splits each sub mesh into meshlets, greedily in index order. Run after
+    /// Data::optimize for tighter clusters.
+    /// </summary>
+    /// <param name="data">Mesh to split</param>
+    /// <param name="maxVertices">Vertex limit per meshlet, at most 255</param>
+    /// <param name="maxTriangles">Triangle limit per meshlet</param>
+    static Meshlets build(const Data& data,
+                          uint32_t maxVertices = MAX_VERTICES,
+                          uint32_t maxTriangles = MAX_TRIANGLES);
+
+    /// <summary>
+    /// Appends the indices of meshlets that are inside the frustum and not
+    /// entirely backfacing.
+    /// </summary>
+    /// <param name="frustum">World space frustum</param>
+    /// <param name="model">Mesh to world transform</param>
+    /// <param name="cameraPosition">World space camera position</param>
+    /// <param name="visible">Visible meshlet indices are appended here</param>
+    /// <returns>Number of meshlets appended</returns>
+    size_t cull(const Frustum& frustum, const glm::mat4& model,
+                const glm::vec3& cameraPosition,
+                std::vector<uint32_t>& visible) const;
+
+    const std::vector<Meshlet>& meshlets() const { return _meshlets; }
+    const std::vector<MeshletBounds>& bounds() const { return _bounds; }
+    /// <summary>
+    /// Mesh vertex index for each meshlet local vertex.
+    /// </summary>
+    const std::vector<uint32_t>& vertices() const { return _vertices; }
+    /// <summary>
+    /// Meshlet local vertex indices, 3 per triangle.
+    /// </summary>
+    const std::vector<uint8_t>& triangles() const { return _triangles; }
+    /// <summary>
+    /// Range of meshlets belonging to each sub mesh, in the order of
+    /// Data::meshLayers.
+    /// </summary>
+    const std::vector<SubMesh>& subMeshes() const { return _subMeshes; }
+
+    size_t size() const { return _meshlets.size(); }
+    bool empty() const { return _meshlets.empty(); }
+
+  protected:
+    std::vector<Meshlet> _meshlets = {};
+    std::vector<MeshletBounds> _bounds = {};
+    std::vector<uint32_t> _vertices = {};
+    std::vector<uint8_t> _triangles = {};
+    std::vector<SubMesh> _subMeshes = {};
+  };
+} // namespace engine::mesh
@@ -1,12 +1,40 @@
 #pragma once
 
+#include "engine/animation_lod.hpp"
+#include "engine/command_list.hpp"
 #include "engine/mesh/mesh.hpp"
 #include "engine/scene_node.hpp"
+#include "engine/skinning_scheduler.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
 #include <memory>
+#include <vector>
 
 namespace engine::scene {
+  /// <summary>
+  /// Scene node drawing a mesh through the batched indirect draws, skinned
+  /// if the mesh is animated.
+  /// </summary>
+  /// <remarks>
+  /// Shader interface of the batched draws:
+  /// - uniform uint (location DRAW_BASE_LOCATION): batch index of the
+  ///   MultiDraw call's first draw. The material of a draw is at
+  ///   gl_DrawID + drawBase in the draw material table. 0 for the batch
+  ///   drawn as one call; record sets it per node and resets it to 0.
+  /// </remarks>
   class MeshNode : public engine::scene::Node {
   public:
+    /// <summary>
+    /// Uniform location of the draw base, see the shader interface.
+    /// </summary>
+    constexpr static GLint DRAW_BASE_LOCATION = 8;
+    /// <summary>
+    /// Poses sampled per frame of a clip at full update rate.
+    /// </summary>
+    constexpr static uint32_t POSE_STEPS_PER_FRAME = 4;
+
     MeshNode() = delete;
 
     MeshNode(const std::shared_ptr<engine::mesh::Mesh>& mesh)
@@ -16,11 +44,24 @@ namespace engine::scene {
     virtual ~MeshNode() = default;
 
     void update(const engine::FrameInfo& info) override {
-      if (mesh->getFrameCount() > 0) {
-        frameTime -= info.frameDelta;
-        while (frameTime < 0.0f) {
-          frameTime += mesh->getOneOverFrameRate();
-          currentFrame = (currentFrame + 1) % mesh->getFrameCount();
+      bool animated =
+          mesh->getAnimation() != nullptr || mesh->getFrameCount() > 0;
+      if (animated) {
+        pendingTime += info.frameDelta;
+        uint32_t interval =
+            info.animationLod != nullptr
+                ? info.animationLod->getUpdateInterval(
+                      glm::vec3(GetTransforms().world[3]),
+                      GetBoundingRadius())
+                : 1;
+        // Nodes updated less often need a coarser pose, and share it with
+        // more instances
+        poseSteps = POSE_STEPS_PER_FRAME /
+                    std::clamp(interval, 1u, POSE_STEPS_PER_FRAME);
+        if (engine::AnimationLod::shouldUpdate(info.frameIndex, lodPhase(),
+                                               interval)) {
+          advanceAnimation(pendingTime);
+          pendingTime = 0.0f;
         }
       }
 
@@ -32,58 +73,205 @@ namespace engine::scene {
           .instances = 1,
           .maxIndirectCmds = mesh->GetSubMeshCount(),
           .maxVertices = mesh->GetVertexCount(),
+          .maxPaletteJoints =
+              mesh->getAnimation() ? mesh->getJointCount() : 0,
       };
       return params + engine::scene::Node::getBatchDrawParams();
     }
 
-    virtual void skinVertices(uint32_t& baseVertex) {
-      this->baseVertex = baseVertex;
+    virtual void writeJointPalettes(gl::MappingRef& mapping,
+                                    GLuint& paletteJoints) override {
+      if (const auto* animation = mesh->getAnimation()) {
+        // Quantised to a fraction of a clip frame, so playback stays
+        // interpolated while instances at nearby times share a pose, and a
+        // pose stays cached until the node moves past its step
+        float stepRate = animation->GetFrameRate() * POSE_STEPS_PER_FRAME;
+        uint32_t stride = POSE_STEPS_PER_FRAME / poseSteps;
+        poseKey = stepRate > 0.0f
+                      ? static_cast<uint32_t>(animationTime * stepRate) /
+                            stride * stride
+                      : 0;
+
+        palette.resize(mesh->getJointCount());
+        mesh->samplePalette(
+            stepRate > 0.0f ? static_cast<float>(poseKey) / stepRate : 0.0f,
+            palette);
+
+        // Sampled on the CPU side first, as sampling reads back parent
+        // joints and mapped memory is slow to read
+        auto out = mapping.reserve<glm::mat4>(palette.size());
+        if (out.size() == palette.size()) {
+          std::copy(palette.begin(), palette.end(), out.begin());
+        }
 
-      glm::uvec4 uInfo(mesh->getVertexOffset(), mesh->getStartJointIndex(),
-                       mesh->getJointCount(), baseVertex);
+        paletteStart = paletteJoints;
+        paletteJoints += mesh->getJointCount();
+      }
 
-      glUniform4uiv(0, 1, &uInfo.x);
-      glUniform1ui(1, currentFrame);
+      engine::scene::Node::writeJointPalettes(mapping, paletteJoints);
+    }
 
-      glDispatchCompute(mesh->GetVertexCount(), 1, 1);
+    virtual void skinVertices(engine::SkinningScheduler& scheduler) override {
+      // A sampled palette is a single pose, keyed by its sample step
+      const auto* animation = mesh->getAnimation();
+      uint32_t frame = animation ? poseKey : currentFrame;
+      baseVertex = scheduler.add(
+          {.mesh = mesh.get(), .animation = animation, .frame = frame},
+          mesh->getVertexOffset(),
+          animation ? paletteStart : mesh->getStartJointIndex(),
+          mesh->getJointCount(), animation ? 0 : currentFrame,
+          mesh->GetVertexCount());
 
-      baseVertex += mesh->GetVertexCount();
+      engine::scene::Node::skinVertices(scheduler);
+    }
 
-      engine::scene::Node::skinVertices(baseVertex);
+    virtual void
+    reportTextureUsage(engine::mesh::MaterialRegistry& registry,
+                       float screenSize) const override {
+      for (size_t i = 0; i < mesh->GetSubMeshCount(); ++i) {
+        registry.reportUsage(mesh->getMaterial(i), screenSize);
+      }
     }
 
-    virtual void writeInstanceData(gl::MappingRef& mapping, GLuint& instances,
-                                   gl::MappingRef& textureMapping) override {
-      auto modelMatrix = getModelMatrix();
-      mapping.write(&modelMatrix, sizeof(glm::mat4));
-      mapping += sizeof(glm::mat4);
+    virtual void writeInstanceData(gl::MappingRef& mapping,
+                                   GLuint& instances) override {
+      mapping.emplace<glm::mat4>(getModelMatrix());
 
       baseInstance = instances;
       instances += 1;
 
-      mesh->writeTextureSets(textureMapping);
-
-      engine::scene::Node::writeInstanceData(mapping, instances,
-                                             textureMapping);
+      engine::scene::Node::writeInstanceData(mapping, instances);
     }
 
     virtual void writeBatchedDraws(gl::MappingRef& mapping,
-                                   GLuint& writtenDraws) const override {
-      auto written =
-          mesh->writeBatchedDraws(mapping, baseVertex, 1, baseInstance);
+                                   gl::MappingRef& materialMapping,
+                                   GLuint& writtenDraws,
+                                   gl::IndexType indexType) const override {
+      auto& draws = batchedDraws[batchedDrawSlot(indexType)];
+      draws.offset = mapping.getOffset();
+      draws.first = writtenDraws;
+
+      auto written = mesh->writeBatchedDraws(
+          mapping, materialMapping, baseVertex, 1, baseInstance, indexType);
+      draws.count = written;
       writtenDraws += written;
 
-      engine::scene::Node::writeBatchedDraws(mapping, writtenDraws);
+      engine::scene::Node::writeBatchedDraws(mapping, materialMapping,
+                                             writtenDraws, indexType);
+    }
+
+    /// <summary>
+    /// Records the draws last written by writeBatchedDraws, as a MultiDraw
+    /// call per index type, so write the frame's draws first. Expects the
+    /// program, VAO, indirect buffer and material table to be bound, as the
+    /// batched path does. The mapping given to writeBatchedDraws must start
+    /// at the start of the indirect buffer.
+    /// </summary>
+    virtual void record(engine::CommandList& commands,
+                        const engine::Frustum& /*frustum*/) const override {
+      bool recorded = false;
+      for (auto indexType : {gl::IndexType::U16, gl::IndexType::U32}) {
+        const auto& draws = batchedDraws[batchedDrawSlot(indexType)];
+        if (draws.count == 0) {
+          continue;
+        }
+        commands.setUniform(DRAW_BASE_LOCATION, draws.first);
+        commands.multiDrawElementsIndirect(
+            GL_TRIANGLES, static_cast<GLenum>(indexType), draws.offset,
+            static_cast<GLsizei>(draws.count), 0);
+        recorded = true;
+      }
+      // The program is shared with the batch drawn as one call
+      if (recorded) {
+        commands.setUniform(DRAW_BASE_LOCATION, 0u);
+      }
     }
 
     void setFrame(uint32_t newFrame) { currentFrame = newFrame; }
 
+    /// <summary>
+    /// Advances the animation by the given time in O(1), however long it is.
+    /// </summary>
+    void advanceAnimation(float delta) {
+      if (auto* animation = mesh->getAnimation()) {
+        float duration = animation->GetDuration();
+        if (duration > 0.0f) {
+          animationTime = std::fmod(animationTime + delta, duration);
+        }
+        return;
+      }
+
+      uint32_t frameCount = mesh->getFrameCount();
+      float period = mesh->getOneOverFrameRate();
+      if (frameCount == 0 || period <= 0.0f) {
+        return;
+      }
+
+      // frameTime counts down to the next frame
+      frameTime -= delta;
+      if (frameTime < 0.0f) {
+        float overshoot = -frameTime;
+        float steps = std::floor(overshoot / period) + 1.0f;
+        frameTime = period - std::fmod(overshoot, period);
+        currentFrame = static_cast<uint32_t>(
+            (currentFrame +
+             static_cast<uint64_t>(
+                 std::fmod(steps, static_cast<float>(frameCount)))) %
+            frameCount);
+      }
+    }
+
   protected:
     std::shared_ptr<engine::mesh::Mesh> mesh;
 
+    /// <summary>
+    /// Spreads nodes over the frames of a reduced update interval.
+    /// </summary>
+    uint32_t lodPhase() const {
+      return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(this) >> 4);
+    }
+
+    /// <summary>
+    /// Where writeBatchedDraws last wrote the draws of an index type.
+    /// </summary>
+    struct BatchedDraws {
+      /// <summary>
+      /// Byte offset of the first command in the indirect buffer.
+      /// </summary>
+      GLuint offset = 0;
+      /// <summary>
+      /// Index of the first draw in the batch, and of its material.
+      /// </summary>
+      GLuint first = 0;
+      GLuint count = 0;
+    };
+    mutable std::array<BatchedDraws, 2> batchedDraws;
+
+    static size_t batchedDrawSlot(gl::IndexType indexType) {
+      return indexType == gl::IndexType::U16 ? 0 : 1;
+    }
+
     uint32_t baseVertex = 0;
     float frameTime = 0.0f;
     uint32_t currentFrame = 0;
     uint32_t baseInstance = 0;
+
+    float animationTime = 0.0f;
+    /// <summary>
+    /// Time not yet applied to the animation, while the LOD skips updates.
+    /// </summary>
+    float pendingTime = 0.0f;
+    uint32_t paletteStart = 0;
+    /// <summary>
+    /// Step of the clip the palette was sampled at, in
+    /// 1 / POSE_STEPS_PER_FRAME clip frames.
+    /// </summary>
+    uint32_t poseKey = 0;
+    /// <summary>
+    /// Steps per clip frame the pose is sampled at, lower for nodes the
+    /// animation LOD updates less often.
+    /// </summary>
+    uint32_t poseSteps = POSE_STEPS_PER_FRAME;
+    std::vector<glm::mat4> palette;
   };
 } // namespace engine::scene
\ No newline at end of file
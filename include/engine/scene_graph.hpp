@@ -1,6 +1,8 @@
 #pragma once
 
 #include "camera.hpp"
+#include "engine/animation_lod.hpp"
+#include "engine/command_list.hpp"
 #include "engine/scene_node.hpp"
 #include "frame_info.hpp"
 #include <engine/frustum.hpp>
@@ -18,7 +20,8 @@ namespace engine {
 
       // Update parent pointers after move. Lets Graph & root sit on stack.
       // Maybe a minor performance benefit?
-      inline Graph(Graph&& o) noexcept {
+      inline Graph(Graph&& o) noexcept
+          : m_animationLod(std::move(o.m_animationLod)) {
         m_roots = std::move(o.m_roots);
         for (auto& root : m_roots) {
           for (auto& child : root->GetChildren()) {
@@ -29,6 +32,7 @@ namespace engine {
       inline Graph& operator=(Graph&& o) noexcept {
         if (this != &o) {
           m_roots = std::move(o.m_roots);
+          m_animationLod = std::move(o.m_animationLod);
           for (auto& root : m_roots) {
             for (auto& child : root->GetChildren()) {
               child->SetParent(root.get());
@@ -94,10 +98,42 @@ namespace engine {
             node.node->render(frustum);
           }
         }
+
+        /// <summary>
+        /// Records nodes into command lists on the thread pool, keeping the
+        /// list's order (e.g. back to front for transparent) on replay.
+        /// </summary>
+        /// <param name="batchSize">Nodes recorded into each command list</param>
+        static void record(const std::vector<Pair>& nodes,
+                           engine::CommandRecorder& recorder,
+                           const engine::Frustum& frustum,
+                           size_t batchSize = 64) {
+          recorder.record(nodes.size(), batchSize,
+                          [&](engine::CommandList& list, size_t begin,
+                              size_t end) {
+                            for (size_t i = begin; i < end; ++i) {
+                              nodes[i].node->record(list, frustum);
+                            }
+                          });
+        }
+      };
+
+      /// <summary>
+      /// Where BuildNodeLists reports the on-screen size of visible nodes'
+      /// materials, so the streamer refines what is seen.
+      /// </summary>
+      struct TextureFeedback {
+        engine::mesh::MaterialRegistry& registry;
+        /// <summary>
+        /// Pixels spanned by one unit at distance one, viewport height /
+        /// (2 * tan(fovY / 2)).
+        /// </summary>
+        float projectionScale;
       };
 
       NodeLists BuildNodeLists(const engine::Frustum& frustum,
-                               const glm::vec3& position);
+                               const glm::vec3& position,
+                               const TextureFeedback* feedback = nullptr);
 
       inline void update(const engine::FrameInfo& info) {
         for (auto& root : m_roots) {
@@ -105,12 +141,28 @@ namespace engine {
         }
       }
 
+      /// <summary>
+      /// Updates the graph, animating nodes at a rate chosen by the animation
+      /// LOD for the camera's view.
+      /// </summary>
+      inline void update(const engine::FrameInfo& info,
+                         const engine::Camera& camera) {
+        m_animationLod.setView(camera.GetFrustum(), camera.GetPosition());
+
+        engine::FrameInfo lodInfo = info;
+        lodInfo.animationLod = &m_animationLod;
+        update(lodInfo);
+      }
+
+      inline engine::AnimationLod& GetAnimationLod() { return m_animationLod; }
+
       inline const std::vector<std::shared_ptr<Node>>& GetRoots() const {
         return m_roots;
       }
 
     protected:
       std::vector<std::shared_ptr<Node>> m_roots;
+      engine::AnimationLod m_animationLod;
     };
   } // namespace scene
 } // namespace engine
@@ -3,11 +3,17 @@
 #include "frame_info.hpp"
 #include <engine/frustum.hpp>
 #include <gl/buffer.hpp>
+#include <gl/structs.hpp>
 #include <glm/glm.hpp>
 #include <memory>
 
 namespace engine {
   class Camera;
+  class CommandList;
+  class SkinningScheduler;
+  namespace mesh {
+    class MaterialRegistry;
+  } // namespace mesh
 } // namespace engine
 
 namespace engine {
@@ -79,6 +85,14 @@ namespace engine {
       virtual void render(const engine::Frustum& frustum);
       virtual void renderDepthOnly(const engine::Frustum& frustum);
       virtual void renderDepthOnlyCube();
+      /// <summary>
+      /// Records the node's own draws into a command list instead of issuing
+      /// them, for NodeLists::record. Children are not recorded, as the node
+      /// lists already hold every visible descendant. May run on a worker
+      /// thread, so must make no GL calls.
+      /// </summary>
+      virtual void record(engine::CommandList& /*commands*/,
+                          const engine::Frustum& /*frustum*/) const {}
 
       inline float GetBoundingRadius() const { return m_absBoundingRadius; }
       inline void SetBoundingRadius(float radius) {
@@ -95,23 +109,29 @@ namespace engine {
         GLuint instances;
         GLuint maxIndirectCmds;
         GLuint maxVertices;
+        /// <summary>
+        /// Joint matrices written by writeJointPalettes
+        /// </summary>
+        GLuint maxPaletteJoints = 0;
 
         DrawParams& operator+=(const DrawParams& o) {
           instances += o.instances;
           maxIndirectCmds += o.maxIndirectCmds;
           maxVertices += o.maxVertices;
+          maxPaletteJoints += o.maxPaletteJoints;
           return *this;
         }
 
         DrawParams operator+(const DrawParams& o) const {
           return {.instances = instances + o.instances,
                   .maxIndirectCmds = maxIndirectCmds + o.maxIndirectCmds,
-                  .maxVertices = maxVertices + o.maxVertices};
+                  .maxVertices = maxVertices + o.maxVertices,
+                  .maxPaletteJoints = maxPaletteJoints + o.maxPaletteJoints};
         }
       };
 
       virtual DrawParams getBatchDrawParams() const {
-        DrawParams maxDraws = {0, 0, 0};
+        DrawParams maxDraws = {0, 0, 0, 0};
         for (const auto& child : m_children) {
           maxDraws += child->getBatchDrawParams();
         }
@@ -119,23 +139,58 @@ namespace engine {
         return maxDraws;
       }
 
-      virtual void skinVertices(uint32_t& baseVertex) {
+      /// <summary>
+      /// Samples the joint palette of each node with a compressed animation.
+      /// Must run before skinVertices, with the palette buffer bound in place
+      /// of the baked joint buffer.
+      /// </summary>
+      /// <param name="mapping">Palette buffer, advanced past the written
+      /// matrices</param>
+      /// <param name="paletteJoints">Joints written so far</param>
+      virtual void writeJointPalettes(gl::MappingRef& mapping,
+                                      GLuint& paletteJoints) {
         for (const auto& child : m_children) {
-          child->skinVertices(baseVertex);
+          child->writeJointPalettes(mapping, paletteJoints);
         }
       }
 
-      virtual void writeInstanceData(gl::MappingRef& mapping, GLuint& instances,
-                                     gl::MappingRef& textureMapping) {
+      /// <summary>
+      /// Queues each skinned node on the scheduler, which skins them all in
+      /// one dispatch.
+      /// </summary>
+      virtual void skinVertices(engine::SkinningScheduler& scheduler) {
         for (const auto& child : m_children) {
-          child->writeInstanceData(mapping, instances, textureMapping);
+          child->skinVertices(scheduler);
         }
       }
 
+      /// <summary>
+      /// Reports this node's materials as drawn at the given on-screen size
+      /// in pixels, for texture streaming. Children report themselves.
+      /// </summary>
+      virtual void
+      reportTextureUsage(engine::mesh::MaterialRegistry& /*registry*/,
+                         float /*screenSize*/) const {}
+
+      virtual void writeInstanceData(gl::MappingRef& mapping,
+                                     GLuint& instances) {
+        for (const auto& child : m_children) {
+          child->writeInstanceData(mapping, instances);
+        }
+      }
+
+      /// <summary>
+      /// Writes the draws (and their material indices, one per draw) that use
+      /// the given index type. Call once per index type, each batch being its
+      /// own MultiDraw call.
+      /// </summary>
       virtual void writeBatchedDraws(gl::MappingRef& mapping,
-                                     GLuint& writtenDraws) const {
+                                     gl::MappingRef& materialMapping,
+                                     GLuint& writtenDraws,
+                                     gl::IndexType indexType) const {
         for (const auto& child : m_children) {
-          child->writeBatchedDraws(mapping, writtenDraws);
+          child->writeBatchedDraws(mapping, materialMapping, writtenDraws,
+                                   indexType);
         }
       }
 
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <gl/buffer.hpp>
+#include <gl/fence.hpp>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Collects every skinned instance of a frame into a parameter table and
+  /// skins them all with a single compute dispatch.
+  /// Outputs are cached by pose (mesh, animation, frame): instances at the same
+  /// pose share one skinned vertex range, and a pose skinned in an earlier
+  /// frame is reused while its range has not been evicted. Skinning cost
+  /// scales with the number of new poses, not the number of instances.
+  /// </summary>
+  /// <remarks>
+  /// Shader interface:
+  /// - SSBO at the binding given to dispatch: Instance instances[]
+  /// - uniform uint (location 0): number of instances
+  /// - uniform uint (location 1): total number of vertices
+  /// - local_size_x = WORKGROUP_SIZE, one invocation per output vertex. An
+  ///   invocation finds its instance by binary searching firstInvocation.
+  /// </remarks>
+  class SkinningScheduler {
+  public:
+    constexpr static uint32_t WORKGROUP_SIZE = 64;
+    constexpr static uint32_t FRAMES_IN_FLIGHT = 3;
+
+    /// <summary>
+    /// Per instance parameters, std430 compatible.
+    /// </summary>
+    struct Instance {
+      uint32_t vertexOffset;
+      uint32_t startJoint;
+      uint32_t jointCount;
+      uint32_t frame;
+      uint32_t baseVertex;
+      uint32_t vertexCount;
+      /// <summary>
+      /// Sum of vertexCount of every instance before this one.
+      /// </summary>
+      uint32_t firstInvocation;
+      uint32_t padding = 0;
+    };
+    static_assert(sizeof(Instance) == 32,
+                  "SkinningScheduler::Instance must match the std430 layout");
+
+    /// <summary>
+    /// Identifies a skinned output. Instances with equal keys must produce
+    /// identical vertices.
+    /// </summary>
+    struct PoseKey {
+      const void* mesh = nullptr;
+      const void* animation = nullptr;
+      /// <summary>
+      /// Baked frame, or any value naming the pose of a sampled animation,
+      /// e.g. its quantised sample time.
+      /// </summary>
+      uint32_t frame = 0;
+
+      bool operator==(const PoseKey&) const = default;
+    };
+
+    /// <summary>
+    /// Creates the parameter buffer, persistently mapped with a region for
+    /// each frame in flight.
+    /// </summary>
+    /// <param name="maxInstances">Most instances skinned in one frame</param>
+    explicit SkinningScheduler(uint32_t maxInstances);
+
+    SkinningScheduler(const SkinningScheduler&) = delete;
+    SkinningScheduler& operator=(const SkinningScheduler&) = delete;
+
+    /// <summary>
+    /// Starts a new frame. Waits for the GPU to be done with the region that
+    /// is about to be reused.
+    /// </summary>
+    /// <param name="baseVertex">First vertex of the output range</param>
+    /// <param name="vertexCapacity">Vertices in the output range. Headroom
+    /// over the vertices skinned per frame lets more poses stay cached.
+    /// Changing the range clears the cache.</param>
+    void begin(uint32_t baseVertex, uint32_t vertexCapacity);
+
+    /// <summary>
+    /// Returns the cached output of the pose, or queues the instance to be
+    /// skinned into a newly allocated range. Least recently used poses are
+    /// evicted when the output range is full.
+    /// </summary>
+    /// <param name="key">Pose of the instance</param>
+    /// <param name="frame">Frame of the joint buffer to skin with</param>
+    /// <returns>Base vertex of the instance's skinned output</returns>
+    uint32_t add(const PoseKey& key, uint32_t vertexOffset,
+                 uint32_t startJoint, uint32_t jointCount, uint32_t frame,
+                 uint32_t vertexCount);
+
+    /// <summary>
+    /// Forgets every cached pose. Must be called when a mesh or animation is
+    /// destroyed or its joint data rewritten, as keys compare by address.
+    /// </summary>
+    void clear();
+
+    /// <summary>
+    /// Writes the parameter table and dispatches the bound skinning program
+    /// over every queued instance.
+    /// </summary>
+    /// <param name="binding">SSBO binding of the parameter table</param>
+    /// <returns>Number of workgroups dispatched</returns>
+    uint32_t dispatch(GLuint binding);
+
+    /// <summary>
+    /// Poses skinned this frame.
+    /// </summary>
+    uint32_t getInstanceCount() const {
+      return static_cast<uint32_t>(instances.size());
+    }
+    /// <summary>
+    /// Instances this frame that reused a cached pose.
+    /// </summary>
+    uint32_t getCacheHits() const { return cacheHits; }
+    uint32_t getVertexCount() const { return totalVertices; }
+    uint32_t getCachedPoseCount() const {
+      return static_cast<uint32_t>(cache.size());
+    }
+
+  protected:
+    uint32_t maxInstances;
+    GLuint regionSize;
+    gl::Buffer buffer;
+    gl::Mapping mapping;
+    std::array<std::optional<gl::Fence>, FRAMES_IN_FLIGHT> fences = {};
+    uint32_t region = 0;
+
+    std::vector<Instance> instances;
+    uint32_t totalVertices = 0;
+    uint32_t cacheHits = 0;
+
+    struct PoseKeyHash {
+      size_t operator()(const PoseKey& key) const;
+    };
+
+    struct CacheEntry {
+      uint32_t baseVertex;
+      uint32_t vertexCount;
+      uint64_t lastUsed;
+      /// <summary>
+      /// The entry's place in lru.
+      /// </summary>
+      std::list<PoseKey>::iterator lru;
+    };
+
+    std::unordered_map<PoseKey, CacheEntry, PoseKeyHash> cache;
+    /// <summary>
+    /// Cached poses, least recently used first.
+    /// </summary>
+    std::list<PoseKey> lru;
+    /// <summary>
+    /// Free output ranges, first vertex to vertex count.
+    /// </summary>
+    std::map<uint32_t, uint32_t> freeRanges;
+    /// <summary>
+    /// The same ranges as (vertex count, first vertex), for best fit.
+    /// </summary>
+    std::set<std::pair<uint32_t, uint32_t>> freeBySize;
+    uint32_t outputBase = 0;
+    uint32_t outputCapacity = 0;
+    uint64_t frameIndex = 0;
+
+    /// <summary>
+    /// Takes the smallest free range that fits, O(log ranges).
+    /// </summary>
+    std::optional<uint32_t> allocate(uint32_t vertexCount);
+    void release(uint32_t baseVertex, uint32_t vertexCount);
+    void addFreeRange(uint32_t first, uint32_t count);
+    void eraseFreeRange(std::map<uint32_t, uint32_t>::iterator range);
+    /// <summary>
+    /// Frees poses not used this frame, oldest first, until a range of
+    /// vertexCount is free. Returns the allocated range if one was found.
+    /// </summary>
+    std::optional<uint32_t> evictFor(uint32_t vertexCount);
+  };
+} // namespace engine
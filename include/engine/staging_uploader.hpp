@@ -0,0 +1,99 @@
+#pragma once
+
+#include "engine/texture/upload_ring.hpp"
+#include <cstdint>
+#include <deque>
+#include <gl/buffer.hpp>
+#include <gl/fence.hpp>
+#include <optional>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Shared staging for buffer uploads. Callers request space for a range of
+  /// a destination buffer and write into it. The requests are packed into
+  /// one persistently mapped ring, and flush copies them to their
+  /// destinations, merging requests that are contiguous in both the ring and
+  /// the destination. Loading many meshes then costs a few copy commands
+  /// rather than a mapping per mesh.
+  /// </summary>
+  /// <remarks>
+  /// Must be used on the GL thread. Destination buffers must outlive the
+  /// next flush. Commands issued after a flush see the copied data, so
+  /// waiting on completion is only needed to read it back on the CPU.
+  /// </remarks>
+  class StagingUploader {
+  public:
+    /// <summary>
+    /// Creates the uploader.
+    /// </summary>
+    /// <param name="capacity">Size of the staging ring in bytes, the largest
+    /// single request it can take</param>
+    explicit StagingUploader(GLuint capacity);
+
+    StagingUploader(const StagingUploader&) = delete;
+    StagingUploader& operator=(const StagingUploader&) = delete;
+
+    /// <summary>
+    /// Reserves staging space for size bytes of destination, starting at
+    /// offset. Pending requests are flushed first if the ring is too full
+    /// to take it.
+    /// </summary>
+    /// <remarks>
+    /// Fill each request before making the next, as this may flush. Runs of
+    /// requests for consecutive ranges of one destination merge into one
+    /// copy, so stage all of a buffer's data before moving to the next.
+    /// </remarks>
+    /// <param name="alignment">Alignment of the staging space. A request
+    /// continuing the previous one only merges with it when its aligned
+    /// staging offset follows straight on, so keep sizes a multiple of
+    /// it</param>
+    /// <returns>Where to write the data, until the next flush. nullopt if
+    /// size exceeds the capacity</returns>
+    std::optional<gl::MappingRef> request(const gl::Buffer& destination,
+                                          GLuint offset, GLuint size,
+                                          GLuint alignment = 16);
+
+    /// <summary>
+    /// Copies every pending request to its destination, with one copy per
+    /// run of contiguous requests.
+    /// </summary>
+    /// <returns>Batch to pass to isComplete</returns>
+    uint64_t flush();
+
+    /// <summary>
+    /// Whether the GPU has finished the copies of a batch.
+    /// </summary>
+    bool isComplete(uint64_t batch);
+
+    /// <summary>
+    /// Requests not yet flushed.
+    /// </summary>
+    size_t getPendingCount() const { return pending.size(); }
+    uint64_t getRequestCount() const { return requests; }
+    /// <summary>
+    /// Copy commands issued, at most getRequestCount.
+    /// </summary>
+    uint64_t getCopyCount() const { return copies; }
+
+  protected:
+    struct Copy {
+      const gl::Buffer* destination;
+      GLuint stagingOffset;
+      GLuint destinationOffset;
+      GLuint size;
+    };
+
+    struct Batch {
+      uint64_t index;
+      gl::Fence fence;
+    };
+
+    texture::UploadRing ring;
+    std::vector<Copy> pending;
+    std::deque<Batch> batches;
+    uint64_t nextBatch = 0;
+    uint64_t requests = 0;
+    uint64_t copies = 0;
+  };
+} // namespace engine
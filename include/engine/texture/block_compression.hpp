@@ -0,0 +1,119 @@
+#pragma once
+
+#include "engine/thread_pool.hpp"
+#include <cstdint>
+#include <expected>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace engine::texture {
+  /// <summary>
+  /// GPU block compression formats. Every format stores 4x4 texel blocks.
+  /// </summary>
+  enum class BlockFormat : uint8_t {
+    /// <summary>
+    /// RGB with 1 bit alpha, 8 bytes per block. Colour textures.
+    /// </summary>
+    BC1,
+    /// <summary>
+    /// RGBA with interpolated alpha, 16 bytes per block.
+    /// </summary>
+    BC3,
+    /// <summary>
+    /// Two independent channels, 16 bytes per block. Normal maps (XY).
+    /// </summary>
+    BC5,
+    /// <summary>
+    /// High quality RGBA, 16 bytes per block.
+    /// </summary>
+    BC7,
+  };
+
+  constexpr uint32_t BLOCK_DIMENSION = 4;
+
+  /// <summary>
+  /// Bytes per 4x4 block of the format.
+  /// </summary>
+  constexpr uint32_t blockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+  }
+
+  /// <summary>
+  /// Bytes needed to store a surface of the given size in the format.
+  /// </summary>
+  constexpr size_t surfaceBytes(BlockFormat format, glm::ivec2 size) {
+    size_t blocksX = (static_cast<size_t>(size.x) + 3) / 4;
+    size_t blocksY = (static_cast<size_t>(size.y) + 3) / 4;
+    return blocksX * blocksY * blockBytes(format);
+  }
+
+  /// <summary>
+  /// OpenGL internal format of the block format. BC5 has no sRGB variant.
+  /// </summary>
+  GLenum glInternalFormat(BlockFormat format, bool srgb);
+
+  /// <summary>
+  /// Encoders and decoders of single 4x4 blocks. Texels are RGBA8, row major.
+  /// Decoders are the CPU reference used to measure encoding error.
+  /// </summary>
+  namespace bc {
+    using Block = std::span<const uint8_t, 64>;
+    using DecodedBlock = std::span<uint8_t, 64>;
+
+    /// <summary>
+    /// Encodes a BC1 block. Texels with alpha below 128 use the transparent
+    /// index, when the block has any.
+    /// </summary>
+    void encodeBC1(Block texels, uint8_t* out);
+    /// <summary>
+    /// Encodes a BC3 block: BC4 alpha followed by a 4 colour BC1 block.
+    /// </summary>
+    void encodeBC3(Block texels, uint8_t* out);
+    /// <summary>
+    /// Encodes a BC5 block from the red and green channels.
+    /// </summary>
+    void encodeBC5(Block texels, uint8_t* out);
+    /// <summary>
+    /// Encodes a BC7 block in mode 6 (one subset, RGBA endpoints with
+    /// p-bits, 4 bit indices).
+    /// </summary>
+    void encodeBC7(Block texels, uint8_t* out);
+
+    /// <summary>
+    /// Encodes 8 bit values into a BC4 block, picking the better of its two
+    /// palette modes.
+    /// </summary>
+    void encodeBC4(std::span<const uint8_t, 16> values, uint8_t* out);
+
+    void decodeBC1(const uint8_t* block, DecodedBlock texels);
+    void decodeBC3(const uint8_t* block, DecodedBlock texels);
+    void decodeBC4(const uint8_t* block, std::span<uint8_t, 16> values);
+    void decodeBC5(const uint8_t* block, DecodedBlock texels);
+    /// <summary>
+    /// Decodes a BC7 block. Only mode 6, the mode encodeBC7 writes, is
+    /// supported.
+    /// </summary>
+    /// <returns>False if the block uses another mode</returns>
+    bool decodeBC7(const uint8_t* block, DecodedBlock texels);
+  } // namespace bc
+
+  /// <summary>
+  /// Compresses an RGBA8 surface, splitting rows of blocks across the thread
+  /// pool. Partial blocks at the edges repeat the last row and column.
+  /// </summary>
+  /// <param name="rgba">Texels, size.x * size.y * 4 bytes</param>
+  /// <returns>surfaceBytes(format, size) bytes of blocks, or an error if
+  /// rgba is too small</returns>
+  std::expected<std::vector<uint8_t>, std::string>
+  compress(std::span<const uint8_t> rgba, glm::ivec2 size, BlockFormat format,
+           ThreadPool& pool = ThreadPool::global());
+
+  /// <summary>
+  /// Decompresses a surface back to RGBA8.
+  /// </summary>
+  std::vector<uint8_t> decompress(std::span<const uint8_t> blocks,
+                                  glm::ivec2 size, BlockFormat format);
+} // namespace engine::texture
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "engine/image.hpp"
+#include "engine/texture/block_compression.hpp"
+#include "engine/texture/upload_ring.hpp"
+#include <expected>
+#include <gl/texture.hpp>
+#include <string>
+#include <vector>
+
+namespace engine::texture {
+  /// <summary>
+  /// A block compressed image with its mip chain, level 0 first.
+  /// </summary>
+  struct CompressedImage {
+    struct Level {
+      glm::ivec2 dimensions;
+      std::vector<uint8_t> data;
+    };
+
+    BlockFormat format = BlockFormat::BC1;
+    bool srgb = false;
+    std::vector<Level> levels;
+
+    /// <summary>
+    /// Compresses RGBA8 texels, with a mip chain down to 1x1 if mipmaps is
+    /// set. Mips are Kaiser filtered, in linear space for sRGB images.
+    /// </summary>
+    /// <returns>The image, or an error if rgba is too small</returns>
+    static std::expected<CompressedImage, std::string>
+    encode(std::span<const uint8_t> rgba, glm::ivec2 size, BlockFormat format,
+           bool srgb, bool mipmaps = true,
+           ThreadPool& pool = ThreadPool::global());
+
+    /// <summary>
+    /// Compresses a loaded image. Images with fewer than 4 channels are
+    /// expanded to RGBA first (grey for 1 channel, blue 0 for 2).
+    /// </summary>
+    static std::expected<CompressedImage, std::string>
+    encode(const engine::Image& image, BlockFormat format, bool srgb,
+           bool mipmaps = true, ThreadPool& pool = ThreadPool::global());
+
+    inline glm::ivec2 getDimensions() const {
+      return levels.empty() ? glm::ivec2(0) : levels.front().dimensions;
+    }
+
+    /// <summary>
+    /// Bytes of every level, the memory the texture takes on the GPU.
+    /// </summary>
+    size_t byteSize() const;
+
+    /// <summary>
+    /// Creates a texture with storage for every level and uploads the blocks
+    /// directly, no decompression or mip generation on the driver.
+    /// </summary>
+    /// <param name="ring">Ring to stage the blocks through, nullptr to
+    /// upload from client memory</param>
+    gl::Texture toTexture(UploadRing* ring = nullptr) const;
+
+    /// <summary>
+    /// Uploads one level into a texture level, staged through the ring if
+    /// given and it has space.
+    /// </summary>
+    void uploadLevel(const gl::Texture& texture, size_t level,
+                     GLint textureLevel, UploadRing* ring = nullptr) const;
+  };
+} // namespace engine::texture
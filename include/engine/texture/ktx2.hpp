@@ -0,0 +1,42 @@
+#pragma once
+
+#include "engine/texture/compressed_image.hpp"
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace engine::texture {
+  /// <summary>
+  /// KTX2 container for block compressed images: one 2D image (no array
+  /// layers, faces or supercompression) with its mip chain and a basic data
+  /// format descriptor.
+  /// </summary>
+  namespace ktx2 {
+    /// <summary>
+    /// Serialises an image into a KTX2 file in memory.
+    /// </summary>
+    std::vector<uint8_t> serialize(const CompressedImage& image);
+
+    /// <summary>
+    /// Parses a KTX2 file in memory.
+    /// </summary>
+    /// <returns>Image on success, error string on failure</returns>
+    std::expected<CompressedImage, std::string>
+    parse(std::span<const uint8_t> data);
+
+    /// <summary>
+    /// Writes an image to a KTX2 file.
+    /// </summary>
+    /// <returns>Error message on failure</returns>
+    std::optional<std::string> write(const std::string& path,
+                                     const CompressedImage& image);
+
+    /// <summary>
+    /// Reads an image from a KTX2 file.
+    /// </summary>
+    /// <returns>Image on success, error string on failure</returns>
+    std::expected<CompressedImage, std::string> read(const std::string& path);
+  } // namespace ktx2
+} // namespace engine::texture
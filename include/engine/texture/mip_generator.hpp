@@ -0,0 +1,60 @@
+#pragma once
+
+#include "engine/thread_pool.hpp"
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <span>
+#include <vector>
+
+namespace engine::texture {
+  enum class MipFilter : uint8_t {
+    /// <summary>
+    /// Averages the texels under each output texel. Fast, slightly blurry.
+    /// </summary>
+    BOX,
+    /// <summary>
+    /// Kaiser windowed sinc, 3 output texels wide. Keeps detail sharp with
+    /// little aliasing or ringing.
+    /// </summary>
+    KAISER,
+  };
+
+  struct MipSettings {
+    MipFilter filter = MipFilter::KAISER;
+    /// <summary>
+    /// Colour channels are sRGB encoded, so are filtered in linear space.
+    /// Alpha is always linear.
+    /// </summary>
+    bool srgb = false;
+    /// <summary>
+    /// Shape of the Kaiser window, higher is smoother.
+    /// </summary>
+    float kaiserAlpha = 4.0f;
+    /// <summary>
+    /// Levels to generate below the base, -1 for the full chain to 1x1.
+    /// </summary>
+    int levels = -1;
+  };
+
+  struct MipLevel {
+    glm::ivec2 dimensions;
+    /// <summary>
+    /// 8 bit texels with the channel count of the base level.
+    /// </summary>
+    std::vector<uint8_t> data;
+  };
+
+  /// <summary>
+  /// Generates the mip chain of an 8 bit image on the CPU, so uploading the
+  /// chain is a copy per level. Levels are filtered from the previous level
+  /// in float (SIMD when available), rows split across the thread pool.
+  /// </summary>
+  /// <param name="texels">Base level, size.x * size.y * channels bytes</param>
+  /// <param name="channels">1 to 4. With 2 or 4 channels the last one is
+  /// alpha.</param>
+  /// <returns>Levels 1 and below, largest first</returns>
+  std::vector<MipLevel> generateMips(std::span<const uint8_t> texels,
+                                     glm::ivec2 size, int channels,
+                                     const MipSettings& settings = {},
+                                     ThreadPool& pool = ThreadPool::global());
+} // namespace engine::texture
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "engine/image.hpp"
+#include <array>
+#include <cstdint>
+#include <gl/texture.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+#include <vector>
+
+namespace engine::texture {
+  /// <summary>
+  /// Packs rectangles into a fixed size area, bottom left first, keeping
+  /// only the top edge (skyline) of what has been placed. CPU only.
+  /// </summary>
+  class SkylinePacker {
+  public:
+    explicit SkylinePacker(glm::ivec2 size);
+
+    /// <summary>
+    /// Places a rectangle where its top ends lowest, ties going to the
+    /// placement wasting the least width.
+    /// </summary>
+    /// <returns>Bottom left corner, or nullopt if it does not fit</returns>
+    std::optional<glm::ivec2> insert(glm::ivec2 size);
+
+    void clear();
+
+    glm::ivec2 getSize() const { return size; }
+    /// <summary>
+    /// Fraction of the area covered by placed rectangles.
+    /// </summary>
+    float occupancy() const {
+      return static_cast<float>(usedArea) /
+             (static_cast<float>(size.x) * size.y);
+    }
+
+  protected:
+    struct Segment {
+      int x;
+      int y;
+      int width;
+    };
+
+    glm::ivec2 size;
+    std::vector<Segment> skyline;
+    int64_t usedArea = 0;
+
+    /// <summary>
+    /// Height a rectangle of the given width rests at when its left edge is
+    /// at segment index, nullopt if it runs past the right edge.
+    /// </summary>
+    std::optional<int> restingHeight(size_t index, int width) const;
+  };
+
+  struct AtlasSettings {
+    /// <summary>
+    /// Width and height of each layer.
+    /// </summary>
+    int layerSize = 1024;
+    /// <summary>
+    /// Layers of each array, allocated when the first image is packed.
+    /// </summary>
+    int layers = 4;
+    /// <summary>
+    /// Largest width or height of an image worth packing.
+    /// </summary>
+    int maxImageSize = 128;
+    /// <summary>
+    /// Mip levels of the arrays. Images are padded and aligned to
+    /// 2^(mipLevels - 1) texels so no level bleeds into its neighbours.
+    /// </summary>
+    int mipLevels = 4;
+  };
+
+  /// <summary>
+  /// Where a packed image lies in the atlas. uv * uvScale + uvOffset maps
+  /// the image's coordinates into the layer.
+  /// </summary>
+  struct AtlasRegion {
+    uint32_t layer = 0;
+    glm::vec2 uvScale = glm::vec2(1.0f);
+    glm::vec2 uvOffset = glm::vec2(0.0f);
+  };
+
+  /// <summary>
+  /// Packs small images into shared texture arrays, so they need no texture
+  /// object or bindless handle of their own. The images of one material
+  /// (diffuse, bump, material) share a region, each channel in its own
+  /// array: sRGB for diffuse, linear for the others.
+  /// </summary>
+  /// <remarks>
+  /// Samples are clamped to the region, so textures that tile (repeat past
+  /// 0..1) must not be packed. Must be used on the GL thread.
+  /// </remarks>
+  class TextureAtlas {
+  public:
+    constexpr static size_t CHANNELS = 3;
+
+    explicit TextureAtlas(const AtlasSettings& settings = {});
+
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+    /// <summary>
+    /// Whether an image of this size is small enough to pack.
+    /// </summary>
+    bool accepts(glm::ivec2 size) const {
+      return size.x > 0 && size.y > 0 && size.x <= settings.maxImageSize &&
+             size.y <= settings.maxImageSize;
+    }
+
+    /// <summary>
+    /// Packs the images of a material, all of the same size, and uploads
+    /// them with their mips.
+    /// </summary>
+    /// <param name="images">Image of each channel, nullptr if absent</param>
+    /// <returns>The region, or nullopt if the atlas is full or the images
+    /// cannot be packed</returns>
+    std::optional<AtlasRegion>
+    add(const std::array<const engine::Image*, CHANNELS>& images);
+
+    /// <summary>
+    /// Bindless handle of a channel's array, 0 until an image has been
+    /// packed into it. Arrays are resident for the atlas's lifetime.
+    /// </summary>
+    gl::RawTextureHandle getHandle(size_t channel) const {
+      return arrays[channel] ? arrays[channel]->rawHandle() : 0;
+    }
+
+    const AtlasSettings& getSettings() const { return settings; }
+    uint32_t getLayerCount() const {
+      return static_cast<uint32_t>(packers.size());
+    }
+
+  protected:
+    AtlasSettings settings;
+    std::vector<SkylinePacker> packers;
+    std::array<std::optional<gl::TextureArray>, CHANNELS> arrays;
+
+    /// <summary>
+    /// Texels around each image and the alignment of every placement.
+    /// </summary>
+    int padding() const { return 1 << (settings.mipLevels - 1); }
+    gl::TextureArray& getArray(size_t channel);
+  };
+} // namespace engine::texture
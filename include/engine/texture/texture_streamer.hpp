@@ -0,0 +1,143 @@
+#pragma once
+
+#include "engine/texture/compressed_image.hpp"
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <gl/texture.hpp>
+#include <vector>
+
+namespace engine::texture {
+  /// <summary>
+  /// Streams the mips of compressed textures in and out of VRAM under a
+  /// memory budget. Textures start with only their coarse mips resident and
+  /// are refined to the level their on-screen size asks for. When over
+  /// budget, the least recently used textures drop back to their coarse mips,
+  /// and textures unused for a while are made non-resident.
+  /// </summary>
+  /// <remarks>
+  /// Bindless handles freeze their texture, so a refined texture is a new
+  /// texture with a new handle. Owners learn of it through the handle
+  /// callback given to add. Replaced textures are released FRAMES_IN_FLIGHT
+  /// updates later, once the GPU can no longer be using them.
+  /// Per frame: request each visible texture's size, then call update before
+  /// drawing.
+  /// </remarks>
+  class TextureStreamer {
+  public:
+    using TextureId = uint32_t;
+    using HandleCallback = std::function<void(gl::RawTextureHandle)>;
+
+    constexpr static uint32_t FRAMES_IN_FLIGHT = 3;
+
+    struct Settings {
+      /// <summary>
+      /// VRAM the streamed textures may use, in bytes.
+      /// </summary>
+      size_t budget = 512ull << 20;
+      /// <summary>
+      /// Largest dimension of the mips every texture keeps resident.
+      /// </summary>
+      int coarseSize = 64;
+      /// <summary>
+      /// Most textures refined per update, to bound the upload cost.
+      /// </summary>
+      uint32_t maxUploadsPerFrame = 4;
+      /// <summary>
+      /// Updates a texture can go unrequested before it is made
+      /// non-resident.
+      /// </summary>
+      uint32_t idleFrames = 300;
+    };
+
+    TextureStreamer() = default;
+    explicit TextureStreamer(const Settings& settings) : settings(settings) {}
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    /// <summary>
+    /// Adds a texture, uploading its coarse mips. The image keeps the whole
+    /// chain on the CPU to refine from.
+    /// </summary>
+    /// <param name="onHandleChanged">Called with the texture's new handle each
+    /// time it is replaced, and once with the initial handle</param>
+    TextureId add(CompressedImage&& image, HandleCallback onHandleChanged);
+
+    /// <summary>
+    /// Marks a texture as used this frame at the given on-screen size.
+    /// </summary>
+    /// <param name="screenSize">Size in pixels the texture spans, 0 if
+    /// unknown</param>
+    void request(TextureId id, float screenSize);
+
+    /// <summary>
+    /// Refines requested textures, evicting under the budget, and releases
+    /// retired textures. Must run on the GL thread.
+    /// </summary>
+    void update();
+
+    /// <summary>
+    /// Bytes of VRAM used by the resident mips of every texture.
+    /// </summary>
+    size_t getResidentBytes() const { return residentBytes; }
+    const Settings& getSettings() const { return settings; }
+
+    /// <summary>
+    /// Stages refinements through the ring, which must outlive the
+    /// streamer. nullptr uploads from client memory.
+    /// </summary>
+    void setUploadRing(UploadRing* ring) { uploadRing = ring; }
+    void setSettings(const Settings& newSettings) { settings = newSettings; }
+
+    /// <summary>
+    /// First mip level of the texture on the GPU.
+    /// </summary>
+    uint32_t getResidentLevel(TextureId id) const {
+      return textures[id].residentLevel;
+    }
+
+  protected:
+    struct StreamedTexture {
+      CompressedImage source;
+      gl::Texture texture = gl::Texture::uninitialized();
+      gl::RawTextureHandle handle = 0;
+      HandleCallback onHandleChanged;
+      /// <summary>
+      /// Level every texture keeps, the first no larger than coarseSize.
+      /// </summary>
+      uint32_t coarseLevel = 0;
+      uint32_t residentLevel = 0;
+      uint32_t wantedLevel = 0;
+      uint64_t lastUsed = 0;
+      size_t bytes = 0;
+      bool resident = false;
+    };
+
+    struct RetiredTexture {
+      uint64_t frame;
+      gl::Texture texture;
+      gl::RawTextureHandle handle;
+      bool resident;
+    };
+
+    Settings settings;
+    std::vector<StreamedTexture> textures;
+    std::deque<RetiredTexture> retired;
+    size_t residentBytes = 0;
+    uint64_t frame = 0;
+    UploadRing* uploadRing = nullptr;
+
+    /// <summary>
+    /// Replaces the texture with one holding the levels from level down.
+    /// </summary>
+    void upload(StreamedTexture& texture, uint32_t level);
+    void setResident(StreamedTexture& texture, bool resident);
+    size_t levelBytes(const StreamedTexture& texture, uint32_t level) const;
+    /// <summary>
+    /// Drops least recently used textures to their coarse mips until the
+    /// given bytes fit the budget.
+    /// </summary>
+    bool makeRoom(size_t bytes, const StreamedTexture& keep);
+  };
+} // namespace engine::texture
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <gl/buffer.hpp>
+#include <gl/fence.hpp>
+#include <gl/texture.hpp>
+#include <glm/glm.hpp>
+#include <optional>
+#include <span>
+
+namespace engine::texture {
+  /// <summary>
+  /// Persistently mapped pixel unpack buffer that texture uploads are staged
+  /// through. Texels are written into the ring, and the texture is updated
+  /// from the ring. The driver does not copy client memory synchronously.
+  /// Space is reused once the fence covering it has signalled.
+  /// </summary>
+  /// <remarks>
+  /// allocate, upload and fence must run on the GL thread. The memory of an
+  /// allocation is plain mapped memory, so pool workers may fill it before
+  /// the upload is issued.
+  /// </remarks>
+  class UploadRing {
+  public:
+    /// <summary>
+    /// Space reserved in the ring.
+    /// </summary>
+    struct Allocation {
+      std::span<uint8_t> data;
+      GLuint offset;
+    };
+
+    /// <summary>
+    /// Creates the ring, persistently mapped.
+    /// </summary>
+    /// <param name="capacity">Size of the ring in bytes, the largest single
+    /// upload it can stage</param>
+    explicit UploadRing(GLuint capacity);
+
+    UploadRing(const UploadRing&) = delete;
+    UploadRing& operator=(const UploadRing&) = delete;
+
+    /// <summary>
+    /// Reserves space in the ring. Waits for the GPU to finish reading older
+    /// uploads if the ring is full.
+    /// </summary>
+    /// <returns>The space, or nullopt if bytes exceeds the capacity</returns>
+    std::optional<Allocation> allocate(GLuint bytes, GLuint alignment = 16);
+
+    /// <summary>
+    /// Copies data into the ring.
+    /// </summary>
+    std::optional<Allocation> stage(std::span<const uint8_t> data);
+
+    /// <summary>
+    /// Updates a region of a texture level from an allocation holding
+    /// tightly packed rows.
+    /// </summary>
+    void upload(const gl::Texture& texture, GLint level, glm::ivec2 offset,
+                glm::ivec2 size, GLenum format, GLenum type,
+                const Allocation& allocation) const;
+
+    /// <summary>
+    /// Updates a region of a texture level from an allocation holding
+    /// compressed blocks.
+    /// </summary>
+    void uploadCompressed(const gl::Texture& texture, GLint level,
+                          glm::ivec2 offset, glm::ivec2 size,
+                          GLenum internalFormat,
+                          const Allocation& allocation) const;
+
+    /// <summary>
+    /// Fences the uploads issued since the last fence, so their space is
+    /// reused once the GPU has read it. Call after each batch of uploads.
+    /// </summary>
+    void fence();
+
+    /// <summary>
+    /// Whether allocate would find space without waiting for the GPU.
+    /// </summary>
+    bool fits(GLuint bytes, GLuint alignment = 16) const {
+      return findSpace(bytes, alignment).has_value();
+    }
+
+    /// <summary>
+    /// Reference to an allocation, for functions writing through a mapping.
+    /// </summary>
+    gl::MappingRef ref(const Allocation& allocation) const {
+      return gl::MappingRef(mapping, allocation.offset);
+    }
+
+    /// <summary>
+    /// The ring's buffer, to copy staged data from.
+    /// </summary>
+    const gl::Buffer& getBuffer() const { return buffer; }
+    GLuint capacity() const { return buffer.size(); }
+    /// <summary>
+    /// Bytes allocated and not yet released, including padding.
+    /// </summary>
+    GLuint getUsedBytes() const { return used; }
+    /// <summary>
+    /// Times allocate had to wait for the GPU.
+    /// </summary>
+    uint64_t getStalls() const { return stalls; }
+
+  protected:
+    struct Segment {
+      /// <summary>
+      /// Ring offset the segment ends at, the tail once it is released.
+      /// </summary>
+      GLuint end;
+      /// <summary>
+      /// Bytes of the segment, padding and wrapped space included.
+      /// </summary>
+      GLuint bytes;
+      gl::Fence fence;
+    };
+
+    gl::Buffer buffer;
+    gl::Mapping mapping;
+    uint8_t* base = nullptr;
+
+    GLuint head = 0;
+    GLuint tail = 0;
+    GLuint used = 0;
+    /// <summary>
+    /// Bytes allocated since the last fence.
+    /// </summary>
+    GLuint unfenced = 0;
+    std::deque<Segment> segments;
+    uint64_t stalls = 0;
+
+    /// <summary>
+    /// Offset bytes fit at without overwriting unreleased data, if any.
+    /// </summary>
+    std::optional<GLuint> findSpace(GLuint bytes, GLuint alignment) const;
+    /// <summary>
+    /// Releases signalled segments, or waits for the oldest if wait is set.
+    /// </summary>
+    void release(bool wait);
+  };
+} // namespace engine::texture
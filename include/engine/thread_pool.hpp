@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Fixed size pool of worker threads for CPU side work (mesh conversion,
+  /// image decoding, skinning etc).
+  /// Jobs must not touch OpenGL, as the context is only current on the main
+  /// thread.
+  /// </summary>
+  class ThreadPool {
+  public:
+    /// <summary>
+    /// Creates a pool with the given number of worker threads.
+    /// </summary>
+    /// <param name="threadCount">Number of workers. 0 runs every job on the
+    /// calling thread.</param>
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ThreadPool(ThreadPool&&) = delete;
+    ThreadPool& operator=(ThreadPool&&) = delete;
+
+    /// <summary>
+    /// Queues a job to run on a worker thread.
+    /// </summary>
+    /// <param name="func">Job to run</param>
+    /// <returns>Future holding the result of the job</returns>
+    template <typename F>
+    auto submit(F&& func) -> std::future<std::invoke_result_t<F>> {
+      using Result = std::invoke_result_t<F>;
+      std::packaged_task<Result()> task(std::forward<F>(func));
+      auto future = task.get_future();
+
+      if (workers.empty()) {
+        task();
+        return future;
+      }
+
+      enqueue([task = std::move(task)]() mutable { task(); });
+      return future;
+    }
+
+    /// <summary>
+    /// Splits [0, count) into batches and runs func(begin, end) for each of
+    /// them, across the workers and the calling thread. Blocks until every
+    /// batch is done. Safe to call from inside a job.
+    /// </summary>
+    /// <param name="count">Number of items</param>
+    /// <param name="minBatchSize">Smallest number of items worth handing to
+    /// another thread</param>
+    /// <param name="func">Function to run on each batch</param>
+    void parallelFor(size_t count, size_t minBatchSize,
+                     const std::function<void(size_t, size_t)>& func);
+
+    inline unsigned int threadCount() const {
+      return static_cast<unsigned int>(workers.size());
+    }
+
+    /// <summary>
+    /// Number of workers to use by default. Leaves one hardware thread for the
+    /// main (GL) thread.
+    /// </summary>
+    static unsigned int defaultThreadCount();
+
+    /// <summary>
+    /// Engine wide pool, created on first use.
+    /// </summary>
+    static ThreadPool& global();
+
+  protected:
+    void enqueue(std::move_only_function<void()>&& job);
+    void workerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::move_only_function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+  };
+} // namespace engine
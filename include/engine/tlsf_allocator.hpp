@@ -0,0 +1,125 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace engine {
+  /// <summary>
+  /// Two Level Segregated Fit allocator of a 64 bit address range. Allocate
+  /// and free are O(1): free blocks are kept in lists by size class, found
+  /// through two levels of bitmaps, and neighbouring free blocks are merged
+  /// on free. It only tracks offsets, the memory lives elsewhere (a GPU
+  /// buffer for GpuHeap).
+  /// </summary>
+  class TlsfAllocator {
+  public:
+    /// <summary>
+    /// Every offset and size is a multiple of this.
+    /// </summary>
+    constexpr static uint64_t GRANULARITY = 16;
+    constexpr static uint32_t NO_BLOCK = ~0u;
+
+    struct Allocation {
+      uint64_t offset = 0;
+      uint64_t size = 0;
+      /// <summary>
+      /// Block to give back to free.
+      /// </summary>
+      uint32_t block = NO_BLOCK;
+
+      bool isValid() const { return block != NO_BLOCK; }
+    };
+
+    explicit TlsfAllocator(uint64_t capacity);
+
+    /// <summary>
+    /// Allocates a range of at least size bytes.
+    /// </summary>
+    /// <param name="alignment">Power of two, raised to GRANULARITY</param>
+    /// <returns>The range, or nullopt if no free block is large
+    /// enough</returns>
+    std::optional<Allocation> allocate(uint64_t size,
+                                       uint64_t alignment = GRANULARITY);
+
+    /// <summary>
+    /// Allocates a range that ends at or before limit, for compaction.
+    /// Searches the free blocks large enough, smallest class first.
+    /// </summary>
+    /// <param name="budget">Most free blocks to look at, decremented by the
+    /// number looked at</param>
+    std::optional<Allocation> allocateBelow(uint64_t size, uint64_t alignment,
+                                            uint64_t limit, uint32_t& budget);
+
+    void free(uint32_t block);
+    void free(const Allocation& allocation) { free(allocation.block); }
+
+    /// <summary>
+    /// Allocated block physically before block, or the last allocated block
+    /// if block is NO_BLOCK. O(1), as free neighbours are always merged.
+    /// </summary>
+    std::optional<Allocation> previousAllocated(uint32_t block) const;
+
+    uint64_t capacity() const { return totalSize; }
+    uint64_t getUsedBytes() const { return usedBytes; }
+    uint64_t getFreeBytes() const { return totalSize - usedBytes; }
+    uint32_t getAllocationCount() const { return allocationCount; }
+    bool empty() const { return allocationCount == 0; }
+    /// <summary>
+    /// Size of the largest free block, the largest allocation possible.
+    /// </summary>
+    uint64_t getLargestFreeBlock() const;
+    /// <summary>
+    /// 0 when all free space is one block, towards 1 as it is split up.
+    /// </summary>
+    float getFragmentation() const;
+
+  protected:
+    constexpr static uint32_t SL_BITS = 5;
+    constexpr static uint32_t SL_COUNT = 1u << SL_BITS;
+    constexpr static uint32_t GRANULARITY_SHIFT = 4;
+    /// <summary>
+    /// Blocks below 2^FL_SHIFT share the first level, split linearly.
+    /// </summary>
+    constexpr static uint32_t FL_SHIFT = SL_BITS + GRANULARITY_SHIFT;
+    constexpr static uint32_t FL_COUNT = 64 - FL_SHIFT + 1;
+
+    struct Block {
+      uint64_t offset = 0;
+      uint64_t size = 0;
+      uint32_t prevPhysical = NO_BLOCK;
+      uint32_t nextPhysical = NO_BLOCK;
+      uint32_t prevFree = NO_BLOCK;
+      uint32_t nextFree = NO_BLOCK;
+      bool free = false;
+    };
+
+    uint64_t totalSize;
+    uint64_t usedBytes = 0;
+    uint32_t allocationCount = 0;
+
+    std::vector<Block> blocks;
+    std::vector<uint32_t> unusedBlocks;
+    uint32_t lastBlock = NO_BLOCK;
+
+    uint64_t flBitmap = 0;
+    std::array<uint32_t, FL_COUNT> slBitmaps{};
+    std::array<std::array<uint32_t, SL_COUNT>, FL_COUNT> freeLists;
+
+    static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+    uint32_t newBlock();
+    void insertFree(uint32_t block);
+    void removeFree(uint32_t block);
+    /// <summary>
+    /// Finds a free block of at least size, searching classes that are all
+    /// large enough.
+    /// </summary>
+    uint32_t findFree(uint64_t size) const;
+    /// <summary>
+    /// Turns part of a free block into an allocated block, returning the
+    /// leftover space before and after it to the free lists.
+    /// </summary>
+    Allocation carve(uint32_t block, uint64_t offset, uint64_t size);
+  };
+} // namespace engine
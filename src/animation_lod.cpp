@@ -0,0 +1,24 @@
+#include "engine/animation_lod.hpp"
+
+namespace engine {
+  uint32_t AnimationLod::getUpdateInterval(const glm::vec3& centre,
+                                           float radius) const {
+    if (!frustum.has_value()) {
+      return 1;
+    }
+
+    if (!frustum->SphereInFrustum(centre, radius)) {
+      return settings.offscreenInterval;
+    }
+
+    // Distance to the nearest point of the bounding sphere
+    float distance = glm::max(glm::length(centre - position) - radius, 0.0f);
+    if (distance < settings.fullRateDistance) {
+      return 1;
+    }
+    if (distance < settings.nearDistance) {
+      return settings.nearInterval;
+    }
+    return settings.farInterval;
+  }
+} // namespace engine
@@ -76,6 +76,8 @@ namespace engine {
   }
 
   App::~App() {
+    // The global profiler outlives the context, its queries must not
+    engine::GpuProfiler::global().shutdown();
     for (auto& shutdown : pluginShutdowns) {
       shutdown();
     }
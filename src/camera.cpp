@@ -1,17 +1,31 @@
 #include "engine/camera.hpp"
 
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm\ext\matrix_clip_space.hpp>
 #include <glm\ext\matrix_transform.hpp>
 
 #include "GLFW/glfw3.h"
 #include "engine/constants.hpp"
+#include "gl/attribs.hpp"
 #include "imgui/imgui.h"
 #include "logger.hpp"
 
 namespace {
   uint32_t camId = 0;
-}
+  /// <summary>
+  /// Frames ended by Camera::endFrame.
+  /// </summary>
+  uint32_t cameraFrame = 0;
+
+  /// <summary>
+  /// Offset alignment for binding the matrices as a UBO.
+  /// </summary>
+  GLuint matrixAlignment() {
+    return std::max<GLuint>(
+        static_cast<GLuint>(gl::UNIFORM_BUFFER_OFFSET_ALIGNMENT), 16);
+  }
+} // namespace
 
 namespace engine {
   const float MOVE_SPEED = 15.0f;
@@ -20,23 +34,17 @@ namespace engine {
   Camera::Camera()
       : rotation(glm::quat(glm::vec3(0, 0, 0))), position({}),
         matrices(Matrices()),
-        matrixBuffer({sizeof(Matrices), nullptr,
-                      gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-                          gl::Buffer::Usage::PERSISTENT |
-                          gl::Buffer::Usage::COHERENT}),
-        id(camId++) {
-    matrixMapping = matrixBuffer.map(gl::Buffer::Mapping::COHERENT |
-                                     gl::Buffer::Mapping::PERSISTENT |
-                                     gl::Buffer::Mapping::WRITE);
-  }
+        matrixRing(gl::Buffer::roundToAlignment(sizeof(Matrices),
+                                                matrixAlignment()) *
+                   MAX_WRITES_PER_FRAME),
+        matrixFrame(cameraFrame), id(camId++) {}
 
   Camera::Camera(Rotation rotation, const glm::vec3& position)
       : position(position), matrices(Matrices()),
-        matrixBuffer({sizeof(Matrices), nullptr,
-                      gl::Buffer::Usage::DYNAMIC | gl::Buffer::Usage::WRITE |
-                          gl::Buffer::Usage::PERSISTENT |
-                          gl::Buffer::Usage::COHERENT}),
-        id(camId++) {
+        matrixRing(gl::Buffer::roundToAlignment(sizeof(Matrices),
+                                                matrixAlignment()) *
+                   MAX_WRITES_PER_FRAME),
+        matrixFrame(cameraFrame), id(camId++) {
     glm::vec3 radians = glm::radians(glm::vec3(rotation.x, rotation.y, 0.0f));
     glm::quat pitchQuat =
         glm::angleAxis(radians.x, glm::vec3(1.0f, 0.0f, 0.0f));
@@ -44,10 +52,6 @@ namespace engine {
     glm::quat rollQuat = glm::angleAxis(radians.z, glm::vec3(0.0f, 0.0f, 1.0f));
 
     this->rotation = glm::normalize(yawQuat * pitchQuat * rollQuat);
-
-    matrixMapping = matrixBuffer.map(gl::Buffer::Mapping::COHERENT |
-                                     gl::Buffer::Mapping::PERSISTENT |
-                                     gl::Buffer::Mapping::WRITE);
   }
 
   void Camera::onResize(int width, int height, glm::vec2 uvRange) {
@@ -55,8 +59,27 @@ namespace engine {
         glm::vec2(static_cast<float>(width), static_cast<float>(height));
     matrices.resolution = size;
     matrices.uvRange = uvRange;
-    matrixMapping.write(&matrices.resolution, sizeof(glm::vec2) * 2,
-                        offsetof(Matrices, resolution));
+    writeMatrices();
+  }
+
+  void Camera::endFrame() { ++cameraFrame; }
+
+  void Camera::writeMatrices() {
+    if (matrixFrame != cameraFrame) {
+      matrixRing.nextFrame();
+      matrixFrame = cameraFrame;
+    } else if (matrixAllocation &&
+               gl::Buffer::roundToAlignment(matrixRing.getUsedBytes(),
+                                            matrixAlignment()) +
+                       sizeof(Matrices) >
+                   matrixRing.getFrameSize()) {
+      // Queued draws may still read the latest copy, so it can't be reused
+      engine::Logger::error("Camera matrices written more than {} times in a "
+                            "frame, skipping the write",
+                            MAX_WRITES_PER_FRAME);
+      return;
+    }
+    matrixAllocation = matrixRing.write(matrices, matrixAlignment());
   }
 
   PerspectiveCamera::PerspectiveCamera(float nearClip, float farClip,
@@ -0,0 +1,298 @@
+#include "engine/command_list.hpp"
+
+#include "engine/cpu_profiler.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <cstring>
+#include <gl/state_cache.hpp>
+#include <type_traits>
+
+namespace engine {
+  namespace {
+    struct BindArgs {
+      GLenum target;
+      GLuint buffer;
+    };
+
+    struct BindRangeArgs {
+      GLenum target;
+      GLuint index;
+      GLuint buffer;
+      GLintptr offset;
+      GLsizeiptr size;
+    };
+
+    struct BindTextureArgs {
+      GLuint unit;
+      GLuint texture;
+    };
+
+    template <typename T> struct UniformArgs {
+      GLint location;
+      T value;
+    };
+
+    struct MultiDrawArgs {
+      GLenum mode;
+      GLenum type;
+      GLintptr offset;
+      GLsizei count;
+      GLsizei stride;
+    };
+
+    struct DispatchArgs {
+      GLuint x;
+      GLuint y;
+      GLuint z;
+    };
+
+    /// <summary>
+    /// Reads a command's arguments, which are not aligned in the arena.
+    /// </summary>
+    template <typename T> T read(const uint8_t* args) {
+      T value;
+      std::memcpy(&value, args, sizeof(T));
+      return value;
+    }
+  } // namespace
+
+  template <typename T> void CommandList::push(Op op, const T& args) {
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "Command arguments are copied as bytes");
+    static_assert(sizeof(T) <= UINT16_MAX, "Command arguments too large");
+
+    Header header{.op = op, .size = static_cast<uint16_t>(sizeof(T))};
+    auto at = data.size();
+    data.resize(at + sizeof(Header) + sizeof(T));
+    std::memcpy(data.data() + at, &header, sizeof(Header));
+    std::memcpy(data.data() + at + sizeof(Header), &args, sizeof(T));
+    ++commands;
+  }
+
+  void CommandList::useProgram(GLuint program) {
+    push(Op::USE_PROGRAM, program);
+  }
+
+  void CommandList::bindVertexArray(GLuint vao) {
+    push(Op::BIND_VERTEX_ARRAY, vao);
+  }
+
+  void CommandList::bindBuffer(GLenum target, GLuint buffer) {
+    push(Op::BIND_BUFFER, BindArgs{target, buffer});
+  }
+
+  void CommandList::bindBufferBase(GLenum target, GLuint index,
+                                   GLuint buffer) {
+    // Same as the StateCache, a size of -1 binds the whole buffer
+    bindBufferRange(target, index, buffer, 0, -1);
+  }
+
+  void CommandList::bindBufferRange(GLenum target, GLuint index,
+                                    GLuint buffer, GLintptr offset,
+                                    GLsizeiptr size) {
+    push(Op::BIND_BUFFER_RANGE,
+         BindRangeArgs{target, index, buffer, offset, size});
+  }
+
+  void CommandList::bindTextureUnit(GLuint unit, GLuint texture) {
+    push(Op::BIND_TEXTURE_UNIT, BindTextureArgs{unit, texture});
+  }
+
+  void CommandList::setUniform(GLint location, GLint value) {
+    push(Op::UNIFORM_INT, UniformArgs<GLint>{location, value});
+  }
+
+  void CommandList::setUniform(GLint location, GLuint value) {
+    push(Op::UNIFORM_UINT, UniformArgs<GLuint>{location, value});
+  }
+
+  void CommandList::setUniform(GLint location, float value) {
+    push(Op::UNIFORM_FLOAT, UniformArgs<float>{location, value});
+  }
+
+  void CommandList::setUniform(GLint location, const glm::vec2& value) {
+    push(Op::UNIFORM_VEC2, UniformArgs<glm::vec2>{location, value});
+  }
+
+  void CommandList::setUniform(GLint location, const glm::vec3& value) {
+    push(Op::UNIFORM_VEC3, UniformArgs<glm::vec3>{location, value});
+  }
+
+  void CommandList::setUniform(GLint location, const glm::vec4& value) {
+    push(Op::UNIFORM_VEC4, UniformArgs<glm::vec4>{location, value});
+  }
+
+  void CommandList::setUniform(GLint location, const glm::mat4& value) {
+    push(Op::UNIFORM_MAT4, UniformArgs<glm::mat4>{location, value});
+  }
+
+  void CommandList::multiDrawElementsIndirect(GLenum mode, GLenum type,
+                                              GLintptr offset, GLsizei count,
+                                              GLsizei stride) {
+    push(Op::MULTI_DRAW_ELEMENTS_INDIRECT,
+         MultiDrawArgs{mode, type, offset, count, stride});
+  }
+
+  void CommandList::dispatchCompute(GLuint x, GLuint y, GLuint z) {
+    push(Op::DISPATCH_COMPUTE, DispatchArgs{x, y, z});
+  }
+
+  void CommandList::dispatchComputeIndirect(GLintptr offset) {
+    push(Op::DISPATCH_COMPUTE_INDIRECT, offset);
+  }
+
+  void CommandList::memoryBarrier(GLbitfield barriers) {
+    push(Op::MEMORY_BARRIER, barriers);
+  }
+
+  void CommandList::replay() const {
+    auto& cache = gl::StateCache::get();
+    const uint8_t* at = data.data();
+    const uint8_t* end = at + data.size();
+
+    while (at < end) {
+      auto header = read<Header>(at);
+      const uint8_t* args = at + sizeof(Header);
+      at = args + header.size;
+
+      switch (header.op) {
+      case Op::USE_PROGRAM:
+        cache.useProgram(read<GLuint>(args));
+        break;
+      case Op::BIND_VERTEX_ARRAY:
+        cache.bindVertexArray(read<GLuint>(args));
+        break;
+      case Op::BIND_BUFFER: {
+        auto bind = read<BindArgs>(args);
+        cache.bindBuffer(bind.target, bind.buffer);
+        break;
+      }
+      case Op::BIND_BUFFER_RANGE: {
+        auto bind = read<BindRangeArgs>(args);
+        cache.bindBufferRange(bind.target, bind.index, bind.buffer,
+                              bind.offset, bind.size);
+        break;
+      }
+      case Op::BIND_TEXTURE_UNIT: {
+        auto bind = read<BindTextureArgs>(args);
+        cache.bindTextureUnit(bind.unit, bind.texture);
+        break;
+      }
+      case Op::UNIFORM_INT: {
+        auto uniform = read<UniformArgs<GLint>>(args);
+        glUniform1i(uniform.location, uniform.value);
+        break;
+      }
+      case Op::UNIFORM_UINT: {
+        auto uniform = read<UniformArgs<GLuint>>(args);
+        glUniform1ui(uniform.location, uniform.value);
+        break;
+      }
+      case Op::UNIFORM_FLOAT: {
+        auto uniform = read<UniformArgs<float>>(args);
+        glUniform1f(uniform.location, uniform.value);
+        break;
+      }
+      case Op::UNIFORM_VEC2: {
+        auto uniform = read<UniformArgs<glm::vec2>>(args);
+        glUniform2fv(uniform.location, 1, &uniform.value[0]);
+        break;
+      }
+      case Op::UNIFORM_VEC3: {
+        auto uniform = read<UniformArgs<glm::vec3>>(args);
+        glUniform3fv(uniform.location, 1, &uniform.value[0]);
+        break;
+      }
+      case Op::UNIFORM_VEC4: {
+        auto uniform = read<UniformArgs<glm::vec4>>(args);
+        glUniform4fv(uniform.location, 1, &uniform.value[0]);
+        break;
+      }
+      case Op::UNIFORM_MAT4: {
+        auto uniform = read<UniformArgs<glm::mat4>>(args);
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE,
+                           &uniform.value[0][0]);
+        break;
+      }
+      case Op::MULTI_DRAW_ELEMENTS_INDIRECT: {
+        auto draw = read<MultiDrawArgs>(args);
+        glMultiDrawElementsIndirect(
+            draw.mode, draw.type,
+            reinterpret_cast<const void*>(draw.offset), draw.count,
+            draw.stride);
+        break;
+      }
+      case Op::DISPATCH_COMPUTE: {
+        auto dispatch = read<DispatchArgs>(args);
+        glDispatchCompute(dispatch.x, dispatch.y, dispatch.z);
+        break;
+      }
+      case Op::DISPATCH_COMPUTE_INDIRECT:
+        glDispatchComputeIndirect(read<GLintptr>(args));
+        break;
+      case Op::MEMORY_BARRIER:
+        glMemoryBarrier(read<GLbitfield>(args));
+        break;
+      default:
+#ifndef NDEBUG
+        engine::Logger::error("Unknown command {} in command list",
+                              static_cast<uint16_t>(header.op));
+#endif
+        return;
+      }
+    }
+  }
+
+  void CommandRecorder::record(size_t count, size_t batchSize,
+                               const RecordFunction& func, ThreadPool& pool) {
+    if (count == 0) {
+      return;
+    }
+    ENGINE_PROFILE_ZONE("Record commands");
+    batchSize = std::max<size_t>(batchSize, 1);
+    auto batches = static_cast<uint32_t>((count + batchSize - 1) / batchSize);
+    auto first = used;
+    used += batches;
+    if (lists.size() < used) {
+      lists.resize(used);
+    }
+
+    pool.parallelFor(batches, 1, [&](size_t begin, size_t end) {
+      for (size_t batch = begin; batch < end; ++batch) {
+        size_t itemBegin = batch * batchSize;
+        size_t itemEnd = std::min(itemBegin + batchSize, count);
+        func(lists[first + batch], itemBegin, itemEnd);
+      }
+    });
+  }
+
+  void CommandRecorder::replay() const {
+    ENGINE_PROFILE_ZONE("Replay commands");
+    for (uint32_t i = 0; i < used; ++i) {
+      lists[i].replay();
+    }
+  }
+
+  void CommandRecorder::clear() {
+    for (uint32_t i = 0; i < used; ++i) {
+      lists[i].clear();
+    }
+    used = 0;
+  }
+
+  uint32_t CommandRecorder::getCommandCount() const {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < used; ++i) {
+      count += lists[i].getCommandCount();
+    }
+    return count;
+  }
+
+  size_t CommandRecorder::getCapacity() const {
+    size_t capacity = 0;
+    for (const auto& list : lists) {
+      capacity += list.getCapacity();
+    }
+    return capacity;
+  }
+} // namespace engine
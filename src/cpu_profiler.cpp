@@ -0,0 +1,236 @@
+#include "engine/cpu_profiler.hpp"
+
+#include "imgui/imgui.h"
+#include "logger.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+namespace engine {
+  namespace {
+    constexpr double NS_PER_MS = 1e6;
+    /// <summary>
+    /// Weight of the newest frame in the moving averages.
+    /// </summary>
+    constexpr double AVERAGE_WEIGHT = 0.1;
+
+    /// <summary>
+    /// Writes a zone name as a JSON string.
+    /// </summary>
+    void writeJsonString(std::ofstream& out, const char* text) {
+      out << '"';
+      for (; *text != '\0'; ++text) {
+        if (*text == '"' || *text == '\\') {
+          out << '\\';
+        }
+        out << *text;
+      }
+      out << '"';
+    }
+  } // namespace
+
+  CpuProfiler::CpuProfiler() : frameStart(now()) {}
+
+  CpuProfiler& CpuProfiler::global() {
+    static CpuProfiler profiler;
+    return profiler;
+  }
+
+  uint64_t CpuProfiler::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+  }
+
+  CpuProfiler::ThreadBuffer& CpuProfiler::threadBuffer() {
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (!buffer) {
+      buffer = std::make_shared<ThreadBuffer>();
+      auto& profiler = global();
+      std::lock_guard lock(profiler.threadsMutex);
+      buffer->id = static_cast<uint32_t>(profiler.threads.size());
+      profiler.threads.push_back(buffer);
+    }
+    return *buffer;
+  }
+
+  void CpuProfiler::setThreadName(const char* name) {
+    auto& buffer = threadBuffer();
+    std::lock_guard lock(global().threadsMutex);
+    buffer.name = name;
+  }
+
+  void CpuProfiler::readThread(ThreadBuffer& buffer) {
+    auto written = buffer.written.load(std::memory_order_acquire);
+    uint64_t from = written > EVENTS_PER_THREAD
+                        ? std::max(buffer.read, written - EVENTS_PER_THREAD)
+                        : buffer.read;
+    dropped += from - buffer.read;
+    buffer.read = written;
+
+    auto first = frameEvents.size();
+    for (auto i = from; i < written; ++i) {
+      frameEvents.push_back(
+          {.event = buffer.events[i % EVENTS_PER_THREAD], .thread = buffer.id});
+    }
+
+    // The thread keeps recording while its events are copied, and may have
+    // wrapped over the oldest of them
+    auto after = buffer.written.load(std::memory_order_acquire);
+    if (after > EVENTS_PER_THREAD && after - EVENTS_PER_THREAD > from) {
+      auto lost = std::min(after - EVENTS_PER_THREAD, written) - from;
+      frameEvents.erase(frameEvents.begin() + first,
+                        frameEvents.begin() + first + lost);
+      dropped += lost;
+    }
+  }
+
+  void CpuProfiler::nextFrame() {
+    auto end = now();
+    frameMs = (end - frameStart) / NS_PER_MS;
+    frameThread = threadBuffer().id;
+
+    frameEvents.clear();
+    {
+      std::lock_guard lock(threadsMutex);
+      for (auto& thread : threads) {
+        readThread(*thread);
+      }
+    }
+    // Parents start before their children, so each thread's events read as
+    // its hierarchy
+    std::sort(frameEvents.begin(), frameEvents.end(),
+              [](const ThreadEvent& a, const ThreadEvent& b) {
+                if (a.thread != b.thread) {
+                  return a.thread < b.thread;
+                }
+                if (a.event.startNs != b.event.startNs) {
+                  return a.event.startNs < b.event.startNs;
+                }
+                return a.event.depth < b.event.depth;
+              });
+
+    for (auto& [name, zone] : stats) {
+      zone.calls = 0;
+      zone.totalMs = 0.0;
+      zone.maxMs = 0.0;
+    }
+    for (const auto& [event, thread] : frameEvents) {
+      auto& zone = stats[event.name];
+      double ms = (event.endNs - event.startNs) / NS_PER_MS;
+      ++zone.calls;
+      zone.totalMs += ms;
+      zone.maxMs = std::max(zone.maxMs, ms);
+    }
+    for (auto& [name, zone] : stats) {
+      zone.averageMs += (zone.totalMs - zone.averageMs) * AVERAGE_WEIGHT;
+    }
+
+    if (captureFramesLeft > 0) {
+      capture.insert(capture.end(), frameEvents.begin(), frameEvents.end());
+      captureFrames.emplace_back(frameStart, end);
+      if (--captureFramesLeft == 0) {
+        if (writeTrace(capturePath)) {
+          engine::Logger::info("Wrote {} frames to {}", captureFrames.size(),
+                               capturePath.string());
+        }
+        capture.clear();
+        captureFrames.clear();
+      }
+    }
+    frameStart = end;
+  }
+
+  void CpuProfiler::startCapture(const std::filesystem::path& path,
+                                 uint32_t frames) {
+    capturePath = path;
+    captureFramesLeft = std::max(frames, 1u);
+    capture.clear();
+    captureFrames.clear();
+  }
+
+  bool CpuProfiler::writeTrace(const std::filesystem::path& path) {
+    std::ofstream out(path);
+    if (!out) {
+      engine::Logger::error("Could not open {} to write the CPU trace",
+                            path.string());
+      return false;
+    }
+
+    uint64_t base = captureFrames.empty() ? 0 : captureFrames.front().first;
+    out.precision(3);
+    out << std::fixed << "{\"traceEvents\":[\n";
+    {
+      std::lock_guard lock(threadsMutex);
+      for (const auto& thread : threads) {
+        out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+            << thread->id << ",\"args\":{\"name\":";
+        if (thread->name != nullptr) {
+          writeJsonString(out, thread->name);
+        } else {
+          out << "\"Thread " << thread->id << '"';
+        }
+        out << "}},\n";
+      }
+    }
+    for (size_t i = 0; i < captureFrames.size(); ++i) {
+      auto [start, end] = captureFrames[i];
+      out << "{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+          << frameThread << ",\"ts\":" << (start - base) / 1e3
+          << ",\"dur\":" << (end - start) / 1e3 << ",\"args\":{\"frame\":"
+          << i << "}}";
+      out << (i + 1 < captureFrames.size() || !capture.empty() ? ",\n" : "\n");
+    }
+    for (size_t i = 0; i < capture.size(); ++i) {
+      const auto& [event, thread] = capture[i];
+      // Events recorded before the capture started
+      double ts = event.startNs >= base ? (event.startNs - base) / 1e3 : 0.0;
+      out << "{\"name\":";
+      writeJsonString(out, event.name);
+      out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread << ",\"ts\":" << ts
+          << ",\"dur\":" << (event.endNs - event.startNs) / 1e3 << "}"
+          << (i + 1 < capture.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+  }
+
+  void CpuProfiler::DebugUI() {
+    ImGui::Text("CPU frame: %.3f ms, dropped zones: %llu", frameMs,
+                static_cast<unsigned long long>(dropped));
+    if (isCapturing()) {
+      ImGui::Text("Capturing, %u frames left", captureFramesLeft);
+    } else if (ImGui::Button("Capture trace")) {
+      startCapture("cpu_trace.json");
+    }
+
+    if (ImGui::TreeNode("Zones")) {
+      std::vector<std::pair<std::string_view, const ZoneStats*>> sorted;
+      sorted.reserve(stats.size());
+      for (const auto& [name, zone] : stats) {
+        sorted.emplace_back(name, &zone);
+      }
+      std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+        return a.second->averageMs > b.second->averageMs;
+      });
+
+      for (const auto& [name, zone] : sorted) {
+        ImGui::Text("%.*s: %.3f ms avg, %u calls, %.3f ms max",
+                    static_cast<int>(name.size()), name.data(),
+                    zone->averageMs, zone->calls, zone->maxMs);
+      }
+      ImGui::TreePop();
+    }
+
+    if (ImGui::TreeNode("Last frame")) {
+      for (const auto& [event, thread] : frameEvents) {
+        if (thread != frameThread) {
+          continue;
+        }
+        ImGui::Text("%*s%s: %.3f ms", static_cast<int>(event.depth * 2), "",
+                    event.name, (event.endNs - event.startNs) / NS_PER_MS);
+      }
+      ImGui::TreePop();
+    }
+  }
+} // namespace engine
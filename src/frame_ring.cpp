@@ -0,0 +1,65 @@
+#include "engine/frame_ring.hpp"
+
+#include "logger.hpp"
+#include <bit>
+
+namespace {
+  /// <summary>
+  /// Largest uniform and storage buffer offset alignment in practice, so
+  /// every slice starts at a bindable offset.
+  /// </summary>
+  constexpr GLuint SLICE_ALIGNMENT = 256;
+} // namespace
+
+namespace engine {
+  FrameRing::FrameRing(GLuint frameSize, uint32_t frames)
+      : frameSize(gl::Buffer::roundToAlignment(frameSize, SLICE_ALIGNMENT)),
+        buffer({this->frameSize * frames, nullptr,
+                gl::Buffer::Usage::WRITE | gl::Buffer::Usage::PERSISTENT |
+                    gl::Buffer::Usage::COHERENT}),
+        fences(frames) {
+    mapping = buffer.map(gl::Buffer::Mapping::COHERENT |
+                         gl::Buffer::Mapping::PERSISTENT |
+                         gl::Buffer::Mapping::WRITE);
+    buffer.label("Frame Ring");
+    base = static_cast<uint8_t*>(mapping.get());
+  }
+
+  void FrameRing::nextFrame() {
+    fences[slice].emplace();
+    slice = (slice + 1) % static_cast<uint32_t>(fences.size());
+    head = slice * frameSize;
+
+    auto& fence = fences[slice];
+    if (fence.has_value()) {
+      if (!fence->signalled()) {
+        ++stalls;
+        fence->wait();
+      }
+      fence.reset();
+    }
+  }
+
+  std::optional<FrameRing::Allocation> FrameRing::allocate(GLuint bytes,
+                                                           GLuint alignment) {
+#ifndef NDEBUG
+    if (!std::has_single_bit(alignment)) {
+      engine::Logger::error("Frame ring alignment {} is not a power of two",
+                            alignment);
+      return std::nullopt;
+    }
+#endif
+    GLuint offset = gl::Buffer::roundToAlignment(head, alignment);
+    if (offset + bytes > (slice + 1) * frameSize) {
+      engine::Logger::error("Frame ring slice is full, {} bytes not allocated",
+                            bytes);
+      return std::nullopt;
+    }
+
+    head = offset + bytes;
+    return Allocation{
+        .data = std::span(base + offset, bytes),
+        .offset = offset,
+    };
+  }
+} // namespace engine
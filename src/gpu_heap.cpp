@@ -0,0 +1,233 @@
+#include "engine/gpu_heap.hpp"
+
+#include "imgui/imgui.h"
+#include "logger.hpp"
+#include <algorithm>
+#include <string>
+
+namespace engine {
+  GpuHeap::Heap::Heap(GLuint size)
+      : buffer(size, nullptr, gl::Buffer::Usage::DYNAMIC), allocator(size) {}
+
+  GpuHeap::GpuHeap(GLuint heapSize) : heapSize(heapSize) {}
+
+  uint32_t GpuHeap::createHeap(GLuint size) {
+    uint32_t index = 0;
+    while (index < heaps.size() && heaps[index]) {
+      ++index;
+    }
+    if (index == heaps.size()) {
+      heaps.emplace_back();
+    }
+
+    heaps[index] = std::make_unique<Heap>(size);
+    std::string name = "GPU Heap " + std::to_string(index);
+    heaps[index]->buffer.label(name.c_str());
+    return index;
+  }
+
+  void GpuHeap::setOwner(Heap& heap, uint32_t block, Handle handle) {
+    if (block >= heap.owners.size()) {
+      heap.owners.resize(block + 1, INVALID_HANDLE);
+    }
+    heap.owners[block] = handle;
+  }
+
+  GpuHeap::Handle GpuHeap::allocate(GLuint size, GLuint alignment,
+                                    const void* data, bool movable) {
+    std::optional<TlsfAllocator::Allocation> allocation;
+    uint32_t heapIndex = 0;
+    for (; heapIndex < heaps.size(); ++heapIndex) {
+      if (heaps[heapIndex] &&
+          (allocation = heaps[heapIndex]->allocator.allocate(size, alignment))) {
+        break;
+      }
+    }
+
+    if (!allocation) {
+      // Oversized allocations get a heap of their own
+      GLuint newSize = std::max(
+          heapSize, gl::Buffer::roundToAlignment(
+                        size + alignment,
+                        static_cast<GLuint>(TlsfAllocator::GRANULARITY)));
+      heapIndex = createHeap(newSize);
+      allocation = heaps[heapIndex]->allocator.allocate(size, alignment);
+      if (!allocation) {
+        engine::Logger::error("Could not allocate {} bytes from the GPU heap",
+                              size);
+        return INVALID_HANDLE;
+      }
+    }
+
+    Handle handle;
+    if (!freeSlots.empty()) {
+      handle = freeSlots.back();
+      freeSlots.pop_back();
+    } else {
+      handle = static_cast<Handle>(slots.size());
+      slots.emplace_back();
+    }
+    slots[handle] = {
+        .heap = heapIndex,
+        .allocation = *allocation,
+        .alignment = alignment,
+        .movable = movable,
+        .live = true,
+    };
+
+    auto& heap = *heaps[heapIndex];
+    setOwner(heap, allocation->block, handle);
+    if (data != nullptr) {
+      heap.buffer.subData(static_cast<GLuint>(allocation->offset), size, data);
+    }
+    return handle;
+  }
+
+  void GpuHeap::free(Handle handle) {
+#ifndef NDEBUG
+    if (handle >= slots.size() || !slots[handle].live) {
+      engine::Logger::error("Freeing invalid GPU heap handle {}", handle);
+      return;
+    }
+#endif
+    auto& slot = slots[handle];
+    if (slot.heap == defragHeap && slot.allocation.block == defragNext) {
+      stepDefragCursor(*heaps[slot.heap], defragNext);
+    }
+    heaps[slot.heap]->allocator.free(slot.allocation);
+    slot.live = false;
+    freeSlots.push_back(handle);
+  }
+
+  GpuHeap::Block GpuHeap::get(Handle handle) const {
+#ifndef NDEBUG
+    if (handle >= slots.size() || !slots[handle].live) {
+      engine::Logger::error("Reading invalid GPU heap handle {}", handle);
+      return {};
+    }
+#endif
+    const auto& slot = slots[handle];
+    return {
+        .buffer = &heaps[slot.heap]->buffer,
+        .offset = static_cast<GLuint>(slot.allocation.offset),
+        .size = static_cast<GLuint>(slot.allocation.size),
+    };
+  }
+
+  void GpuHeap::stepDefragCursor(const Heap& heap, uint32_t block) {
+    if (auto previous = heap.allocator.previousAllocated(block)) {
+      defragNext = previous->block;
+    } else {
+      ++defragHeap;
+      defragNext = TlsfAllocator::NO_BLOCK;
+    }
+  }
+
+  uint64_t GpuHeap::defragment(uint64_t maxBytes, uint32_t maxBlocks) {
+    uint64_t moved = 0;
+    uint32_t budget = maxBlocks;
+    while (budget > 0 && moved < maxBytes && !heaps.empty()) {
+      --budget;
+      if (defragHeap >= heaps.size()) {
+        defragHeap = 0;
+        defragNext = TlsfAllocator::NO_BLOCK;
+      }
+      if (!heaps[defragHeap]) {
+        ++defragHeap;
+        continue;
+      }
+      auto& heap = *heaps[defragHeap];
+
+      // Move the last allocations into earlier space that fits
+      uint32_t block = defragNext;
+      if (block == TlsfAllocator::NO_BLOCK) {
+        auto last = heap.allocator.previousAllocated(TlsfAllocator::NO_BLOCK);
+        if (!last) {
+          ++defragHeap;
+          continue;
+        }
+        block = last->block;
+      }
+      // Stepped past first, as moving the allocation frees its block
+      stepDefragCursor(heap, block);
+
+      auto handle = heap.owners[block];
+      auto& slot = slots[handle];
+      if (!slot.movable) {
+        continue;
+      }
+      auto source = slot.allocation;
+      auto target = heap.allocator.allocateBelow(source.size, slot.alignment,
+                                                 source.offset, budget);
+      if (!target) {
+        continue;
+      }
+
+      // The target ends before the source, so the ranges never overlap
+      heap.buffer.copyTo(heap.buffer, static_cast<GLuint>(source.offset),
+                         static_cast<GLuint>(target->offset),
+                         static_cast<GLuint>(source.size));
+      heap.allocator.free(source);
+      slot.allocation = *target;
+      setOwner(heap, target->block, handle);
+      moved += source.size;
+    }
+
+    // Release empty heaps, keeping one to allocate from
+    uint32_t remaining = 0;
+    for (auto& heap : heaps) {
+      if (heap && (!heap->allocator.empty() || remaining == 0)) {
+        ++remaining;
+        continue;
+      }
+      heap.reset();
+    }
+    return moved;
+  }
+
+  GpuHeap::Stats GpuHeap::getStats() const {
+    Stats stats;
+    uint64_t freeBytes = 0;
+    uint64_t largestFreeSum = 0;
+    for (const auto& heap : heaps) {
+      if (!heap) {
+        continue;
+      }
+      const auto& allocator = heap->allocator;
+      ++stats.heaps;
+      stats.allocations += allocator.getAllocationCount();
+      stats.capacity += allocator.capacity();
+      stats.usedBytes += allocator.getUsedBytes();
+      auto largest = allocator.getLargestFreeBlock();
+      stats.largestFreeBlock = std::max(stats.largestFreeBlock, largest);
+      freeBytes += allocator.getFreeBytes();
+      largestFreeSum += largest;
+    }
+    if (freeBytes > 0) {
+      stats.fragmentation =
+          1.0f - static_cast<float>(largestFreeSum) / freeBytes;
+    }
+    return stats;
+  }
+
+  void GpuHeap::DebugUI() const {
+    auto stats = getStats();
+    constexpr float MIB = 1024.0f * 1024.0f;
+    ImGui::Text("Heaps: %u, Allocations: %u", stats.heaps, stats.allocations);
+    ImGui::Text("Used: %.2f / %.2f MiB", stats.usedBytes / MIB,
+                stats.capacity / MIB);
+    ImGui::Text("Largest free block: %.2f MiB", stats.largestFreeBlock / MIB);
+    ImGui::Text("Fragmentation: %.1f%%", stats.fragmentation * 100.0f);
+
+    for (size_t i = 0; i < heaps.size(); ++i) {
+      if (!heaps[i]) {
+        continue;
+      }
+      const auto& allocator = heaps[i]->allocator;
+      float usage = static_cast<float>(allocator.getUsedBytes()) /
+                    static_cast<float>(allocator.capacity());
+      std::string label = "Heap " + std::to_string(i);
+      ImGui::ProgressBar(usage, ImVec2(-1.0f, 0.0f), label.c_str());
+    }
+  }
+} // namespace engine
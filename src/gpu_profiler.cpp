@@ -0,0 +1,247 @@
+#include "engine/gpu_profiler.hpp"
+
+#include "imgui/imgui.h"
+#include "logger.hpp"
+#include <algorithm>
+#include <cfloat>
+#include <fstream>
+
+namespace engine {
+  namespace {
+    constexpr double NS_PER_MS = 1e6;
+
+    /// <summary>
+    /// Writes a zone name as a JSON string.
+    /// </summary>
+    void writeJsonString(std::ofstream& out, const char* text) {
+      out << '"';
+      for (; *text != '\0'; ++text) {
+        if (*text == '"' || *text == '\\') {
+          out << '\\';
+        }
+        out << *text;
+      }
+      out << '"';
+    }
+  } // namespace
+
+  GpuProfiler::GpuProfiler(uint32_t latency)
+      : frames(std::max(latency, 2u)), history(HISTORY) {
+    beginFrame();
+  }
+
+  GpuProfiler& GpuProfiler::global() {
+    static GpuProfiler profiler;
+    return profiler;
+  }
+
+  uint32_t GpuProfiler::timestamp() {
+    auto& frame = frames[current];
+    if (frame.usedQueries == frame.queries.size()) {
+      frame.queries.emplace_back(GL_TIMESTAMP);
+    }
+    frame.queries[frame.usedQueries].timestamp();
+    return frame.usedQueries++;
+  }
+
+  void GpuProfiler::beginFrame() {
+    auto& frame = frames[current];
+    frame.usedQueries = 0;
+    frame.zones.clear();
+    frame.frame = frameIndex;
+    frame.recorded = false;
+    stack.clear();
+    if (enabled) {
+      timestamp();
+    }
+  }
+
+  void GpuProfiler::beginZone(const char* name) {
+    if (!enabled) {
+      return;
+    }
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+
+    auto& frame = frames[current];
+    stack.push_back(static_cast<uint32_t>(frame.zones.size()));
+    frame.zones.push_back({
+        .name = name,
+        .depth = static_cast<uint32_t>(stack.size() - 1),
+        .begin = timestamp(),
+        .end = 0,
+    });
+  }
+
+  void GpuProfiler::endZone() {
+    if (!enabled || stack.empty()) {
+      return;
+    }
+    frames[current].zones[stack.back()].end = timestamp();
+    stack.pop_back();
+    glPopDebugGroup();
+  }
+
+  void GpuProfiler::nextFrame() {
+    if (enabled) {
+#ifndef NDEBUG
+      if (!stack.empty()) {
+        engine::Logger::warn("GPU zone '{}' still open at the end of a frame",
+                             frames[current].zones[stack.back()].name);
+      }
+#endif
+      while (!stack.empty()) {
+        endZone();
+      }
+      timestamp();
+      frames[current].recorded = true;
+    }
+
+    ++frameIndex;
+    current = (current + 1) % frames.size();
+    // The oldest frame in flight, recorded latency - 1 frames ago
+    if (frames[current].recorded) {
+      resolve(frames[current]);
+    }
+    beginFrame();
+  }
+
+  void GpuProfiler::resolve(Frame& frame) {
+    // Timestamps complete in order, so the last being available means all
+    // of them are
+    if (!frame.queries[frame.usedQueries - 1].available()) {
+      ++dropped;
+      return;
+    }
+    if (paused) {
+      return;
+    }
+
+    auto& result = history[historyHead];
+    historyHead = (historyHead + 1) % HISTORY;
+    historyCount = std::min(historyCount + 1, HISTORY);
+
+    uint64_t start = frame.queries[0].result();
+    uint64_t end = frame.queries[frame.usedQueries - 1].result();
+    result.frame = frame.frame;
+    result.startNs = start;
+    result.durationMs = (end - start) / NS_PER_MS;
+    result.zones.clear();
+    for (const auto& zone : frame.zones) {
+      uint64_t zoneStart = frame.queries[zone.begin].result();
+      uint64_t zoneEnd = frame.queries[zone.end].result();
+      result.zones.push_back({
+          .name = zone.name,
+          .depth = zone.depth,
+          .startMs = (zoneStart - start) / NS_PER_MS,
+          .durationMs = (zoneEnd - zoneStart) / NS_PER_MS,
+      });
+    }
+  }
+
+  void GpuProfiler::setEnabled(bool enable) {
+    if (enable == enabled) {
+      return;
+    }
+    if (!enable) {
+      for (size_t i = 0; i < stack.size(); ++i) {
+        glPopDebugGroup();
+      }
+    }
+    enabled = enable;
+    for (auto& frame : frames) {
+      frame.recorded = false;
+    }
+    beginFrame();
+  }
+
+  void GpuProfiler::shutdown() {
+    setEnabled(false);
+    for (auto& frame : frames) {
+      frame.queries.clear();
+      frame.usedQueries = 0;
+    }
+  }
+
+  const GpuProfiler::FrameResult* GpuProfiler::getLatest() const {
+    if (historyCount == 0) {
+      return nullptr;
+    }
+    return &history[(historyHead + HISTORY - 1) % HISTORY];
+  }
+
+  bool GpuProfiler::writeTrace(const std::filesystem::path& path) const {
+    std::ofstream out(path);
+    if (!out) {
+      engine::Logger::error("Could not open {} to write the GPU trace",
+                            path.string());
+      return false;
+    }
+
+    uint32_t oldest = (historyHead + HISTORY - historyCount) % HISTORY;
+    uint64_t base = historyCount > 0 ? history[oldest].startNs : 0;
+
+    out << "{\"traceEvents\":[\n"
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+           "\"args\":{\"name\":\"GPU\"}}";
+    out.precision(3);
+    out << std::fixed;
+    for (uint32_t i = 0; i < historyCount; ++i) {
+      const auto& frame = history[(oldest + i) % HISTORY];
+      double frameUs = (frame.startNs - base) / 1e3;
+      out << ",\n{\"name\":\"Frame\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+          << frameUs << ",\"dur\":" << frame.durationMs * 1e3
+          << ",\"args\":{\"frame\":" << frame.frame << "}}";
+      for (const auto& zone : frame.zones) {
+        out << ",\n{\"name\":";
+        writeJsonString(out, zone.name);
+        out << ",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+            << frameUs + zone.startMs * 1e3
+            << ",\"dur\":" << zone.durationMs * 1e3 << "}";
+      }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+  }
+
+  void GpuProfiler::DebugUI() {
+    bool enable = enabled;
+    if (ImGui::Checkbox("Enabled", &enable)) {
+      setEnabled(enable);
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Pause", &paused);
+    ImGui::SameLine();
+    if (ImGui::Button("Export trace")) {
+      if (writeTrace("gpu_trace.json")) {
+        engine::Logger::info("Wrote {} frames to gpu_trace.json",
+                             historyCount);
+      }
+    }
+
+    const auto* latest = getLatest();
+    if (latest == nullptr) {
+      ImGui::Text("No frames read back yet");
+      return;
+    }
+    ImGui::Text("GPU frame: %.3f ms, dropped: %llu", latest->durationMs,
+                static_cast<unsigned long long>(dropped));
+
+    ImGui::PlotLines(
+        "##GPU frame times",
+        [](void* data, int i) {
+          auto& profiler = *static_cast<GpuProfiler*>(data);
+          uint32_t oldest =
+              (profiler.historyHead + HISTORY - profiler.historyCount) %
+              HISTORY;
+          return static_cast<float>(
+              profiler.history[(oldest + i) % HISTORY].durationMs);
+        },
+        this, static_cast<int>(historyCount), 0, nullptr, 0.0f, FLT_MAX,
+        ImVec2(-1.0f, 60.0f));
+
+    for (const auto& zone : latest->zones) {
+      ImGui::Text("%*s%s: %.3f ms", static_cast<int>(zone.depth * 2), "",
+                  zone.name, zone.durationMs);
+    }
+  }
+} // namespace engine
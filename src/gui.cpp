@@ -1,7 +1,10 @@
 #include "engine/gui.hpp"
+#include "engine/cpu_profiler.hpp"
+#include "engine/gpu_profiler.hpp"
 #include "imgui/backends/imgui_impl_glfw.h"
 #include "imgui/backends/imgui_impl_opengl3.h"
 #include "imgui/imgui.h"
+#include <gl/state_cache.hpp>
 
 namespace engine::gui {
   Context::Context(engine::Window& window)
@@ -27,8 +30,28 @@ namespace engine::gui {
     ImGui::NewFrame();
   }
   void Context::endFrame() {
+    if (showProfiler) {
+      if (ImGui::Begin("Profiler", &showProfiler)) {
+        if (ImGui::CollapsingHeader("CPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+          ImGui::PushID("CPU");
+          engine::CpuProfiler::global().DebugUI();
+          ImGui::PopID();
+        }
+        if (ImGui::CollapsingHeader("GPU", ImGuiTreeNodeFlags_DefaultOpen)) {
+          ImGui::PushID("GPU");
+          engine::GpuProfiler::global().DebugUI();
+          ImGui::PopID();
+        }
+      }
+      ImGui::End();
+    }
     ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    {
+      engine::GpuProfiler::Zone zone("ImGui");
+      ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+    }
+    // The renderer binds its own state behind the cache's back
+    gl::StateCache::get().invalidate();
   }
 
   void Context::sleep(int ms) { ImGui_ImplGlfw_Sleep(ms); }
@@ -1,5 +1,123 @@
 #include "engine/image.hpp"
+#include "engine/texture/upload_ring.hpp"
+
+#include <optional>
 
 namespace engine {
-  bool Image::yFlipped = false;
+  namespace {
+    /// <summary>
+    /// Makes stb_image flip (or not) on this thread only. The thread's flag
+    /// overrides the global one once set, so it is set on every decode.
+    /// </summary>
+    void setThreadFlip(bool flipY) {
+      stbi_set_flip_vertically_on_load_thread(flipY ? 1 : 0);
+    }
+  } // namespace
+
+  std::expected<Image, std::string>
+  Image::decode(std::string_view file, const ImageDecodeOptions& options) {
+    // string_view is not guaranteed to be null terminated
+    std::string path(file);
+    setThreadFlip(options.flipY);
+
+    int width, height, channels;
+    unsigned char* data = stbi_load(path.c_str(), &width, &height, &channels,
+                                    options.desiredChannels);
+    if (data == nullptr) {
+      // The failure reason is thread local too
+      return std::unexpected("Failed to load image from " + path + "\n" +
+                             stbi_failure_reason());
+    }
+    return Image(glm::ivec2(width, height),
+                 options.desiredChannels == 0 ? channels
+                                              : options.desiredChannels,
+                 data);
+  }
+
+  std::expected<Image, std::string>
+  Image::decode(std::span<const uint8_t> bytes,
+                const ImageDecodeOptions& options) {
+    setThreadFlip(options.flipY);
+
+    int width, height, channels;
+    unsigned char* data = stbi_load_from_memory(
+        bytes.data(), static_cast<int>(bytes.size()), &width, &height,
+        &channels, options.desiredChannels);
+    if (data == nullptr) {
+      return std::unexpected(std::string("Failed to decode image\n") +
+                             stbi_failure_reason());
+    }
+    return Image(glm::ivec2(width, height),
+                 options.desiredChannels == 0 ? channels
+                                              : options.desiredChannels,
+                 data);
+  }
+
+  std::vector<std::expected<Image, std::string>>
+  Image::decodeAll(std::span<const std::string> files,
+                   const ImageDecodeOptions& options, ThreadPool& pool) {
+    // Image has no default state, so decode into optionals first
+    std::vector<std::optional<std::expected<Image, std::string>>> decoded(
+        files.size());
+    pool.parallelFor(files.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        decoded[i].emplace(decode(files[i], options));
+      }
+    });
+
+    std::vector<std::expected<Image, std::string>> images;
+    images.reserve(files.size());
+    for (auto& image : decoded) {
+      images.push_back(std::move(*image));
+    }
+    return images;
+  }
+
+  gl::Texture Image::toTexture(int mipmaps,
+                               engine::texture::MipSettings settings,
+                               engine::texture::UploadRing* ring) const {
+    std::vector<engine::texture::MipLevel> levels;
+    if (mipmaps != 0) {
+      settings.levels =
+          mipmaps == -1
+              ? gl::Texture::calcMipLevels(dimensions.x, dimensions.y)
+              : mipmaps;
+      levels = generateMips(settings);
+    }
+
+    GLenum format = gl::Texture::formatFromChannels(channels);
+    gl::Texture tex{};
+    tex.storage(static_cast<GLint>(levels.size()) + 1,
+                gl::Texture::internalFormatFromChannels(channels), dimensions);
+
+    auto uploadLevel = [&](GLint level, glm::ivec2 size,
+                           const unsigned char* texels) {
+      if (ring) {
+        auto allocation = ring->stage(std::span(
+            texels, static_cast<size_t>(size.x) * size.y * channels));
+        if (allocation) {
+          ring->upload(tex, level, glm::ivec2(0), size, format,
+                       GL_UNSIGNED_BYTE, *allocation);
+          return;
+        }
+      }
+      tex.subImage(level, 0, 0, size.x, size.y, format, GL_UNSIGNED_BYTE,
+                   texels);
+    };
+
+    // Rows of 1 and 3 channel images are not 4 byte aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    uploadLevel(0, dimensions, data);
+    for (size_t i = 0; i < levels.size(); ++i) {
+      const auto& level = levels[i];
+      uploadLevel(static_cast<GLint>(i + 1), level.dimensions,
+                  level.data.data());
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (ring) {
+      ring->fence();
+    }
+
+    return tex;
+  }
 } // namespace engine
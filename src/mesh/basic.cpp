@@ -7,22 +7,85 @@ namespace engine::mesh {
     indexCount = meshData.indices().size();
 
     GLuint vertexSize = static_cast<GLuint>(sizeof(glm::vec3) * vertexCount);
-    GLuint indexSize = static_cast<GLuint>(sizeof(uint32_t) * indexCount);
 
-    vertices.init(vertexSize, meshData.vertices().data());
+    vertices.emplace(vertexSize, meshData.vertices().data());
 
     if (indexCount > 0) {
-      indices.init(indexSize, meshData.indices().data());
-      vao.bindIndexBuffer(indices.id());
+      if (vertexCount <= 0x10000) {
+        std::vector<uint16_t> shortIndices(meshData.indices().begin(),
+                                           meshData.indices().end());
+        indexType = gl::IndexType::U16;
+        indices.emplace(static_cast<GLuint>(sizeof(uint16_t) * indexCount),
+                        shortIndices.data());
+      } else {
+        indexType = gl::IndexType::U32;
+        indices.emplace(static_cast<GLuint>(sizeof(uint32_t) * indexCount),
+                        meshData.indices().data());
+      }
+      vao.bindIndexBuffer(indices->id());
     }
 
-    vao.bindVertexBuffer(0, vertices.id(), 0, sizeof(glm::vec3));
+    vao.bindVertexBuffer(0, vertices->id(), 0, sizeof(glm::vec3));
     vao.attribFormat(0, 3, GL_FLOAT, false, 0, 0);
   }
 
+  BasicMesh::BasicMesh(const engine::mesh::Data& meshData,
+                       engine::GpuHeap& heap) {
+    vertexCount = meshData.vertices().size();
+    indexCount = meshData.indices().size();
+
+    GLuint vertexSize = static_cast<GLuint>(sizeof(glm::vec3) * vertexCount);
+    heapVertices = engine::HeapAllocation(
+        heap, heap.allocate(vertexSize, 16,
+                            meshData.vertices().data()));
+
+    if (indexCount > 0) {
+      if (vertexCount <= 0x10000) {
+        std::vector<uint16_t> shortIndices(meshData.indices().begin(),
+                                           meshData.indices().end());
+        indexType = gl::IndexType::U16;
+        heapIndices = engine::HeapAllocation(
+            heap, heap.allocate(
+                      static_cast<GLuint>(sizeof(uint16_t) * indexCount), 16,
+                      shortIndices.data()));
+      } else {
+        indexType = gl::IndexType::U32;
+        heapIndices = engine::HeapAllocation(
+            heap, heap.allocate(
+                      static_cast<GLuint>(sizeof(uint32_t) * indexCount), 16,
+                      meshData.indices().data()));
+      }
+    }
+
+    vao.attribFormat(0, 3, GL_FLOAT, false, 0, 0);
+    rebindHeapBuffers();
+  }
+
+  void BasicMesh::rebindHeapBuffers() const {
+    if (heapVertices.isValid()) {
+      auto block = heapVertices.get();
+      if (block.buffer != boundVertices.buffer ||
+          block.offset != boundVertices.offset) {
+        vao.bindVertexBuffer(0, block.buffer->id(), block.offset,
+                             sizeof(glm::vec3));
+        boundVertices = block;
+      }
+    }
+    if (heapIndices.isValid()) {
+      auto block = heapIndices.get();
+      if (block.buffer != boundIndices.buffer) {
+        vao.bindIndexBuffer(block.buffer->id());
+      }
+      boundIndices = block;
+    }
+  }
+
   void BasicMesh::draw() const {
     if (indexCount > 0) {
-      glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, nullptr);
+      // Heap indices start at their block's offset in the bound buffer
+      auto indexOffset = static_cast<uintptr_t>(boundIndices.offset);
+      glDrawElements(GL_TRIANGLES, indexCount, static_cast<GLenum>(indexType),
+                     reinterpret_cast<const void*>(indexOffset));
     } else {
       glDrawArrays(GL_TRIANGLES, 0, vertexCount);
     }
@@ -0,0 +1,413 @@
+#include "engine/mesh/compressed_animation.hpp"
+
+#include "logger.hpp"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/quaternion.hpp>
+#include <limits>
+
+namespace {
+  using engine::mesh::CompressedAnimation;
+  using PackedKey = CompressedAnimation::PackedKey;
+
+  constexpr float SQRT2 = 1.41421356237f;
+  constexpr uint32_t QUAT_COMPONENT_MAX = (1u << 15) - 1;
+  constexpr uint32_t VEC_COMPONENT_MAX = std::numeric_limits<uint16_t>::max();
+
+  /// <summary>
+  /// Longest run of frames a single pair of keys may span. Bounds the cost of
+  /// keyframe reduction, which checks every frame in between.
+  /// </summary>
+  constexpr size_t MAX_KEY_GAP = 64;
+
+  struct Transform {
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+  };
+
+  Transform decompose(const glm::mat4& m) {
+    Transform result{};
+    result.translation = glm::vec3(m[3]);
+
+    glm::mat3 rotation;
+    for (int i = 0; i < 3; ++i) {
+      glm::vec3 axis(m[i]);
+      float length = glm::length(axis);
+      result.scale[i] = length;
+      rotation[i] = length > 0.0f ? axis / length : glm::vec3(0.0f);
+      if (length <= 0.0f) {
+        rotation[i][i] = 1.0f;
+      }
+    }
+
+    // Mirrored transforms keep a proper rotation, with the flip in scale
+    if (glm::determinant(rotation) < 0.0f) {
+      result.scale.x = -result.scale.x;
+      rotation[0] = -rotation[0];
+    }
+
+    result.rotation = glm::normalize(glm::quat_cast(rotation));
+    return result;
+  }
+
+  glm::mat4 compose(const glm::vec3& translation, const glm::quat& rotation,
+                    const glm::vec3& scale) {
+    glm::mat3 r = glm::mat3_cast(rotation);
+    return glm::mat4(glm::vec4(r[0] * scale.x, 0.0f),
+                     glm::vec4(r[1] * scale.y, 0.0f),
+                     glm::vec4(r[2] * scale.z, 0.0f),
+                     glm::vec4(translation, 1.0f));
+  }
+
+  inline glm::quat nlerp(const glm::quat& a, glm::quat b, float t) {
+    if (glm::dot(a, b) < 0.0f) {
+      b = -b;
+    }
+    return glm::normalize(a * (1.0f - t) + b * t);
+  }
+
+  inline glm::vec3 lerp(const glm::vec3& a, const glm::vec3& b, float t) {
+    return a + (b - a) * t;
+  }
+
+  inline float angleBetween(const glm::quat& a, const glm::quat& b) {
+    float d = std::min(std::abs(glm::dot(a, b)), 1.0f);
+    return 2.0f * std::acos(d);
+  }
+
+  inline float maxComponentError(const glm::vec3& a, const glm::vec3& b) {
+    glm::vec3 d = glm::abs(a - b);
+    return std::max(d.x, std::max(d.y, d.z));
+  }
+
+  PackedKey packQuat(glm::quat q) {
+    int largest = 0;
+    for (int i = 1; i < 4; ++i) {
+      if (std::abs(q[i]) > std::abs(q[largest])) {
+        largest = i;
+      }
+    }
+    // q and -q are the same rotation, so the dropped component is always
+    // positive
+    if (q[largest] < 0.0f) {
+      q = -q;
+    }
+
+    uint64_t bits = static_cast<uint64_t>(largest);
+    for (int i = 0; i < 4; ++i) {
+      if (i == largest) {
+        continue;
+      }
+      float normalized = (q[i] * SQRT2 + 1.0f) * 0.5f;
+      auto quantized = static_cast<uint32_t>(std::clamp(
+          std::lround(normalized * QUAT_COMPONENT_MAX), 0l,
+          static_cast<long>(QUAT_COMPONENT_MAX)));
+      bits = (bits << 15) | quantized;
+    }
+
+    return {static_cast<uint16_t>(bits >> 32),
+            static_cast<uint16_t>(bits >> 16), static_cast<uint16_t>(bits)};
+  }
+
+  glm::quat unpackQuat(const PackedKey& key) {
+    uint64_t bits = (static_cast<uint64_t>(key[0]) << 32) |
+                    (static_cast<uint64_t>(key[1]) << 16) | key[2];
+    int largest = static_cast<int>((bits >> 45) & 3);
+
+    glm::quat q;
+    float sum = 0.0f;
+    int shift = 30;
+    for (int i = 0; i < 4; ++i) {
+      if (i == largest) {
+        continue;
+      }
+      auto quantized = static_cast<uint32_t>((bits >> shift) & QUAT_COMPONENT_MAX);
+      shift -= 15;
+      float value =
+          (static_cast<float>(quantized) / QUAT_COMPONENT_MAX * 2.0f - 1.0f) /
+          SQRT2;
+      q[i] = value;
+      sum += value * value;
+    }
+    q[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+    return q;
+  }
+
+  PackedKey packVec3(const glm::vec3& v, const glm::vec3& min,
+                     const glm::vec3& extent) {
+    PackedKey key{};
+    for (int i = 0; i < 3; ++i) {
+      float normalized = extent[i] > 0.0f ? (v[i] - min[i]) / extent[i] : 0.0f;
+      key[i] = static_cast<uint16_t>(std::clamp(
+          std::lround(normalized * VEC_COMPONENT_MAX), 0l,
+          static_cast<long>(VEC_COMPONENT_MAX)));
+    }
+    return key;
+  }
+
+  inline glm::vec3 unpackVec3(const PackedKey& key, const glm::vec3& min,
+                              const glm::vec3& extent) {
+    return min + glm::vec3(key[0], key[1], key[2]) *
+                     (extent / static_cast<float>(VEC_COMPONENT_MAX));
+  }
+
+  /// <summary>
+  /// Picks the frames to keep so that interpolating between them stays within
+  /// tolerance of every dropped frame. Always keeps the first and last frame,
+  /// or only the first for a constant track.
+  /// </summary>
+  template <typename T, typename Interpolate, typename Error>
+  std::vector<uint32_t> reduceKeys(const std::vector<T>& values,
+                                   float tolerance, Interpolate interpolate,
+                                   Error error) {
+    std::vector<uint32_t> keys = {0};
+    size_t count = values.size();
+
+    bool constant = std::all_of(values.begin(), values.end(), [&](const T& v) {
+      return error(v, values[0]) <= tolerance;
+    });
+    if (count < 2 || constant) {
+      return keys;
+    }
+
+    size_t last = 0;
+    for (size_t candidate = 2; candidate < count; ++candidate) {
+      bool fits = candidate - last <= MAX_KEY_GAP;
+      for (size_t f = last + 1; fits && f < candidate; ++f) {
+        float t = static_cast<float>(f - last) /
+                  static_cast<float>(candidate - last);
+        fits = error(interpolate(values[last], values[candidate], t),
+                     values[f]) <= tolerance;
+      }
+
+      if (!fits) {
+        last = candidate - 1;
+        keys.push_back(static_cast<uint32_t>(last));
+      }
+    }
+    keys.push_back(static_cast<uint32_t>(count - 1));
+
+    return keys;
+  }
+
+  struct KeyPosition {
+    uint32_t key;
+    uint32_t next;
+    float t;
+  };
+
+  /// <summary>
+  /// Finds the pair of keys around a frame position. Past the last key the
+  /// clip blends back into its first key.
+  /// </summary>
+  inline KeyPosition findKeys(const CompressedAnimation::Channel& channel,
+                              const CompressedAnimation::Track& track,
+                              float frame, unsigned int frameCount) {
+    if (track.keyCount <= 1) {
+      return {track.firstKey, track.firstKey, 0.0f};
+    }
+
+    const uint16_t* frames = channel.frames.data() + track.firstKey;
+    const uint16_t* end = frames + track.keyCount;
+    auto whole = static_cast<uint16_t>(frame);
+    uint32_t index =
+        static_cast<uint32_t>(std::upper_bound(frames, end, whole) - frames) -
+        1;
+
+    uint32_t nextIndex = index + 1;
+    float nextFrame;
+    if (nextIndex >= track.keyCount) {
+      nextIndex = 0;
+      nextFrame = static_cast<float>(frameCount);
+    } else {
+      nextFrame = frames[nextIndex];
+    }
+
+    float span = nextFrame - frames[index];
+    float t = span > 0.0f ? (frame - frames[index]) / span : 0.0f;
+    return {track.firstKey + index, track.firstKey + nextIndex,
+            std::clamp(t, 0.0f, 1.0f)};
+  }
+
+  template <typename T, typename Pack>
+  void appendTrack(CompressedAnimation::Channel& channel,
+                   const std::vector<T>& values,
+                   const std::vector<uint32_t>& keys, Pack pack,
+                   CompressedAnimation::Track track) {
+    track.firstKey = static_cast<uint32_t>(channel.keys.size());
+    track.keyCount = static_cast<uint32_t>(keys.size());
+    for (uint32_t key : keys) {
+      channel.frames.push_back(static_cast<uint16_t>(key));
+      channel.keys.push_back(pack(values[key], track));
+    }
+    channel.tracks.push_back(track);
+  }
+
+  template <typename T>
+  inline size_t vectorBytes(const std::vector<T>& v) {
+    return v.size() * sizeof(T);
+  }
+} // namespace
+
+namespace engine::mesh {
+  CompressedAnimation
+  CompressedAnimation::compress(const Animation& animation,
+                                const AnimationCompressionSettings& settings) {
+    CompressedAnimation result;
+
+    if (animation.GetFrameCount() == 0 || animation.GetJointCount() == 0) {
+      return result;
+    }
+    if (animation.GetFrameCount() >
+        std::numeric_limits<uint16_t>::max() + 1u) {
+      engine::Logger::error("Animation has {} frames, compressed animations "
+                            "support at most 65536",
+                            animation.GetFrameCount());
+      return result;
+    }
+
+    result.jointCount = animation.GetJointCount();
+    result.frameCount = animation.GetFrameCount();
+    result.frameRate = animation.GetFrameRate();
+
+    for (auto* channel : {&result.rotations, &result.translations,
+                          &result.scales}) {
+      channel->tracks.reserve(result.jointCount);
+    }
+
+    std::vector<glm::quat> rotations(result.frameCount);
+    std::vector<glm::vec3> translations(result.frameCount);
+    std::vector<glm::vec3> scales(result.frameCount);
+
+    for (unsigned int joint = 0; joint < result.jointCount; ++joint) {
+      for (unsigned int frame = 0; frame < result.frameCount; ++frame) {
+        auto transform = decompose(animation.GetJointData(frame)[joint]);
+        translations[frame] = transform.translation;
+        scales[frame] = transform.scale;
+
+        // Keep neighbouring frames in the same hemisphere so interpolation
+        // takes the short way round
+        if (frame > 0 && glm::dot(rotations[frame - 1], transform.rotation) <
+                             0.0f) {
+          transform.rotation = -transform.rotation;
+        }
+        rotations[frame] = transform.rotation;
+      }
+
+      auto rotationKeys = reduceKeys(rotations, settings.rotationTolerance,
+                                     nlerp, angleBetween);
+      appendTrack(
+          result.rotations, rotations, rotationKeys,
+          [](const glm::quat& q, const Track&) { return packQuat(q); },
+          Track{});
+
+      auto vec3Track = [](const std::vector<glm::vec3>& values,
+                          const std::vector<uint32_t>& keys) {
+        Track track{};
+        glm::vec3 min(std::numeric_limits<float>::max());
+        glm::vec3 max(std::numeric_limits<float>::lowest());
+        for (uint32_t key : keys) {
+          min = glm::min(min, values[key]);
+          max = glm::max(max, values[key]);
+        }
+        track.min = min;
+        track.extent = max - min;
+        return track;
+      };
+      auto packTrackVec3 = [](const glm::vec3& v, const Track& track) {
+        return packVec3(v, track.min, track.extent);
+      };
+
+      auto translationKeys =
+          reduceKeys(translations, settings.translationTolerance, lerp,
+                     maxComponentError);
+      appendTrack(result.translations, translations, translationKeys,
+                  packTrackVec3, vec3Track(translations, translationKeys));
+
+      auto scaleKeys = reduceKeys(scales, settings.scaleTolerance, lerp,
+                                  maxComponentError);
+      appendTrack(result.scales, scales, scaleKeys, packTrackVec3,
+                  vec3Track(scales, scaleKeys));
+    }
+
+    size_t bakedSize = static_cast<size_t>(result.frameCount) *
+                       result.jointCount * sizeof(glm::mat4);
+    engine::Logger::info(
+        "Compressed animation: {} joints, {} frames, {} keys, {} KB -> {} KB",
+        result.jointCount, result.frameCount,
+        result.rotations.keys.size() + result.translations.keys.size() +
+            result.scales.keys.size(),
+        bakedSize / 1024, result.memoryUsage() / 1024);
+
+    return result;
+  }
+
+  void CompressedAnimation::sample(float time,
+                                   std::span<glm::mat4> joints) const {
+#ifndef NDEBUG
+    if (joints.size() < jointCount) {
+      engine::Logger::error("Animation sample output has {} joints, needs {}",
+                            joints.size(), jointCount);
+      return;
+    }
+#endif
+    if (frameCount == 0) {
+      return;
+    }
+
+    float frames = static_cast<float>(frameCount);
+    float frame = std::fmod(time * frameRate, frames);
+    if (frame < 0.0f) {
+      frame += frames;
+    }
+
+    for (unsigned int joint = 0; joint < jointCount; ++joint) {
+      const auto& rotationTrack = rotations.tracks[joint];
+      auto r = findKeys(rotations, rotationTrack, frame, frameCount);
+      glm::quat rotation = nlerp(unpackQuat(rotations.keys[r.key]),
+                                 unpackQuat(rotations.keys[r.next]), r.t);
+
+      const auto& translationTrack = translations.tracks[joint];
+      auto t = findKeys(translations, translationTrack, frame, frameCount);
+      glm::vec3 translation = lerp(
+          unpackVec3(translations.keys[t.key], translationTrack.min,
+                     translationTrack.extent),
+          unpackVec3(translations.keys[t.next], translationTrack.min,
+                     translationTrack.extent),
+          t.t);
+
+      const auto& scaleTrack = scales.tracks[joint];
+      auto s = findKeys(scales, scaleTrack, frame, frameCount);
+      glm::vec3 scale = lerp(
+          unpackVec3(scales.keys[s.key], scaleTrack.min, scaleTrack.extent),
+          unpackVec3(scales.keys[s.next], scaleTrack.min, scaleTrack.extent),
+          s.t);
+
+      joints[joint] = compose(translation, rotation, scale);
+    }
+  }
+
+  void CompressedAnimation::samplePalette(
+      float time, std::span<const glm::mat4> inverseBindPose,
+      std::span<glm::mat4> palette) const {
+    if (inverseBindPose.size() < jointCount) {
+      engine::Logger::error("Inverse bind pose has {} joints, needs {}",
+                            inverseBindPose.size(), jointCount);
+      return;
+    }
+    sample(time, palette);
+    for (unsigned int joint = 0; joint < jointCount; ++joint) {
+      palette[joint] = palette[joint] * inverseBindPose[joint];
+    }
+  }
+
+  size_t CompressedAnimation::memoryUsage() const {
+    size_t size = 0;
+    for (const auto* channel : {&rotations, &translations, &scales}) {
+      size += vectorBytes(channel->tracks) + vectorBytes(channel->frames) +
+              vectorBytes(channel->keys);
+    }
+    return size;
+  }
+} // namespace engine::mesh
@@ -0,0 +1,232 @@
+#include "engine/mesh/cpu_skinning.hpp"
+
+#include "engine/cpu_profiler.hpp"
+#include "logger.hpp"
+#include "skinning_kernel.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace engine::mesh::skinning::detail {
+#ifdef ENGINE_SKINNING_AVX2_KERNEL
+  // In cpu_skinning_avx2.cpp
+  void skinRangeAvx2(const WeightedVertex* input, const float* palette,
+                     size_t paletteSize, Vertex* output, size_t count);
+#endif
+} // namespace engine::mesh::skinning::detail
+
+namespace {
+  using engine::mesh::Vertex;
+  using engine::mesh::WeightedVertex;
+
+  /// <summary>
+  /// Vertices per batch handed to a worker (~1MB of input).
+  /// </summary>
+  constexpr size_t SKINNING_BATCH = 1 << 13;
+
+  inline uint32_t jointIndex(int index, size_t paletteSize) {
+    return static_cast<size_t>(index) < paletteSize
+               ? static_cast<uint32_t>(index)
+               : 0u;
+  }
+
+  inline glm::vec3 normalizeSafe(const glm::vec3& d) {
+    float length = glm::length(d);
+    return length > 0.0f ? d / length : d;
+  }
+
+  inline void skinVertexScalar(const WeightedVertex& v,
+                               const glm::mat4* palette, size_t paletteSize,
+                               Vertex& out) {
+    glm::mat4 skin(0.0f);
+    float total = 0.0f;
+    for (int k = 0; k < 4; ++k) {
+      skin += palette[jointIndex(v.jointIndices[k], paletteSize)] *
+              v.jointWeights[k];
+      total += v.jointWeights[k];
+    }
+
+    if (total == 0.0f) {
+      out = Vertex{.position = v.position,
+                   .texCoord = v.texCoord,
+                   .normal = v.normal,
+                   .tangent = v.tangent};
+      return;
+    }
+
+    glm::mat3 rotation(skin);
+    out = Vertex{
+        .position = glm::vec3(skin * glm::vec4(v.position, 1.0f)),
+        .texCoord = v.texCoord,
+        .normal = normalizeSafe(rotation * v.normal),
+        .tangent = glm::vec4(normalizeSafe(rotation * glm::vec3(v.tangent)),
+                             v.tangent.w),
+    };
+  }
+
+  /// <summary>
+  /// Whether the CPU and OS support AVX2 and FMA.
+  /// </summary>
+  bool cpuSupportsAvx2() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) {
+      return false;
+    }
+    __cpuid(info, 1);
+    bool fma = (info[2] & (1 << 12)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    // The OS must save the YMM registers on context switches
+    if (!fma || !osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+      return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+  }
+
+  /// <summary>
+  /// Skins a range with the best kernel the CPU supports.
+  /// </summary>
+  void skinRange(const WeightedVertex* input, const glm::mat4* palette,
+                 size_t paletteSize, Vertex* output, size_t count) {
+#ifdef ENGINE_SKINNING_SSE2
+    const float* matrices = reinterpret_cast<const float*>(palette);
+#ifdef ENGINE_SKINNING_AVX2_KERNEL
+    static const bool avx2 = cpuSupportsAvx2();
+    if (avx2) {
+      engine::mesh::skinning::detail::skinRangeAvx2(input, matrices,
+                                                    paletteSize, output, count);
+      return;
+    }
+#endif
+    engine::mesh::skinning::skinRangeSimd(input, matrices, paletteSize, output,
+                                          count);
+#else
+    for (size_t i = 0; i < count; ++i) {
+      skinVertexScalar(input[i], palette, paletteSize, output[i]);
+    }
+#endif
+  }
+} // namespace
+
+namespace engine::mesh::skinning {
+  void skinVertices(std::span<const WeightedVertex> input,
+                    std::span<const glm::mat4> palette,
+                    std::span<Vertex> output, ThreadPool& pool) {
+    ENGINE_PROFILE_ZONE("CPU skinning");
+    if (output.size() < input.size()) {
+      engine::Logger::error("Skinning output has {} vertices, needs {}",
+                            output.size(), input.size());
+      return;
+    }
+    if (palette.empty()) {
+      engine::Logger::warn("Skinning with an empty palette");
+      return;
+    }
+
+    pool.parallelFor(input.size(), SKINNING_BATCH,
+                     [&](size_t begin, size_t end) {
+                       skinRange(input.data() + begin, palette.data(),
+                                 palette.size(), output.data() + begin,
+                                 end - begin);
+                     });
+  }
+
+  void skinVerticesReference(std::span<const WeightedVertex> input,
+                             std::span<const glm::mat4> palette,
+                             std::span<Vertex> output) {
+    for (size_t i = 0; i < input.size() && i < output.size(); ++i) {
+      skinVertexScalar(input[i], palette.data(), palette.size(), output[i]);
+    }
+  }
+
+  BenchmarkResult benchmark(size_t vertexCount, uint32_t jointCount,
+                            uint32_t iterations, ThreadPool& pool) {
+    BenchmarkResult result{};
+    if (vertexCount == 0 || jointCount == 0 || iterations == 0) {
+      return result;
+    }
+
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::uniform_int_distribution<int> joint(0, static_cast<int>(jointCount) -
+                                                    1);
+
+    std::vector<glm::mat4> palette(jointCount);
+    for (auto& m : palette) {
+      for (int c = 0; c < 3; ++c) {
+        m[c] = glm::vec4(unit(rng), unit(rng), unit(rng), 0.0f);
+      }
+      m[3] = glm::vec4(unit(rng), unit(rng), unit(rng), 1.0f);
+    }
+
+    std::vector<WeightedVertex> input(vertexCount);
+    for (auto& v : input) {
+      v.position = glm::vec3(unit(rng), unit(rng), unit(rng));
+      v.texCoord = glm::vec2(unit(rng), unit(rng));
+      v.normal = glm::normalize(glm::vec3(unit(rng), unit(rng), 1.5f));
+      v.tangent = glm::vec4(glm::normalize(glm::vec3(1.5f, unit(rng),
+                                                     unit(rng))),
+                            1.0f);
+      glm::vec4 weights(std::abs(unit(rng)), std::abs(unit(rng)),
+                        std::abs(unit(rng)), std::abs(unit(rng)));
+      v.jointWeights =
+          weights / (weights.x + weights.y + weights.z + weights.w);
+      v.jointIndices =
+          glm::ivec4(joint(rng), joint(rng), joint(rng), joint(rng));
+    }
+
+    std::vector<Vertex> output(vertexCount);
+    std::vector<Vertex> reference(vertexCount);
+
+    using Clock = std::chrono::steady_clock;
+
+    auto start = Clock::now();
+    skinVerticesReference(input, palette, reference);
+    double referenceSeconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    // Warm up the pool and caches before timing
+    skinVertices(input, palette, output, pool);
+
+    start = Clock::now();
+    for (uint32_t i = 0; i < iterations; ++i) {
+      skinVertices(input, palette, output, pool);
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    result.vertices = vertexCount * iterations;
+    result.verticesPerSecond =
+        static_cast<double>(result.vertices) / result.seconds;
+    result.referenceVerticesPerSecond =
+        static_cast<double>(vertexCount) / referenceSeconds;
+
+    for (size_t i = 0; i < vertexCount; ++i) {
+      const float* a = &output[i].position.x;
+      const float* b = &reference[i].position.x;
+      for (size_t c = 0; c < sizeof(Vertex) / sizeof(float); ++c) {
+        result.maxError = std::max(result.maxError, std::abs(a[c] - b[c]));
+      }
+    }
+
+    engine::Logger::info(
+        "CPU skinning: {:.1f}M vertices/s on {} threads ({:.1f}M vertices/s "
+        "reference), max error {}",
+        result.verticesPerSecond / 1e6, pool.threadCount() + 1,
+        result.referenceVerticesPerSecond / 1e6, result.maxError);
+
+    return result;
+  }
+} // namespace engine::mesh::skinning
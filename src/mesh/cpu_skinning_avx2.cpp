@@ -0,0 +1,14 @@
+// Built with AVX2 and FMA enabled (see src/CMakeLists.txt). Only called
+// once cpu_skinning.cpp has checked the CPU supports them.
+#include "skinning_kernel.hpp"
+
+namespace engine::mesh::skinning::detail {
+  void skinRangeAvx2(const WeightedVertex* input, const float* palette,
+                     size_t paletteSize, Vertex* output, size_t count) {
+#ifdef ENGINE_SKINNING_AVX2
+    skinRangeSimd(input, palette, paletteSize, output, count);
+#else
+#error "cpu_skinning_avx2.cpp must be compiled with AVX2 and FMA enabled"
+#endif
+  }
+} // namespace engine::mesh::skinning::detail
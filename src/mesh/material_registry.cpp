@@ -0,0 +1,292 @@
+#include "engine/mesh/material_registry.hpp"
+
+#include "logger.hpp"
+
+namespace engine::mesh {
+  MaterialRegistry::MaterialRegistry(uint32_t capacity)
+      : maxMaterials(capacity),
+        buffer({static_cast<GLuint>(capacity * sizeof(GpuMaterial)), nullptr,
+                gl::Buffer::Usage::WRITE | gl::Buffer::Usage::PERSISTENT |
+                    gl::Buffer::Usage::COHERENT}) {
+    mapping = buffer.map(gl::Buffer::Mapping::COHERENT |
+                         gl::Buffer::Mapping::PERSISTENT |
+                         gl::Buffer::Mapping::WRITE);
+    buffer.label("Material Table");
+    materials.reserve(capacity);
+  }
+
+  std::string MaterialRegistry::makeKey(const MaterialEntry& entry,
+                                       const std::string& basePath) {
+    // Entries are a sorted map, so equal materials build equal keys
+    std::string key = basePath;
+    for (const auto& [channel, file] : entry.entries) {
+      key += '\n';
+      key += channel;
+      key += ':';
+      key += file;
+    }
+    return key;
+  }
+
+  std::expected<MaterialIndex, std::string>
+  MaterialRegistry::load(const MaterialEntry& entry,
+                         const std::string& basePath) {
+    std::string key = makeKey(entry, basePath);
+    if (auto it = loaded.find(key); it != loaded.end()) {
+      return it->second;
+    }
+
+    auto decoded = entry.DecodeTextures(basePath);
+    if (!decoded) {
+      return std::unexpected(decoded.error());
+    }
+
+    auto index = add(std::move(*decoded));
+    if (index) {
+      loaded.emplace(std::move(key), *index);
+    }
+    return index;
+  }
+
+  std::vector<std::expected<MaterialIndex, std::string>>
+  MaterialRegistry::loadAll(std::span<const MaterialEntry> entries,
+                            const std::string& basePath,
+                            engine::ThreadPool& pool) {
+    std::vector<std::expected<MaterialIndex, std::string>> results(
+        entries.size());
+
+    // Decode each material not loaded yet once, duplicates reuse it
+    std::vector<std::string> keys(entries.size());
+    std::vector<size_t> firstOf(entries.size());
+    std::vector<size_t> toDecode;
+    std::unordered_map<std::string_view, size_t> pending;
+    for (size_t i = 0; i < entries.size(); ++i) {
+      firstOf[i] = i;
+      keys[i] = makeKey(entries[i], basePath);
+      if (auto it = loaded.find(keys[i]); it != loaded.end()) {
+        results[i] = it->second;
+        continue;
+      }
+      auto [it, inserted] = pending.try_emplace(keys[i], i);
+      firstOf[i] = it->second;
+      if (inserted) {
+        toDecode.push_back(i);
+      }
+    }
+
+    std::vector<std::expected<DecodedTextureSet, std::string>> decoded;
+    decoded.reserve(toDecode.size());
+    for (size_t i = 0; i < toDecode.size(); ++i) {
+      decoded.emplace_back(std::unexpect);
+    }
+    pool.parallelFor(toDecode.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        decoded[i] = entries[toDecode[i]].DecodeTextures(basePath, pool);
+      }
+    });
+
+    // Uploads must stay on the GL thread, in order
+    for (size_t i = 0; i < toDecode.size(); ++i) {
+      size_t entry = toDecode[i];
+      if (!decoded[i]) {
+        results[entry] = std::unexpected(decoded[i].error());
+        continue;
+      }
+      results[entry] = add(std::move(*decoded[i]));
+      if (results[entry]) {
+        loaded.emplace(keys[entry], *results[entry]);
+      }
+    }
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (firstOf[i] != i) {
+        results[i] = results[firstOf[i]];
+      }
+    }
+    return results;
+  }
+
+  std::optional<MaterialIndex>
+  MaterialRegistry::addToAtlas(DecodedTextureSet& decoded) {
+    std::array<const engine::Image*, engine::texture::TextureAtlas::CHANNELS>
+        images{};
+    for (size_t i = 0; i < images.size(); ++i) {
+      auto& channel = decoded.channels[i];
+      if (!channel) {
+        continue;
+      }
+      images[i] = std::get_if<engine::Image>(&*channel);
+      if (!images[i] || !atlas->accepts(images[i]->getDimensions())) {
+        return std::nullopt;
+      }
+    }
+
+    auto region = atlas->add(images);
+    if (!region) {
+      return std::nullopt;
+    }
+
+    auto index = static_cast<MaterialIndex>(materials.size());
+    auto& material = materials.emplace_back();
+    material.textures.images.diffuse = gl::Texture::uninitialized();
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (images[i]) {
+        material.textures.handles.*HANDLE_SLOTS[i] = atlas->getHandle(i);
+      }
+    }
+    material.atlasRegion = region;
+    // The atlas keeps its arrays resident
+    material.resident = true;
+    writeEntry(index);
+    return index;
+  }
+
+  std::expected<MaterialIndex, std::string>
+  MaterialRegistry::add(DecodedTextureSet&& decoded) {
+    if (atlas && decoded.channels[0] && materials.size() < maxMaterials) {
+      if (auto index = addToAtlas(decoded)) {
+        return *index;
+      }
+    }
+
+    if (!streamer) {
+      auto textures = MaterialEntry::UploadTextures(std::move(decoded), uploadRing);
+      if (!textures) {
+        return std::unexpected(textures.error());
+      }
+      return add(std::move(*textures));
+    }
+
+    using engine::texture::CompressedImage;
+    auto& channels = decoded.channels;
+    if (materials.size() >= maxMaterials) {
+      return std::unexpected("Material table is full (" +
+                             std::to_string(maxMaterials) + " materials)");
+    }
+    if (!channels[0]) {
+      return std::unexpected("No diffuse texture specified in material");
+    }
+
+    // Prebuilt mips are streamed, anything else is uploaded whole
+    auto streams = [&](size_t i) {
+      return channels[i] &&
+             std::holds_alternative<CompressedImage>(*channels[i]);
+    };
+    std::array<std::optional<gl::Texture>, 3> textures;
+    for (size_t i = 0; i < channels.size(); ++i) {
+      if (channels[i] && !streams(i)) {
+        textures[i] = MaterialEntry::UploadTexture(i, *channels[i], uploadRing);
+      }
+    }
+
+    auto index = static_cast<MaterialIndex>(materials.size());
+    auto& material = materials.emplace_back();
+    auto& set = material.textures;
+    set.images.diffuse = textures[0] ? std::move(*textures[0])
+                                     : gl::Texture::uninitialized();
+    set.images.bump = std::move(textures[1]);
+    set.images.material = std::move(textures[2]);
+    set.handles.diffuse = textures[0] ? set.images.diffuse.rawHandle() : 0;
+    set.handles.bump = set.images.bump ? set.images.bump->rawHandle() : 0;
+    set.handles.material =
+        set.images.material ? set.images.material->rawHandle() : 0;
+    writeEntry(index);
+    setResident(index, true);
+
+    for (size_t i = 0; i < channels.size(); ++i) {
+      if (!streams(i)) {
+        continue;
+      }
+      // The streamer calls back with the initial handle straight away
+      HandleSlot slot = HANDLE_SLOTS[i];
+      material.streamed[i] = streamer->add(
+          std::get<CompressedImage>(std::move(*channels[i])),
+          [this, index, slot](gl::RawTextureHandle handle) {
+            materials[index].textures.handles.*slot = handle;
+            writeEntry(index);
+          });
+    }
+    return index;
+  }
+
+  std::expected<MaterialIndex, std::string>
+  MaterialRegistry::add(TextureSet&& textureSet) {
+    if (materials.size() >= maxMaterials) {
+      return std::unexpected("Material table is full (" +
+                             std::to_string(maxMaterials) + " materials)");
+    }
+
+    auto index = static_cast<MaterialIndex>(materials.size());
+    materials.push_back({.textures = std::move(textureSet)});
+    writeEntry(index);
+    setResident(index, true);
+    return index;
+  }
+
+  void MaterialRegistry::setResident(MaterialIndex index, bool resident) {
+#ifndef NDEBUG
+    if (index >= materials.size()) {
+      engine::Logger::error("Material index {} out of range ({} materials)",
+                            index, materials.size());
+      return;
+    }
+#endif
+    auto& material = materials[index];
+    if (material.resident == resident || material.atlasRegion) {
+      return;
+    }
+
+    const auto& handles = material.textures.handles;
+    for (size_t i = 0; i < HANDLE_SLOTS.size(); ++i) {
+      if (material.streamed[i]) {
+        continue;
+      }
+      gl::TextureHandle handle(handles.*HANDLE_SLOTS[i]);
+      if (!handle.isValid()) {
+        continue;
+      }
+      if (resident) {
+        handle.use();
+      } else {
+        handle.unuse();
+      }
+    }
+    material.resident = resident;
+  }
+
+  void MaterialRegistry::reportUsage(MaterialIndex index, float screenSize) {
+#ifndef NDEBUG
+    if (index >= materials.size()) {
+      engine::Logger::error("Material index {} out of range ({} materials)",
+                            index, materials.size());
+      return;
+    }
+#endif
+    if (!streamer) {
+      return;
+    }
+    for (const auto& id : materials[index].streamed) {
+      if (id) {
+        streamer->request(*id, screenSize);
+      }
+    }
+  }
+
+  void MaterialRegistry::writeEntry(MaterialIndex index) {
+    const auto& material = materials[index];
+    const auto& handles = material.textures.handles;
+    GpuMaterial gpuMaterial{
+        .diffuse = handles.diffuse,
+        .bump = handles.bump,
+        .material = handles.material,
+    };
+    if (const auto& region = material.atlasRegion) {
+      gpuMaterial.layer = region->layer;
+      gpuMaterial.flags = FLAG_ATLAS;
+      gpuMaterial.uvScale = region->uvScale;
+      gpuMaterial.uvOffset = region->uvOffset;
+    }
+    mapping.write(&gpuMaterial, sizeof(GpuMaterial),
+                  static_cast<GLuint>(index * sizeof(GpuMaterial)));
+  }
+} // namespace engine::mesh
@@ -1,52 +1,225 @@
 #include "engine/mesh/mesh.hpp"
 #include "engine/mesh/mesh_data.hpp"
+#include "engine/thread_pool.hpp"
 #include "logger.hpp"
+#include <algorithm>
 #include <gl/structs.hpp>
+#include <span>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_MESH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  using engine::mesh::WeightedVertex;
+
+  /// <summary>
+  /// Largest vertex span (max - min index) stored with 16 bit indices.
+  /// </summary>
+  constexpr uint32_t MAX_U16_SPAN = 0xffff;
+
+  inline GLuint alignUp(GLuint value, GLuint alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+
+  /// <summary>
+  /// Clamps a sub mesh to the index data, so malformed files can't read out
+  /// of bounds.
+  /// </summary>
+  inline std::span<const uint32_t>
+  layerSpan(const std::vector<uint32_t>& indices,
+            const engine::mesh::SubMesh& layer) {
+    size_t start = std::min<size_t>(std::max(layer.start, 0), indices.size());
+    size_t count =
+        std::min<size_t>(std::max(layer.count, 0), indices.size() - start);
+    return std::span<const uint32_t>(indices.data() + start, count);
+  }
+
+  /// <summary>
+  /// Meshes with at least this many vertices are interleaved across the
+  /// thread pool.
+  /// </summary>
+  constexpr size_t PARALLEL_INTERLEAVE_THRESHOLD = 1 << 16;
+  /// <summary>
+  /// Vertices per batch when interleaving in parallel (~1.5MB of output).
+  /// </summary>
+  constexpr size_t PARALLEL_INTERLEAVE_BATCH = 1 << 14;
+
+  // Padded to 16 bytes so the SIMD loads below can read them whole.
+  alignas(16) const glm::vec4 DEFAULT_TEX_COORD(0.0f);
+  alignas(16) const glm::vec4 DEFAULT_NORMAL(0.0f, 0.0f, 1.0f, 0.0f);
+  alignas(16) const glm::vec4 DEFAULT_TANGENT(1.0f, 0.0f, 0.0f, 1.0f);
+  alignas(16) const glm::vec4 DEFAULT_WEIGHTS(0.0f);
+  alignas(16) const glm::ivec4 DEFAULT_JOINT_INDICES(0);
+
+  /// <summary>
+  /// One SoA attribute stream. A stride of 0 repeats the first element, which
+  /// is used for attributes the mesh does not have.
+  /// </summary>
+  struct VertexStream {
+    const void* data;
+    size_t stride;
+
+    template <typename U> inline const U* at(size_t i) const {
+      return reinterpret_cast<const U*>(data) + i * stride;
+    }
+  };
+
+  struct VertexStreams {
+    VertexStream positions;
+    VertexStream texCoords;
+    VertexStream normals;
+    VertexStream tangents;
+    VertexStream weights;
+    VertexStream jointIndices;
+  };
+
+#ifdef ENGINE_MESH_SSE2
+  /// <summary>
+  /// Loads a vec3 into (x, y, z, 0) without reading past its end.
+  /// </summary>
+  inline __m128 loadVec3(const float* v) {
+    __m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(v)));
+    return _mm_movelh_ps(xy, _mm_load_ss(v + 2));
+  }
+
+  /// <summary>
+  /// Loads a vec2 into (x, y, 0, 0).
+  /// </summary>
+  inline __m128 loadVec2(const float* v) {
+    return _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(v)));
+  }
+#endif
+
+  /// <summary>
+  /// Interleaves vertices [begin, end) from the SoA streams into dst.
+  /// dst points at vertex 0 of the mesh, not at begin.
+  /// </summary>
+  void interleaveVertices(const VertexStreams& s, size_t begin, size_t end,
+                          WeightedVertex* dst) {
+#ifdef ENGINE_MESH_SSE2
+    // Mapped buffers are usually write-combined, so whole-line streaming
+    // stores avoid reading the destination back.
+    bool aligned = (reinterpret_cast<uintptr_t>(dst) & 15) == 0;
+
+    for (size_t i = begin; i < end; ++i) {
+      __m128 position = loadVec3(s.positions.at<float>(i * 3));
+      __m128 texCoord = loadVec2(s.texCoords.at<float>(i * 2));
+      __m128 normal = loadVec3(s.normals.at<float>(i * 3));
+      __m128 tangent = _mm_loadu_ps(s.tangents.at<float>(i * 4));
+      __m128 weights = _mm_loadu_ps(s.weights.at<float>(i * 4));
+      __m128i joints = _mm_loadu_si128(
+          reinterpret_cast<const __m128i*>(s.jointIndices.at<int>(i * 4)));
+
+      auto* out = reinterpret_cast<float*>(dst + i);
+      if (aligned) {
+        _mm_stream_ps(out + 0, position);
+        _mm_stream_ps(out + 4, texCoord);
+        _mm_stream_ps(out + 8, normal);
+        _mm_stream_ps(out + 12, tangent);
+        _mm_stream_ps(out + 16, weights);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(out + 20), joints);
+      } else {
+        _mm_storeu_ps(out + 0, position);
+        _mm_storeu_ps(out + 4, texCoord);
+        _mm_storeu_ps(out + 8, normal);
+        _mm_storeu_ps(out + 12, tangent);
+        _mm_storeu_ps(out + 16, weights);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 20), joints);
+      }
+    }
+
+    if (aligned) {
+      _mm_sfence();
+    }
+#else
+    for (size_t i = begin; i < end; ++i) {
+      dst[i] = WeightedVertex{
+          .position = *s.positions.at<glm::vec3>(i),
+          .texCoord = *s.texCoords.at<glm::vec2>(i),
+          .normal = *s.normals.at<glm::vec3>(i),
+          .tangent = *s.tangents.at<glm::vec4>(i),
+          .jointWeights = *s.weights.at<glm::vec4>(i),
+          .jointIndices = *s.jointIndices.at<glm::ivec4>(i),
+      };
+    }
+#endif
+  }
+} // namespace
 
 namespace engine::mesh {
-  Mesh::Mesh(const mesh::Data& meshData, std::vector<TextureSet>&& textureSets)
+  Mesh::Mesh(const mesh::Data& meshData,
+             std::vector<MaterialIndex>&& materials)
       : meshLayers(meshData.meshLayers()), layerNames(meshData.layerNames()),
-        textureSets(std::move(textureSets)) {
+        materials(std::move(materials)),
+        meshlets(Meshlets::build(meshData)) {
 #ifndef NDEBUG
-    if (this->textureSets.size() != this->layerNames.size()) {
+    if (this->materials.size() != this->layerNames.size()) {
       engine::Logger::critical(
-          "Mesh created with differing number of texture sets and layer "
-          "names!");
+          "Mesh created with differing number of materials and layer names!");
       abort();
     }
 #endif
+
+    const auto& indices = meshData.indices();
+    layerIndices.reserve(meshLayers.size());
+    for (const auto& layer : meshLayers) {
+      auto span = layerSpan(indices, layer);
+      LayerIndices info{.count = static_cast<GLuint>(span.size())};
+      if (!span.empty()) {
+        auto [min, max] = std::minmax_element(span.begin(), span.end());
+        info.vertexBias = *min;
+        info.type = *max - *min <= MAX_U16_SPAN ? gl::IndexType::U16
+                                                 : gl::IndexType::U32;
+      }
+      layerIndices.push_back(info);
+    }
   }
 
-  GLuint Mesh::writeBatchedDraws(gl::MappingRef& mapping, GLuint baseVertex,
-                                 GLuint instances, GLuint baseInstance) const {
-    std::vector<gl::DrawElementsIndirectCommand> draws(meshLayers.size());
-    for (size_t i = 0; i < meshLayers.size(); ++i) {
-      const auto& layer = meshLayers[i];
-      draws[i].count = layer.count;
-      draws[i].instanceCount = instances;
-      draws[i].firstIndex = layer.start + indexOffset;
-      draws[i].baseVertex = baseVertex;
-      draws[i].baseInstance = baseInstance;
+  GLuint Mesh::writeBatchedDraws(gl::MappingRef& mapping,
+                                 gl::MappingRef& materialMapping,
+                                 GLuint baseVertex, GLuint instances,
+                                 GLuint baseInstance,
+                                 gl::IndexType indexType) const {
+    auto count = GetSubMeshCount(indexType);
+    // Check both fit first, so a failure leaves neither mapping advanced
+    if (mapping.getSize() < count * sizeof(gl::DrawElementsIndirectCommand) ||
+        materialMapping.getSize() < count * sizeof(MaterialIndex)) {
+      engine::Logger::error("Batched draws of {} sub meshes do not fit the "
+                            "draw buffers",
+                            count);
+      return 0;
     }
-    auto size = static_cast<GLuint>(draws.size() *
-                                    sizeof(gl::DrawElementsIndirectCommand));
-    mapping.write(draws.data(), size, 0);
-    mapping += size;
+    auto draws = mapping.reserve<gl::DrawElementsIndirectCommand>(count);
+    auto drawMaterials = materialMapping.reserve<MaterialIndex>(count);
 
-    return static_cast<GLuint>(draws.size());
-  }
+    size_t written = 0;
+    for (size_t i = 0; i < meshLayers.size(); ++i) {
+      const auto& indices = layerIndices[i];
+      if (indices.type != indexType) {
+        continue;
+      }
 
-  void Mesh::writeTextureSets(gl::MappingRef& mapping) const {
-    std::vector<engine::mesh::TextureHandleSet> textureHandles;
-    textureHandles.reserve(textureSets.size());
-    for (const auto& textureSet : textureSets) {
-      textureHandles.push_back(textureSet.handles);
+      draws[written] = {
+          .count = indices.count,
+          .instanceCount = instances,
+          .firstIndex = indices.firstIndex,
+          .baseVertex = baseVertex + indices.vertexBias,
+          .baseInstance = baseInstance,
+      };
+      drawMaterials[written] = materials[i];
+      ++written;
     }
 
-    auto textureSize =
-        static_cast<GLuint>(textureHandles.size() * sizeof(TextureHandleSet));
-    mapping.write(textureHandles.data(), textureSize, 0);
-    mapping += textureSize;
+    return count;
+  }
+
+  GLuint Mesh::GetSubMeshCount(gl::IndexType indexType) const {
+    return static_cast<GLuint>(
+        std::count_if(layerIndices.begin(), layerIndices.end(),
+                      [=](const auto& l) { return l.type == indexType; }));
   }
 
   void Mesh::writeVertexData(const mesh::Data& meshData,
@@ -62,8 +235,6 @@ namespace engine::mesh {
     auto& weights = meshData.weights();
     auto& weightIndices = meshData.weightIndices();
 
-    auto& indices = meshData.indices();
-
     auto vertexNum = vertices.size();
 
 #ifndef NDEBUG
@@ -87,36 +258,47 @@ namespace engine::mesh {
       engine::Logger::warn(
           "Mesh data: weightIndices size greater than vertices size!");
     }
+
+    if (!stagingMapping.isValid()) {
+      engine::Logger::error("Mesh data: vertex staging mapping is not mapped!");
+      return;
+    }
+    if (vertexNum * sizeof(WeightedVertex) > stagingMapping.getSize()) {
+      engine::Logger::error(
+          "Mesh data: vertex data does not fit in the staging mapping!");
+      return;
+    }
 #endif
 
-#define AC(FIELD) !FIELD.empty()
-
-    {
-      GLuint written = 0;
-      GLuint vStart = 0;
-      for (size_t i = 0; i < vertices.size(); ++i) {
-        auto offset = vStart;
-
-        WeightedVertex vertex{
-            .position = vertices[i],
-            .texCoord = AC(textureCoords) ? textureCoords[i] : glm::vec2(0.0f),
-            .normal = AC(normals) ? normals[i] : glm::vec3(0.0f, 0.0f, 1.0f),
-            .tangent =
-                AC(tangents) ? tangents[i] : glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),
-            .jointWeights = AC(weights) ? weights[i] : glm::vec4(0.0f),
-            .jointIndices =
-                AC(weightIndices) ? weightIndices[i] : glm::ivec4(0),
-        };
-
-        stagingMapping.write(&vertex, sizeof(WeightedVertex), offset);
-
-        vStart += sizeof(WeightedVertex);
-        ++written;
-      }
-#undef AC
+    // A stream that is shorter than the vertex stream is treated as missing,
+    // the same as the per-vertex path used to.
+    auto stream = [&](const auto& values, const auto& fallback) {
+      return values.size() >= vertexNum ? VertexStream{values.data(), 1}
+                                        : VertexStream{&fallback, 0};
+    };
 
-      vertexStartIndex += written;
+    const VertexStreams streams{
+        .positions = {vertices.data(), 1},
+        .texCoords = stream(textureCoords, DEFAULT_TEX_COORD),
+        .normals = stream(normals, DEFAULT_NORMAL),
+        .tangents = stream(tangents, DEFAULT_TANGENT),
+        .weights = stream(weights, DEFAULT_WEIGHTS),
+        .jointIndices = stream(weightIndices, DEFAULT_JOINT_INDICES),
+    };
+
+    auto* dst = reinterpret_cast<WeightedVertex*>(stagingMapping.get());
+
+    if (vertexNum >= PARALLEL_INTERLEAVE_THRESHOLD) {
+      engine::ThreadPool::global().parallelFor(
+          vertexNum, PARALLEL_INTERLEAVE_BATCH,
+          [&](size_t begin, size_t end) {
+            interleaveVertices(streams, begin, end, dst);
+          });
+    } else {
+      interleaveVertices(streams, 0, vertexNum, dst);
     }
+
+    vertexStartIndex += static_cast<GLuint>(vertexNum);
   }
 
   void Mesh::writeIndexData(const engine::mesh::Data& meshData,
@@ -130,12 +312,50 @@ namespace engine::mesh {
     }
 #endif
 
-    this->indexOffset = indexOffset / sizeof(uint32_t);
+    const auto& indices = meshData.indices();
+    GLuint start = indexOffset;
+    GLuint offset = indexOffset;
+
+    for (size_t i = 0; i < meshLayers.size(); ++i) {
+      auto span = layerSpan(indices, meshLayers[i]);
+      auto& info = layerIndices[i];
+      auto typeSize = gl::indexTypeSize(info.type);
+
+      offset = alignUp(offset, typeSize);
+      info.firstIndex = offset / typeSize;
 
-    auto& indices = meshData.indices();
-    auto size = static_cast<GLuint>(indices.size() * sizeof(uint32_t));
-    stagingMapping.write(indices.data(), size, 0);
-    indexOffset += size;
+      // Rebased straight into the staging memory
+      auto layerMapping = stagingMapping + (offset - start);
+      if (info.type == gl::IndexType::U16) {
+        auto out = layerMapping.reserve<uint16_t>(span.size());
+        if (out.size() == span.size()) {
+          std::transform(span.begin(), span.end(), out.begin(),
+                         [bias = info.vertexBias](uint32_t index) {
+                           return static_cast<uint16_t>(index - bias);
+                         });
+        }
+      } else {
+        auto out = layerMapping.reserve<uint32_t>(span.size());
+        if (out.size() == span.size()) {
+          std::transform(
+              span.begin(), span.end(), out.begin(),
+              [bias = info.vertexBias](uint32_t index) { return index - bias; });
+        }
+      }
+      offset += static_cast<GLuint>(span.size() * typeSize);
+    }
+
+    indexOffset = alignUp(offset, sizeof(uint32_t));
+  }
+
+  GLuint Mesh::getIndexDataSize() const {
+    GLuint size = 0;
+    for (const auto& info : layerIndices) {
+      auto typeSize = gl::indexTypeSize(info.type);
+      size = alignUp(size, typeSize);
+      size += info.count * typeSize;
+    }
+    return alignUp(size, sizeof(uint32_t));
   }
 
   void Mesh::writeJointData(const mesh::Data& meshData,
@@ -152,18 +372,23 @@ namespace engine::mesh {
 
     auto& invBindPose = meshData.inverseBindPose();
     auto jointCount = animation.GetJointCount();
+    if (invBindPose.size() < static_cast<size_t>(jointCount)) {
+      engine::Logger::error("Mesh data: animation has more joints than the "
+                            "inverse bind pose, not writing joint data!");
+      return;
+    }
 
-    std::vector<glm::mat4> jointMatrices(jointCount);
-
+    auto frameMapping = stagingMapping;
     for (int frame = 0; frame < animation.GetFrameCount(); ++frame) {
       auto joints = animation.GetJointData(frame);
+      auto jointMatrices = frameMapping.reserve<glm::mat4>(jointCount);
+      if (jointMatrices.size() != jointCount) {
+        break;
+      }
 
       for (size_t j = 0; j < jointCount; ++j) {
         jointMatrices[j] = joints[j] * invBindPose[j];
       }
-      auto offset = frame * jointCount * sizeof(glm::mat4);
-      stagingMapping.write(jointMatrices.data(),
-                           jointMatrices.size() * sizeof(glm::mat4), offset);
     }
 
     this->startJointIndex = startJointIndex;
@@ -172,6 +397,33 @@ namespace engine::mesh {
     this->oneOverFrameRate = 1.0f / animation.GetFrameRate();
   }
 
+  void Mesh::setAnimation(
+      const mesh::Data& meshData,
+      std::shared_ptr<const CompressedAnimation> animation) {
+    if (animation &&
+        meshData.inverseBindPose().size() < animation->GetJointCount()) {
+      engine::Logger::error("Mesh data: animation has more joints than the "
+                            "inverse bind pose, not animating!");
+      animation = nullptr;
+    }
+
+    this->animation = std::move(animation);
+    if (!this->animation) {
+      return;
+    }
+
+    inverseBindPose = meshData.inverseBindPose();
+    frameCount = this->animation->GetFrameCount();
+    jointCount = this->animation->GetJointCount();
+    oneOverFrameRate = 1.0f / this->animation->GetFrameRate();
+  }
+
+  void Mesh::samplePalette(float time, std::span<glm::mat4> palette) const {
+    if (animation) {
+      animation->samplePalette(time, inverseBindPose, palette);
+    }
+  }
+
   bool Mesh::GetSubMesh(int i, const mesh::SubMesh* s) const {
     if (i < 0 || i >= (int)meshLayers.size()) {
       return false;
@@ -1,7 +1,10 @@
 #include "engine/mesh/mesh_data.hpp"
 
 #include "../logger.hpp"
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <unordered_map>
 // #include <tinygltf/tiny_gltf.h>
 
 namespace {
@@ -140,11 +143,43 @@ namespace {
       names.emplace_back(meshName);
     }
   }
+
+  template <typename T>
+  inline bool hasStream(const std::vector<T>& stream, size_t vertexCount) {
+    return stream.size() >= vertexCount;
+  }
+
+  /// <summary>
+  /// FNV-1a over the raw bytes of a vertex attribute. Welding is exact, so
+  /// hashing bytes rather than values is fine.
+  /// </summary>
+  template <typename T>
+  inline void hashAttribute(size_t& hash, const std::vector<T>& stream,
+                            size_t vertexCount, uint32_t vertex) {
+    if (!hasStream(stream, vertexCount)) {
+      return;
+    }
+    const auto* bytes = reinterpret_cast<const unsigned char*>(&stream[vertex]);
+    for (size_t i = 0; i < sizeof(T); ++i) {
+      hash ^= bytes[i];
+      hash *= 1099511628211ull;
+    }
+  }
+
+  template <typename T>
+  inline bool attributeEqual(const std::vector<T>& stream, size_t vertexCount,
+                             uint32_t a, uint32_t b) {
+    if (!hasStream(stream, vertexCount)) {
+      return true;
+    }
+    return std::memcmp(&stream[a], &stream[b], sizeof(T)) == 0;
+  }
 } // namespace
 
 namespace engine::mesh {
   std::expected<Data, std::string>
-  Data::fromFile(const std::string_view& name) {
+  Data::fromFile(const std::string_view& name,
+                 const std::optional<OptimizeSettings>& optimizeSettings) {
     std::ifstream file(name.data());
     if (!file.is_open()) {
       engine::Logger::error("Failed to open MeshGeometry file: {}", name);
@@ -257,6 +292,10 @@ namespace engine::mesh {
               M(layerNames));
 #undef M
 
+    if (optimizeSettings) {
+      mesh.optimize(*optimizeSettings);
+    }
+
     return std::expected<Data, std::string>(std::move(mesh));
   }
 
@@ -306,4 +345,124 @@ namespace engine::mesh {
 
 #undef SET
 
+  OptimizeReport Data::optimize(const OptimizeSettings& settings) {
+    namespace opt = optimizer;
+
+    OptimizeReport report{};
+    size_t vertexCount = _vertices.size();
+    report.verticesBefore = vertexCount;
+    report.verticesAfter = vertexCount;
+
+    if (type != GL_TRIANGLES || _indices.size() < 3 || vertexCount == 0) {
+      return report;
+    }
+
+    for (uint32_t index : _indices) {
+      if (index >= vertexCount) {
+        engine::Logger::warn("Mesh index {} out of range of {} vertices, "
+                             "skipping optimization",
+                             index, vertexCount);
+        return report;
+      }
+    }
+
+    report.before = opt::analyzeVertexCache(_indices, vertexCount,
+                                            settings.reportCacheSize);
+
+    auto remapStreams = [this](std::span<const uint32_t> remap,
+                               size_t newCount) {
+      opt::remapVertexStream(_vertices, remap, newCount);
+      opt::remapVertexStream(_colors, remap, newCount);
+      opt::remapVertexStream(_textureCoords, remap, newCount);
+      opt::remapVertexStream(_normals, remap, newCount);
+      opt::remapVertexStream(_tangents, remap, newCount);
+      opt::remapVertexStream(_weights, remap, newCount);
+      opt::remapVertexStream(_weightIndices, remap, newCount);
+    };
+
+    if (settings.weldVertices) {
+      auto hash = [this, vertexCount](uint32_t v) {
+        size_t h = 14695981039346656037ull;
+        hashAttribute(h, _vertices, vertexCount, v);
+        hashAttribute(h, _colors, vertexCount, v);
+        hashAttribute(h, _textureCoords, vertexCount, v);
+        hashAttribute(h, _normals, vertexCount, v);
+        hashAttribute(h, _tangents, vertexCount, v);
+        hashAttribute(h, _weights, vertexCount, v);
+        hashAttribute(h, _weightIndices, vertexCount, v);
+        return h;
+      };
+      auto equal = [this, vertexCount](uint32_t a, uint32_t b) {
+        return attributeEqual(_vertices, vertexCount, a, b) &&
+               attributeEqual(_colors, vertexCount, a, b) &&
+               attributeEqual(_textureCoords, vertexCount, a, b) &&
+               attributeEqual(_normals, vertexCount, a, b) &&
+               attributeEqual(_tangents, vertexCount, a, b) &&
+               attributeEqual(_weights, vertexCount, a, b) &&
+               attributeEqual(_weightIndices, vertexCount, a, b);
+      };
+
+      std::unordered_map<uint32_t, uint32_t, decltype(hash), decltype(equal)>
+          unique(vertexCount, hash, equal);
+
+      std::vector<uint32_t> remap(vertexCount);
+      uint32_t next = 0;
+      for (uint32_t v = 0; v < vertexCount; ++v) {
+        auto [it, inserted] = unique.try_emplace(v, next);
+        if (inserted) {
+          ++next;
+        }
+        remap[v] = it->second;
+      }
+
+      if (next < vertexCount) {
+        opt::remapIndices(_indices, remap);
+        remapStreams(remap, next);
+        vertexCount = next;
+      }
+    }
+
+    // Triangles are only reordered within a sub mesh, as each is drawn on its
+    // own.
+    std::vector<SubMesh> ranges = _meshLayers;
+    if (ranges.empty()) {
+      ranges.push_back({0, static_cast<int>(_indices.size())});
+    }
+
+    for (const auto& range : ranges) {
+      if (range.start < 0 || range.count < 3 ||
+          static_cast<size_t>(range.start) + range.count > _indices.size()) {
+        continue;
+      }
+      std::span<uint32_t> subIndices(_indices.data() + range.start,
+                                     static_cast<size_t>(range.count) / 3 * 3);
+
+      if (settings.optimizeVertexCache) {
+        opt::optimizeVertexCache(subIndices, vertexCount);
+      }
+      if (settings.optimizeOverdraw) {
+        opt::optimizeOverdraw(subIndices, _vertices,
+                              settings.overdrawThreshold);
+      }
+    }
+
+    if (settings.optimizeVertexFetch) {
+      auto remap = opt::generateVertexFetchRemap(_indices, vertexCount);
+      opt::remapIndices(_indices, remap);
+      remapStreams(remap, vertexCount);
+    }
+
+    report.verticesAfter = vertexCount;
+    report.after = opt::analyzeVertexCache(_indices, vertexCount,
+                                           settings.reportCacheSize);
+
+    engine::Logger::info(
+        "Optimized mesh: {} -> {} vertices, ACMR {:.3f} -> {:.3f}, ATVR "
+        "{:.3f} -> {:.3f}",
+        report.verticesBefore, report.verticesAfter, report.before.acmr,
+        report.after.acmr, report.before.atvr, report.after.atvr);
+
+    return report;
+  }
+
 } // namespace engine::mesh
\ No newline at end of file
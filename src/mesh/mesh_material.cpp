@@ -1,5 +1,6 @@
 #include "engine/mesh/mesh_material.hpp"
 #include <engine/image.hpp>
+#include <engine/texture/ktx2.hpp>
 #include <fstream>
 #include <iostream>
 
@@ -7,6 +8,30 @@
 
 using std::ifstream;
 
+namespace {
+  /// <summary>
+  /// Decodes a texture file without touching OpenGL. .ktx2 files keep their
+  /// prebuilt compressed mips, other images are decoded flipped vertically.
+  /// KTX2 files are expected in that orientation too.
+  /// </summary>
+  std::expected<engine::mesh::DecodedTexture, std::string>
+  decodeTexture(const std::string& path) {
+    if (path.ends_with(".ktx2")) {
+      auto image = engine::texture::ktx2::read(path);
+      if (!image) {
+        return std::unexpected(image.error());
+      }
+      return engine::mesh::DecodedTexture(std::move(*image));
+    }
+
+    auto image = engine::Image::decode(path, {.flipY = true});
+    if (!image) {
+      return std::unexpected(image.error());
+    }
+    return engine::mesh::DecodedTexture(std::move(*image));
+  }
+} // namespace
+
 namespace engine::mesh {
   Material::Material(const std::string& filename) {
     ifstream file(filename);
@@ -74,73 +99,101 @@ namespace engine::mesh {
     return meshLayers[i];
   }
 
-  std::expected<TextureSet, std::string>
-  MaterialEntry::LoadTextures(const std::string& basePath) const {
-    auto diffuseOpt = GetEntry("Diffuse");
-    if (!diffuseOpt) {
+  std::expected<DecodedTextureSet, std::string>
+  MaterialEntry::DecodeTextures(const std::string& basePath,
+                                engine::ThreadPool& pool) const {
+    if (!GetEntry(CHANNELS[0])) {
       return std::unexpected("No diffuse texture specified in material");
     }
-    auto& diffusePath = *diffuseOpt;
-    auto imgOpt = engine::Image::fromFile(basePath + diffusePath.data(), true);
-    if (!imgOpt) {
-      return std::unexpected("Failed to load diffuse texture from " +
-                             std::string(basePath) + std::string(diffusePath));
+
+    std::array<std::string, CHANNELS.size()> errors;
+    DecodedTextureSet decoded;
+    pool.parallelFor(CHANNELS.size(), 1, [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+        auto path = GetEntry(CHANNELS[i]);
+        if (!path) {
+          continue;
+        }
+
+        auto texture = decodeTexture(basePath + std::string(*path));
+        if (!texture) {
+          errors[i] = "Failed to load " + std::string(CHANNELS[i]) +
+                      " texture from " + basePath + std::string(*path) +
+                      ": " + texture.error();
+          continue;
+        }
+        decoded.channels[i].emplace(std::move(*texture));
+      }
+    });
+
+    for (const auto& error : errors) {
+      if (!error.empty()) {
+        return std::unexpected(error);
+      }
     }
+    return decoded;
+  }
 
-    auto& img = imgOpt.value();
-    auto diffuseTex = img.toTexture(-1);
-    diffuseTex.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    diffuseTex.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    diffuseTex.createHandle();
-    auto diffuseHandle = diffuseTex.handle();
+  gl::Texture MaterialEntry::UploadTexture(size_t channel,
+                                           DecodedTexture& texture,
+                                           engine::texture::UploadRing* ring) {
+    // Bump maps are sampled without mips, diffuse maps hold sRGB colour
+    bool mipmaps = channel != 1;
+    bool srgb = channel == 0;
+
+    gl::Texture result = std::visit(
+        [&](auto& image) -> gl::Texture {
+          if constexpr (std::is_same_v<std::decay_t<decltype(image)>,
+                                       engine::Image>) {
+            return image.toTexture(mipmaps ? -1 : 0,
+                                   engine::texture::MipSettings{.srgb = srgb},
+                                   ring);
+          } else {
+            return image.toTexture(ring);
+          }
+        },
+        texture);
+
+    result.setParameter(GL_TEXTURE_MIN_FILTER,
+                        mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    result.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    result.createHandle();
+    return result;
+  }
 
-    TextureImageSet images{
-        .diffuse = std::move(diffuseTex),
-    };
+  std::expected<TextureSet, std::string>
+  MaterialEntry::UploadTextures(DecodedTextureSet&& decoded,
+                                engine::texture::UploadRing* ring) {
+    auto& channels = decoded.channels;
+    if (!channels[0]) {
+      return std::unexpected("No diffuse texture specified in material");
+    }
 
-    TextureHandleSet handles{
-        .diffuse = diffuseHandle,
-    };
+    auto diffuseTex = UploadTexture(0, *channels[0], ring);
+    auto diffuseHandle = diffuseTex.rawHandle();
 
     TextureSet textureSet{
-        .images = std::move(images),
-        .handles = std::move(handles),
+        .images = {.diffuse = std::move(diffuseTex)},
+        .handles = {.diffuse = diffuseHandle},
     };
 
-    auto bumpOpt = GetEntry("Bump");
-    if (bumpOpt) {
-      auto& bumpPath = *bumpOpt;
-      auto imgOpt = engine::Image::fromFile(basePath + bumpPath.data(), true);
-      if (!imgOpt) {
-        return std::unexpected("Failed to load bump texture from " +
-                               std::string(basePath) + std::string(bumpPath));
-      }
-      auto& img = imgOpt.value();
-      textureSet.images.bump = img.toTexture();
-      textureSet.images.bump->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-      textureSet.images.bump->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-      textureSet.images.bump->createHandle();
-      textureSet.handles.bump = textureSet.images.bump->handle();
+    if (channels[1]) {
+      textureSet.images.bump = UploadTexture(1, *channels[1], ring);
+      textureSet.handles.bump = textureSet.images.bump->rawHandle();
     }
-    auto materialOpt = GetEntry("Material");
-    if (materialOpt) {
-      auto& materialPath = *materialOpt;
-      auto imgOpt =
-          engine::Image::fromFile(basePath + materialPath.data(), true);
-      if (!imgOpt) {
-        return std::unexpected("Failed to load material texture from " +
-                               std::string(basePath) +
-                               std::string(materialPath));
-      }
-      auto& img = imgOpt.value();
-      textureSet.images.material = img.toTexture(-1);
-      textureSet.images.material->setParameter(GL_TEXTURE_MIN_FILTER,
-                                               GL_LINEAR_MIPMAP_LINEAR);
-      textureSet.images.material->setParameter(GL_TEXTURE_MAG_FILTER,
-                                               GL_LINEAR);
-      textureSet.images.material->createHandle();
-      textureSet.handles.material = textureSet.images.material->handle();
+    if (channels[2]) {
+      textureSet.images.material = UploadTexture(2, *channels[2], ring);
+      textureSet.handles.material = textureSet.images.material->rawHandle();
     }
     return textureSet;
   }
-} // namespace engine::mesh
\ No newline at end of file
+
+  std::expected<TextureSet, std::string>
+  MaterialEntry::LoadTextures(const std::string& basePath) const {
+    auto decoded = DecodeTextures(basePath);
+    if (!decoded) {
+      return std::unexpected(decoded.error());
+    }
+    return UploadTextures(std::move(*decoded));
+  }
+} // namespace engine::mesh
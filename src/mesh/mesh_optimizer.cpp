@@ -0,0 +1,430 @@
+#include "engine/mesh/mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace {
+  constexpr uint32_t INVALID_INDEX = std::numeric_limits<uint32_t>::max();
+
+  /// <summary>
+  /// Cache size the Forsyth scoring models. Larger than real hardware on
+  /// purpose, as the score only has to rank vertices.
+  /// </summary>
+  constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+  constexpr uint32_t FORSYTH_MAX_VALENCE = 32;
+  constexpr float CACHE_DECAY_POWER = 1.5f;
+  constexpr float LAST_TRI_SCORE = 0.75f;
+  constexpr float VALENCE_BOOST_SCALE = 2.0f;
+  constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+  /// <summary>
+  /// Cache size the overdraw pass uses to find cluster boundaries.
+  /// </summary>
+  constexpr uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+  struct ScoreTables {
+    std::array<float, FORSYTH_CACHE_SIZE + 1> cache{};
+    std::array<float, FORSYTH_MAX_VALENCE + 1> valence{};
+
+    ScoreTables() {
+      // Index 0 is "not in the cache"
+      cache[0] = 0.0f;
+      for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; ++i) {
+        if (i < 3) {
+          cache[i + 1] = LAST_TRI_SCORE;
+        } else {
+          float scaler = 1.0f / static_cast<float>(FORSYTH_CACHE_SIZE - 3);
+          float score = 1.0f - static_cast<float>(i - 3) * scaler;
+          cache[i + 1] = std::pow(score, CACHE_DECAY_POWER);
+        }
+      }
+
+      valence[0] = 0.0f;
+      for (uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; ++i) {
+        valence[i] = VALENCE_BOOST_SCALE *
+                     std::pow(static_cast<float>(i), -VALENCE_BOOST_POWER);
+      }
+    }
+
+    inline float score(int cachePosition, uint32_t remainingTriangles) const {
+      if (remainingTriangles == 0) {
+        return -1.0f;
+      }
+      uint32_t v = std::min(remainingTriangles, FORSYTH_MAX_VALENCE);
+      return cache[cachePosition + 1] + valence[v];
+    }
+  };
+
+  const ScoreTables& scoreTables() {
+    static const ScoreTables tables;
+    return tables;
+  }
+
+  /// <summary>
+  /// FIFO cache simulation shared by the analyzer and the overdraw pass.
+  /// Uses timestamps so that resetting the cache is O(1).
+  /// </summary>
+  class FifoCache {
+  public:
+    FifoCache(size_t vertexCount, uint32_t cacheSize)
+        : timestamps(vertexCount, 0), cacheSize(cacheSize),
+          timestamp(cacheSize + 1) {}
+
+    inline uint32_t addTriangle(const uint32_t* tri) {
+      uint32_t misses = 0;
+      for (int i = 0; i < 3; ++i) {
+        uint32_t v = tri[i];
+        if (timestamp - timestamps[v] > cacheSize) {
+          timestamps[v] = timestamp++;
+          ++misses;
+        }
+      }
+      return misses;
+    }
+
+    inline void reset() { timestamp += cacheSize + 1; }
+
+  private:
+    std::vector<uint32_t> timestamps;
+    uint32_t cacheSize;
+    uint32_t timestamp;
+  };
+} // namespace
+
+namespace engine::mesh::optimizer {
+  VertexCacheStats analyzeVertexCache(std::span<const uint32_t> indices,
+                                      size_t vertexCount, uint32_t cacheSize) {
+    VertexCacheStats stats{};
+    if (indices.size() < 3 || vertexCount == 0) {
+      return stats;
+    }
+
+    FifoCache cache(vertexCount, cacheSize);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32_t uniqueVertices = 0;
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+      stats.misses += cache.addTriangle(&indices[i]);
+      ++stats.triangles;
+      for (int j = 0; j < 3; ++j) {
+        if (!referenced[indices[i + j]]) {
+          referenced[indices[i + j]] = true;
+          ++uniqueVertices;
+        }
+      }
+    }
+
+    stats.acmr = static_cast<float>(stats.misses) /
+                 static_cast<float>(std::max(stats.triangles, 1u));
+    stats.atvr = static_cast<float>(stats.misses) /
+                 static_cast<float>(std::max(uniqueVertices, 1u));
+    return stats;
+  }
+
+  void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2 || vertexCount == 0) {
+      return;
+    }
+
+    const auto& tables = scoreTables();
+
+    // Per vertex list of triangles that still have to be emitted.
+    std::vector<uint32_t> remaining(vertexCount, 0);
+    for (size_t i = 0; i < triangleCount * 3; ++i) {
+      ++remaining[indices[i]];
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; ++v) {
+      adjacencyOffsets[v + 1] = adjacencyOffsets[v] + remaining[v];
+    }
+
+    std::vector<uint32_t> adjacency(triangleCount * 3);
+    {
+      std::vector<uint32_t> fill(adjacencyOffsets.begin(),
+                                 adjacencyOffsets.end() - 1);
+      for (size_t t = 0; t < triangleCount; ++t) {
+        for (int j = 0; j < 3; ++j) {
+          adjacency[fill[indices[t * 3 + j]]++] = static_cast<uint32_t>(t);
+        }
+      }
+    }
+
+    std::vector<int> cachePosition(vertexCount, -1);
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v) {
+      vertexScores[v] = tables.score(-1, remaining[v]);
+    }
+
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t) {
+      triangleScores[t] = vertexScores[indices[t * 3 + 0]] +
+                          vertexScores[indices[t * 3 + 1]] +
+                          vertexScores[indices[t * 3 + 2]];
+    }
+
+    std::vector<uint32_t> output;
+    output.reserve(triangleCount * 3);
+
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> cache{};
+    std::array<uint32_t, FORSYTH_CACHE_SIZE + 3> newCache{};
+    uint32_t cacheCount = 0;
+
+    uint32_t bestTriangle = static_cast<uint32_t>(
+        std::max_element(triangleScores.begin(), triangleScores.end()) -
+        triangleScores.begin());
+    size_t scanPosition = 0;
+
+    for (size_t emittedCount = 0; emittedCount < triangleCount;
+         ++emittedCount) {
+      if (bestTriangle == INVALID_INDEX) {
+        // Nothing in the cache is connected to the remaining triangles, so
+        // continue from the next one in input order.
+        while (emitted[scanPosition]) {
+          ++scanPosition;
+        }
+        bestTriangle = static_cast<uint32_t>(scanPosition);
+      }
+
+      const uint32_t* tri = &indices[bestTriangle * 3];
+      output.insert(output.end(), tri, tri + 3);
+      emitted[bestTriangle] = true;
+
+      // Drop the triangle from its vertices' remaining lists
+      for (int j = 0; j < 3; ++j) {
+        uint32_t v = tri[j];
+        uint32_t* list = &adjacency[adjacencyOffsets[v]];
+        uint32_t count = remaining[v];
+        for (uint32_t k = 0; k < count; ++k) {
+          if (list[k] == bestTriangle) {
+            list[k] = list[count - 1];
+            break;
+          }
+        }
+        --remaining[v];
+      }
+
+      // Emitted vertices go to the front, everything else shifts back
+      uint32_t newCount = 0;
+      for (int j = 0; j < 3; ++j) {
+        newCache[newCount++] = tri[j];
+      }
+      for (uint32_t k = 0; k < cacheCount; ++k) {
+        uint32_t v = cache[k];
+        if (v != tri[0] && v != tri[1] && v != tri[2]) {
+          newCache[newCount++] = v;
+        }
+      }
+
+      // Anything past the modelled size falls out of the cache
+      for (uint32_t k = FORSYTH_CACHE_SIZE; k < newCount; ++k) {
+        uint32_t v = newCache[k];
+        cachePosition[v] = -1;
+        vertexScores[v] = tables.score(-1, remaining[v]);
+      }
+      cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+      std::copy_n(newCache.begin(), cacheCount, cache.begin());
+
+      for (uint32_t k = 0; k < cacheCount; ++k) {
+        uint32_t v = cache[k];
+        cachePosition[v] = static_cast<int>(k);
+        vertexScores[v] = tables.score(static_cast<int>(k), remaining[v]);
+      }
+
+      // Rescore every triangle touching the cache and pick the best one
+      bestTriangle = INVALID_INDEX;
+      float bestScore = -1.0f;
+      auto rescore = [&](uint32_t v) {
+        const uint32_t* list = &adjacency[adjacencyOffsets[v]];
+        for (uint32_t k = 0; k < remaining[v]; ++k) {
+          uint32_t t = list[k];
+          float score = vertexScores[indices[t * 3 + 0]] +
+                        vertexScores[indices[t * 3 + 1]] +
+                        vertexScores[indices[t * 3 + 2]];
+          triangleScores[t] = score;
+          if (score > bestScore) {
+            bestScore = score;
+            bestTriangle = t;
+          }
+        }
+      };
+      for (uint32_t k = 0; k < newCount; ++k) {
+        rescore(newCache[k]);
+      }
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+  }
+
+  void optimizeOverdraw(std::span<uint32_t> indices,
+                        std::span<const glm::vec3> positions, float threshold) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2 || positions.empty()) {
+      return;
+    }
+
+    FifoCache cache(positions.size(), OVERDRAW_CACHE_SIZE);
+
+    // Hard boundaries, where the cache order has already restarted (every
+    // vertex of the triangle misses). Splitting here is free.
+    std::vector<uint32_t> hardBoundaries;
+    for (size_t t = 0; t < triangleCount; ++t) {
+      if (cache.addTriangle(&indices[t * 3]) == 3) {
+        hardBoundaries.push_back(static_cast<uint32_t>(t));
+      }
+    }
+    if (hardBoundaries.empty() || hardBoundaries.front() != 0) {
+      hardBoundaries.insert(hardBoundaries.begin(), 0);
+    }
+
+    // Soft boundaries split each hard cluster further, whenever the running
+    // ACMR is already within threshold of what the whole cluster achieves.
+    std::vector<uint32_t> boundaries;
+    for (size_t c = 0; c < hardBoundaries.size(); ++c) {
+      uint32_t start = hardBoundaries[c];
+      uint32_t end = c + 1 < hardBoundaries.size()
+                         ? hardBoundaries[c + 1]
+                         : static_cast<uint32_t>(triangleCount);
+
+      cache.reset();
+      uint32_t clusterMisses = 0;
+      for (uint32_t t = start; t < end; ++t) {
+        clusterMisses += cache.addTriangle(&indices[t * 3]);
+      }
+      float clusterThreshold = threshold * static_cast<float>(clusterMisses) /
+                               static_cast<float>(end - start);
+
+      size_t clusterFirst = boundaries.size();
+      boundaries.push_back(start);
+      cache.reset();
+      uint32_t runningMisses = 0;
+      uint32_t runningTriangles = 0;
+      for (uint32_t t = start; t < end; ++t) {
+        runningMisses += cache.addTriangle(&indices[t * 3]);
+        ++runningTriangles;
+        if (static_cast<float>(runningMisses) /
+                    static_cast<float>(runningTriangles) <=
+                clusterThreshold &&
+            t + 1 < end) {
+          boundaries.push_back(t + 1);
+          cache.reset();
+          runningMisses = 0;
+          runningTriangles = 0;
+        }
+      }
+
+      // The tail of a hard cluster is usually a poor cluster on its own, so
+      // merge it into the previous one.
+      if (boundaries.size() - clusterFirst > 1 && runningTriangles > 0) {
+        boundaries.pop_back();
+      }
+    }
+
+    size_t clusterCount = boundaries.size();
+
+    struct ClusterInfo {
+      glm::vec3 centroid = glm::vec3(0.0f);
+      glm::vec3 normal = glm::vec3(0.0f);
+      float area = 0.0f;
+      float sortKey = 0.0f;
+    };
+    std::vector<ClusterInfo> clusters(clusterCount);
+
+    glm::vec3 meshCentroid(0.0f);
+    float meshArea = 0.0f;
+
+    for (size_t c = 0; c < clusterCount; ++c) {
+      uint32_t start = boundaries[c];
+      uint32_t end = c + 1 < clusterCount
+                         ? boundaries[c + 1]
+                         : static_cast<uint32_t>(triangleCount);
+      auto& info = clusters[c];
+
+      for (uint32_t t = start; t < end; ++t) {
+        const glm::vec3& a = positions[indices[t * 3 + 0]];
+        const glm::vec3& b = positions[indices[t * 3 + 1]];
+        const glm::vec3& d = positions[indices[t * 3 + 2]];
+
+        glm::vec3 normal = glm::cross(b - a, d - a);
+        float area = glm::length(normal);
+
+        info.centroid += (a + b + d) * (area / 3.0f);
+        info.normal += normal;
+        info.area += area;
+      }
+
+      meshCentroid += info.centroid;
+      meshArea += info.area;
+
+      if (info.area > 0.0f) {
+        info.centroid /= info.area;
+      }
+      float normalLength = glm::length(info.normal);
+      if (normalLength > 0.0f) {
+        info.normal /= normalLength;
+      }
+    }
+
+    if (meshArea > 0.0f) {
+      meshCentroid /= meshArea;
+    }
+
+    for (auto& info : clusters) {
+      info.sortKey = glm::dot(info.centroid - meshCentroid, info.normal);
+    }
+
+    // Clusters facing away from the centre are most likely to be in front of
+    // the rest of the mesh, so draw those first.
+    std::vector<uint32_t> order(clusterCount);
+    std::iota(order.begin(), order.end(), 0u);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+      return clusters[a].sortKey > clusters[b].sortKey;
+    });
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+    for (uint32_t c : order) {
+      uint32_t start = boundaries[c];
+      uint32_t end = c + 1 < clusterCount
+                         ? boundaries[c + 1]
+                         : static_cast<uint32_t>(triangleCount);
+      output.insert(output.end(), indices.begin() + start * 3,
+                    indices.begin() + end * 3);
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+  }
+
+  std::vector<uint32_t>
+  generateVertexFetchRemap(std::span<const uint32_t> indices,
+                           size_t vertexCount) {
+    std::vector<uint32_t> remap(vertexCount, INVALID_INDEX);
+    uint32_t next = 0;
+
+    for (uint32_t index : indices) {
+      if (remap[index] == INVALID_INDEX) {
+        remap[index] = next++;
+      }
+    }
+
+    for (auto& entry : remap) {
+      if (entry == INVALID_INDEX) {
+        entry = next++;
+      }
+    }
+
+    return remap;
+  }
+
+  void remapIndices(std::span<uint32_t> indices,
+                    std::span<const uint32_t> remap) {
+    for (auto& index : indices) {
+      index = remap[index];
+    }
+  }
+} // namespace engine::mesh::optimizer
@@ -0,0 +1,263 @@
+#include "engine/mesh/meshlet.hpp"
+
+#include "../logger.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+  using engine::mesh::Meshlet;
+  using engine::mesh::MeshletBounds;
+
+  constexpr uint8_t UNUSED_LOCAL = 0xff;
+
+  /// <summary>
+  /// Below this the normals of a meshlet spread too far for the cone to ever
+  /// reject it, so the test is disabled.
+  /// </summary>
+  constexpr float MIN_CONE_SPREAD = 0.1f;
+
+  /// <summary>
+  /// Ritter's bounding sphere. Not minimal, but within a few percent and
+  /// linear time.
+  /// </summary>
+  glm::vec4 boundingSphere(const glm::vec3* positions, const uint32_t* vertices,
+                           uint32_t count) {
+    const glm::vec3& first = positions[vertices[0]];
+
+    auto furthestFrom = [&](const glm::vec3& point) {
+      uint32_t furthest = 0;
+      float furthestDistance = -1.0f;
+      for (uint32_t i = 0; i < count; ++i) {
+        glm::vec3 d = positions[vertices[i]] - point;
+        float distance = glm::dot(d, d);
+        if (distance > furthestDistance) {
+          furthestDistance = distance;
+          furthest = i;
+        }
+      }
+      return positions[vertices[furthest]];
+    };
+
+    glm::vec3 a = furthestFrom(first);
+    glm::vec3 b = furthestFrom(a);
+
+    glm::vec3 centre = (a + b) * 0.5f;
+    float radius = glm::length(b - a) * 0.5f;
+
+    for (uint32_t i = 0; i < count; ++i) {
+      const glm::vec3& p = positions[vertices[i]];
+      float distance = glm::length(p - centre);
+      if (distance > radius) {
+        float newRadius = (radius + distance) * 0.5f;
+        centre += (p - centre) * ((newRadius - radius) / distance);
+        radius = newRadius;
+      }
+    }
+
+    return glm::vec4(centre, radius);
+  }
+
+  MeshletBounds computeBounds(const glm::vec3* positions,
+                              const uint32_t* vertices, const uint8_t* tris,
+                              const Meshlet& meshlet) {
+    MeshletBounds bounds{};
+    bounds.sphere = boundingSphere(positions, vertices, meshlet.vertexCount);
+    glm::vec3 centre(bounds.sphere);
+
+    // Disabled unless proven otherwise
+    bounds.coneApex = glm::vec4(centre, 0.0f);
+    bounds.cone = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+
+    // Degenerate triangles keep a zero normal and are skipped below
+    std::vector<glm::vec3> normals(meshlet.triangleCount, glm::vec3(0.0f));
+    glm::vec3 axis(0.0f);
+    bool anyNormal = false;
+
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+      const glm::vec3& a = positions[vertices[tris[t * 3 + 0]]];
+      const glm::vec3& b = positions[vertices[tris[t * 3 + 1]]];
+      const glm::vec3& c = positions[vertices[tris[t * 3 + 2]]];
+
+      glm::vec3 normal = glm::cross(b - a, c - a);
+      float area = glm::length(normal);
+      if (area <= 0.0f) {
+        continue;
+      }
+      normal /= area;
+      normals[t] = normal;
+      axis += normal;
+      anyNormal = true;
+    }
+
+    float axisLength = glm::length(axis);
+    if (!anyNormal || axisLength <= 0.0f) {
+      return bounds;
+    }
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const auto& normal : normals) {
+      if (normal != glm::vec3(0.0f)) {
+        minDot = std::min(minDot, glm::dot(normal, axis));
+      }
+    }
+
+    if (minDot <= MIN_CONE_SPREAD) {
+      return bounds;
+    }
+
+    // Move the apex back along the axis until it is behind every triangle's
+    // plane, so the test is conservative for viewers anywhere.
+    float maxT = 0.0f;
+    for (uint32_t t = 0; t < meshlet.triangleCount; ++t) {
+      const glm::vec3& normal = normals[t];
+      if (normal == glm::vec3(0.0f)) {
+        continue;
+      }
+      const glm::vec3& a = positions[vertices[tris[t * 3 + 0]]];
+      float distance = glm::dot(centre - a, normal) / glm::dot(axis, normal);
+      maxT = std::max(maxT, distance);
+    }
+
+    bounds.coneApex = glm::vec4(centre - axis * maxT, 0.0f);
+    bounds.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+    return bounds;
+  }
+} // namespace
+
+namespace engine::mesh {
+  Meshlets Meshlets::build(const Data& data, uint32_t maxVertices,
+                           uint32_t maxTriangles) {
+    Meshlets result;
+
+    const auto& positions = data.vertices();
+    const auto& indices = data.indices();
+    if (positions.empty() || indices.size() < 3) {
+      return result;
+    }
+
+    maxVertices = std::clamp(maxVertices, 3u, 255u);
+    maxTriangles = std::max(maxTriangles, 1u);
+
+    std::vector<SubMesh> ranges = data.meshLayers();
+    if (ranges.empty()) {
+      ranges.push_back({0, static_cast<int>(indices.size())});
+    }
+
+    // Local index of each mesh vertex in the meshlet being built
+    std::vector<uint8_t> local(positions.size(), UNUSED_LOCAL);
+
+    Meshlet current{};
+    auto flush = [&]() {
+      if (current.triangleCount == 0) {
+        return;
+      }
+      for (uint32_t i = 0; i < current.vertexCount; ++i) {
+        local[result._vertices[current.vertexOffset + i]] = UNUSED_LOCAL;
+      }
+      result._meshlets.push_back(current);
+      current = Meshlet{
+          .vertexOffset = static_cast<uint32_t>(result._vertices.size()),
+          .triangleOffset = static_cast<uint32_t>(result._triangles.size()),
+          .vertexCount = 0,
+          .triangleCount = 0,
+      };
+    };
+
+    for (const auto& range : ranges) {
+      int meshletStart = static_cast<int>(result._meshlets.size());
+
+      if (range.start >= 0 && range.count >= 3 &&
+          static_cast<size_t>(range.start) + range.count <= indices.size()) {
+        size_t end = range.start + range.count / 3 * 3;
+        for (size_t i = range.start; i < end; i += 3) {
+          uint32_t tri[3] = {indices[i], indices[i + 1], indices[i + 2]};
+          if (tri[0] >= positions.size() || tri[1] >= positions.size() ||
+              tri[2] >= positions.size()) {
+            engine::Logger::warn("Meshlet build: index out of range, skipping "
+                                 "triangle");
+            continue;
+          }
+
+          uint32_t newVertices = (local[tri[0]] == UNUSED_LOCAL) +
+                                 (local[tri[1]] == UNUSED_LOCAL) +
+                                 (local[tri[2]] == UNUSED_LOCAL);
+          if (current.vertexCount + newVertices > maxVertices ||
+              current.triangleCount + 1 > maxTriangles) {
+            flush();
+          }
+
+          for (uint32_t v : tri) {
+            if (local[v] == UNUSED_LOCAL) {
+              local[v] = static_cast<uint8_t>(current.vertexCount++);
+              result._vertices.push_back(v);
+            }
+            result._triangles.push_back(local[v]);
+          }
+          ++current.triangleCount;
+        }
+      }
+
+      // Meshlets never span sub meshes
+      flush();
+      result._subMeshes.push_back(
+          {meshletStart,
+           static_cast<int>(result._meshlets.size()) - meshletStart});
+    }
+
+    result._bounds.reserve(result._meshlets.size());
+    for (const auto& meshlet : result._meshlets) {
+      result._bounds.push_back(
+          computeBounds(positions.data(),
+                        result._vertices.data() + meshlet.vertexOffset,
+                        result._triangles.data() + meshlet.triangleOffset,
+                        meshlet));
+    }
+
+    return result;
+  }
+
+  size_t Meshlets::cull(const Frustum& frustum, const glm::mat4& model,
+                        const glm::vec3& cameraPosition,
+                        std::vector<uint32_t>& visible) const {
+    glm::vec3 scale2(glm::dot(glm::vec3(model[0]), glm::vec3(model[0])),
+                     glm::dot(glm::vec3(model[1]), glm::vec3(model[1])),
+                     glm::dot(glm::vec3(model[2]), glm::vec3(model[2])));
+    float maxScale =
+        std::sqrt(std::max(scale2.x, std::max(scale2.y, scale2.z)));
+
+    // Directions only transform like normals under uniform scale, so skip the
+    // cone test for anything else rather than rejecting visible meshlets.
+    float minScale2 = std::min(scale2.x, std::min(scale2.y, scale2.z));
+    bool uniformScale = maxScale * maxScale - minScale2 <=
+                        1e-4f * maxScale * maxScale;
+    glm::mat3 rotation(model);
+
+    size_t before = visible.size();
+    for (size_t i = 0; i < _bounds.size(); ++i) {
+      const auto& bounds = _bounds[i];
+
+      glm::vec3 centre(model * glm::vec4(glm::vec3(bounds.sphere), 1.0f));
+      float radius = bounds.sphere.w * maxScale;
+      if (!frustum.SphereInFrustum(centre, radius)) {
+        continue;
+      }
+
+      if (uniformScale && bounds.cone.w < 1.0f) {
+        glm::vec3 apex(model * glm::vec4(glm::vec3(bounds.coneApex), 1.0f));
+        glm::vec3 axis =
+            glm::normalize(rotation * glm::vec3(bounds.cone));
+        glm::vec3 view = apex - cameraPosition;
+        float viewLength = glm::length(view);
+        if (viewLength > 0.0f &&
+            glm::dot(view, axis) >= bounds.cone.w * viewLength) {
+          continue;
+        }
+      }
+
+      visible.push_back(static_cast<uint32_t>(i));
+    }
+
+    return visible.size() - before;
+  }
+} // namespace engine::mesh
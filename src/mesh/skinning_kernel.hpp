@@ -0,0 +1,149 @@
+#pragma once
+
+#include "engine/mesh/mesh.hpp"
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__) && (defined(__FMA__) || defined(_MSC_VER))
+#define ENGINE_SKINNING_AVX2
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_SKINNING_SSE2
+#include <emmintrin.h>
+#endif
+
+// SIMD skinning kernel, shared by cpu_skinning.cpp (SSE2) and
+// cpu_skinning_avx2.cpp (built with AVX2 / FMA, picked at runtime).
+// Everything is in an anonymous namespace so each translation unit gets its
+// own copy for its instruction set, and only uses raw pointers and
+// intrinsics: an out of line glm function instantiated with AVX2 enabled
+// could be picked by the linker for the SSE2 translation unit too.
+#ifdef ENGINE_SKINNING_SSE2
+namespace engine::mesh::skinning {
+  namespace {
+    inline uint32_t kernelJointIndex(int index, size_t paletteSize) {
+      return static_cast<size_t>(index) < paletteSize
+                 ? static_cast<uint32_t>(index)
+                 : 0u;
+    }
+
+    inline __m128 loadVec3(const float* v) {
+      __m128 xy =
+          _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(v)));
+      return _mm_movelh_ps(xy, _mm_load_ss(v + 2));
+    }
+
+    inline __m128 dot3(__m128 a, __m128 b) {
+      __m128 m = _mm_mul_ps(a, b);
+      __m128 yzx = _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 0, 2, 1));
+      __m128 zxy = _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 1, 0, 2));
+      return _mm_add_ps(_mm_add_ps(m, yzx), zxy);
+    }
+
+    /// <summary>
+    /// Normalises the xyz of v, leaving zero vectors as they are.
+    /// </summary>
+    inline __m128 normalize3(__m128 v) {
+      __m128 lengthSq = dot3(v, v);
+      __m128 nonZero = _mm_cmpgt_ps(lengthSq, _mm_setzero_ps());
+      __m128 normalized = _mm_div_ps(v, _mm_sqrt_ps(lengthSq));
+      return _mm_or_ps(_mm_and_ps(nonZero, normalized),
+                       _mm_andnot_ps(nonZero, v));
+    }
+
+    inline __m128 transformDirection(const __m128 (&m)[4], __m128 v) {
+      __m128 x = _mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0));
+      __m128 y = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1));
+      __m128 z = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2));
+      return _mm_add_ps(_mm_add_ps(_mm_mul_ps(m[0], x), _mm_mul_ps(m[1], y)),
+                        _mm_mul_ps(m[2], z));
+    }
+
+    /// <summary>
+    /// Blends the four joints of a vertex into one matrix (as four columns).
+    /// Returns false if the vertex has no weight.
+    /// </summary>
+    /// <param name="palette">Column major matrices, 16 floats each</param>
+    inline bool blendJoints(const WeightedVertex& v, const float* palette,
+                            size_t paletteSize, __m128 (&m)[4]) {
+      const float* w = &v.jointWeights.x;
+      const int* joints = &v.jointIndices.x;
+      if (w[0] + w[1] + w[2] + w[3] == 0.0f) {
+        return false;
+      }
+
+#ifdef ENGINE_SKINNING_AVX2
+      __m256 lo = _mm256_setzero_ps();
+      __m256 hi = _mm256_setzero_ps();
+      for (int k = 0; k < 4; ++k) {
+        const float* joint =
+            palette + kernelJointIndex(joints[k], paletteSize) * 16;
+        __m256 weight = _mm256_set1_ps(w[k]);
+        lo = _mm256_fmadd_ps(weight, _mm256_loadu_ps(joint), lo);
+        hi = _mm256_fmadd_ps(weight, _mm256_loadu_ps(joint + 8), hi);
+      }
+      m[0] = _mm256_castps256_ps128(lo);
+      m[1] = _mm256_extractf128_ps(lo, 1);
+      m[2] = _mm256_castps256_ps128(hi);
+      m[3] = _mm256_extractf128_ps(hi, 1);
+#else
+      m[0] = m[1] = m[2] = m[3] = _mm_setzero_ps();
+      for (int k = 0; k < 4; ++k) {
+        const float* joint =
+            palette + kernelJointIndex(joints[k], paletteSize) * 16;
+        __m128 weight = _mm_set1_ps(w[k]);
+        for (int c = 0; c < 4; ++c) {
+          m[c] =
+              _mm_add_ps(m[c], _mm_mul_ps(weight, _mm_loadu_ps(joint + c * 4)));
+        }
+      }
+#endif
+      return true;
+    }
+
+    inline void skinVertexSimd(const WeightedVertex& v, const float* palette,
+                               size_t paletteSize, Vertex& out) {
+      __m128 m[4];
+      if (!blendJoints(v, palette, paletteSize, m)) {
+        // A Vertex is the start of a WeightedVertex, copied as 4 vec4s
+        const float* in = &v.position.x;
+        float* dest = &out.position.x;
+        for (int i = 0; i < 4; ++i) {
+          _mm_storeu_ps(dest + i * 4, _mm_loadu_ps(in + i * 4));
+        }
+        return;
+      }
+
+      const __m128 xyzMask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+
+      __m128 position = loadVec3(&v.position.x);
+      __m128 skinnedPosition =
+          _mm_add_ps(transformDirection(m, position), m[3]);
+      __m128 normal = normalize3(transformDirection(m, loadVec3(&v.normal.x)));
+      __m128 tangentIn = _mm_loadu_ps(&v.tangent.x);
+      __m128 tangent = normalize3(transformDirection(m, tangentIn));
+
+      // w lanes: padding stays 0, tangent keeps its handedness
+      _mm_storeu_ps(&out.position.x, _mm_and_ps(skinnedPosition, xyzMask));
+      _mm_storeu_ps(&out.texCoord.x,
+                    _mm_castpd_ps(_mm_load_sd(
+                        reinterpret_cast<const double*>(&v.texCoord.x))));
+      _mm_storeu_ps(&out.normal.x, _mm_and_ps(normal, xyzMask));
+      _mm_storeu_ps(&out.tangent.x,
+                    _mm_or_ps(_mm_and_ps(tangent, xyzMask),
+                              _mm_andnot_ps(xyzMask, tangentIn)));
+    }
+
+    inline void skinRangeSimd(const WeightedVertex* input, const float* palette,
+                              size_t paletteSize, Vertex* output,
+                              size_t count) {
+      for (size_t i = 0; i < count; ++i) {
+        skinVertexSimd(input[i], palette, paletteSize, output[i]);
+      }
+    }
+  } // namespace
+} // namespace engine::mesh::skinning
+#endif
@@ -1,17 +1,30 @@
 #include "engine/scene_graph.hpp"
+#include "engine/cpu_profiler.hpp"
 #include "logger.hpp"
+#include "engine/mesh/material_registry.hpp"
 #include <algorithm>
+#include <cmath>
 #include <functional>
 
 namespace engine::scene {
   Graph::NodeLists Graph::BuildNodeLists(const engine::Frustum& frustum,
-                                         const glm::vec3& position) {
+                                         const glm::vec3& position,
+                                         const TextureFeedback* feedback) {
+    ENGINE_PROFILE_ZONE("BuildNodeLists");
     NodeLists lists;
 
     auto addNodeToList = [&](Node& node) {
       glm::vec3 nodePos(node.GetTransforms().world[3]);
       auto relCamPos = nodePos - position;
       float dist = glm::dot(relCamPos, relCamPos); // Squared distance
+      if (feedback) {
+        // Projected diameter, clamped for nodes around the camera
+        float diameter = 2.0f * node.GetBoundingRadius();
+        float distance = std::max(std::sqrt(dist), node.GetBoundingRadius());
+        node.reportTextureUsage(feedback->registry,
+                                diameter / distance *
+                                    feedback->projectionScale);
+      }
       switch (node.getRenderType()) {
       case Node::RenderType::LIT:
         lists.lit.emplace_back(&node, dist);
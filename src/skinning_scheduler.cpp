@@ -0,0 +1,210 @@
+#include "engine/skinning_scheduler.hpp"
+
+#include "engine/cpu_profiler.hpp"
+#include "engine/gpu_profiler.hpp"
+#include "logger.hpp"
+#include <algorithm>
+
+namespace {
+  /// <summary>
+  /// Largest GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT in practice, so every
+  /// frame region can be bound with bindRange.
+  /// </summary>
+  constexpr GLuint REGION_ALIGNMENT = 256;
+} // namespace
+
+namespace engine {
+  SkinningScheduler::SkinningScheduler(uint32_t maxInstances)
+      : maxInstances(maxInstances),
+        regionSize(gl::Buffer::roundToAlignment(
+            static_cast<GLuint>(maxInstances * sizeof(Instance)),
+            REGION_ALIGNMENT)),
+        buffer({regionSize * FRAMES_IN_FLIGHT,
+                nullptr,
+                gl::Buffer::Usage::WRITE | gl::Buffer::Usage::PERSISTENT |
+                    gl::Buffer::Usage::COHERENT}) {
+    mapping = buffer.map(gl::Buffer::Mapping::COHERENT |
+                         gl::Buffer::Mapping::PERSISTENT |
+                         gl::Buffer::Mapping::WRITE);
+    buffer.label("Skinning Parameters");
+    instances.reserve(maxInstances);
+  }
+
+  void SkinningScheduler::begin(uint32_t baseVertex,
+                                uint32_t vertexCapacity) {
+    region = (region + 1) % FRAMES_IN_FLIGHT;
+
+    auto& fence = fences[region];
+    if (fence.has_value()) {
+      fence->wait();
+      fence.reset();
+    }
+
+    if (baseVertex != outputBase || vertexCapacity != outputCapacity) {
+      outputBase = baseVertex;
+      outputCapacity = vertexCapacity;
+      clear();
+    }
+
+    ++frameIndex;
+    instances.clear();
+    totalVertices = 0;
+    cacheHits = 0;
+  }
+
+  uint32_t SkinningScheduler::add(const PoseKey& key, uint32_t vertexOffset,
+                                  uint32_t startJoint, uint32_t jointCount,
+                                  uint32_t frame, uint32_t vertexCount) {
+    if (auto it = cache.find(key); it != cache.end()) {
+      it->second.lastUsed = frameIndex;
+      lru.splice(lru.end(), lru, it->second.lru);
+      ++cacheHits;
+      return it->second.baseVertex;
+    }
+
+    if (instances.size() >= maxInstances) {
+      engine::Logger::error(
+          "Skinning scheduler is full ({} instances), instance skipped",
+          maxInstances);
+      return outputBase;
+    }
+
+    auto baseVertex = allocate(vertexCount);
+    if (!baseVertex.has_value()) {
+      baseVertex = evictFor(vertexCount);
+    }
+    if (!baseVertex.has_value()) {
+      engine::Logger::error("Skinning output is full ({} vertices), {} vertex "
+                            "instance skipped",
+                            outputCapacity, vertexCount);
+      return outputBase;
+    }
+
+    instances.push_back({
+        .vertexOffset = vertexOffset,
+        .startJoint = startJoint,
+        .jointCount = jointCount,
+        .frame = frame,
+        .baseVertex = *baseVertex,
+        .vertexCount = vertexCount,
+        .firstInvocation = totalVertices,
+    });
+    totalVertices += vertexCount;
+
+    cache.emplace(key, CacheEntry{.baseVertex = *baseVertex,
+                                  .vertexCount = vertexCount,
+                                  .lastUsed = frameIndex,
+                                  .lru = lru.insert(lru.end(), key)});
+    return *baseVertex;
+  }
+
+  void SkinningScheduler::clear() {
+    cache.clear();
+    lru.clear();
+    freeRanges.clear();
+    freeBySize.clear();
+    if (outputCapacity > 0) {
+      addFreeRange(outputBase, outputCapacity);
+    }
+  }
+
+  size_t
+  SkinningScheduler::PoseKeyHash::operator()(const PoseKey& key) const {
+    size_t hash = std::hash<const void*>{}(key.mesh);
+    hash ^= std::hash<const void*>{}(key.animation) + 0x9e3779b9 +
+            (hash << 6) + (hash >> 2);
+    hash ^= std::hash<uint32_t>{}(key.frame) + 0x9e3779b9 + (hash << 6) +
+            (hash >> 2);
+    return hash;
+  }
+
+  void SkinningScheduler::addFreeRange(uint32_t first, uint32_t count) {
+    freeRanges.emplace(first, count);
+    freeBySize.emplace(count, first);
+  }
+
+  void SkinningScheduler::eraseFreeRange(
+      std::map<uint32_t, uint32_t>::iterator range) {
+    freeBySize.erase({range->second, range->first});
+    freeRanges.erase(range);
+  }
+
+  std::optional<uint32_t> SkinningScheduler::allocate(uint32_t vertexCount) {
+    auto fit = freeBySize.lower_bound({vertexCount, 0});
+    if (fit == freeBySize.end()) {
+      return std::nullopt;
+    }
+
+    auto [count, first] = *fit;
+    eraseFreeRange(freeRanges.find(first));
+    if (count > vertexCount) {
+      addFreeRange(first + vertexCount, count - vertexCount);
+    }
+    return first;
+  }
+
+  void SkinningScheduler::release(uint32_t baseVertex, uint32_t vertexCount) {
+    // Merge with the following range
+    if (auto next = freeRanges.find(baseVertex + vertexCount);
+        next != freeRanges.end()) {
+      vertexCount += next->second;
+      eraseFreeRange(next);
+    }
+
+    // Merge with the preceding range
+    if (auto next = freeRanges.lower_bound(baseVertex);
+        next != freeRanges.begin()) {
+      auto previous = std::prev(next);
+      if (previous->first + previous->second == baseVertex) {
+        baseVertex = previous->first;
+        vertexCount += previous->second;
+        eraseFreeRange(previous);
+      }
+    }
+
+    addFreeRange(baseVertex, vertexCount);
+  }
+
+  std::optional<uint32_t> SkinningScheduler::evictFor(uint32_t vertexCount) {
+    // Ordered by last use, so once a pose was used this frame all after it
+    // were too
+    while (!lru.empty()) {
+      auto it = cache.find(lru.front());
+      if (it->second.lastUsed == frameIndex) {
+        break;
+      }
+      release(it->second.baseVertex, it->second.vertexCount);
+      cache.erase(it);
+      lru.pop_front();
+
+      if (auto baseVertex = allocate(vertexCount)) {
+        return baseVertex;
+      }
+    }
+    return std::nullopt;
+  }
+
+  uint32_t SkinningScheduler::dispatch(GLuint binding) {
+    if (instances.empty() || totalVertices == 0) {
+      return 0;
+    }
+    ENGINE_PROFILE_ZONE("Skinning dispatch");
+    engine::GpuProfiler::Zone zone("Skinning");
+
+    auto regionOffset = region * regionSize;
+    auto size = static_cast<GLuint>(instances.size() * sizeof(Instance));
+
+    mapping.write(instances.data(), size, regionOffset);
+    buffer.bindRange(gl::Buffer::StorageTarget::STORAGE, binding,
+                     regionOffset, size);
+
+    glUniform1ui(0, static_cast<GLuint>(instances.size()));
+    glUniform1ui(1, totalVertices);
+
+    uint32_t workgroups = (totalVertices + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE;
+    glDispatchCompute(workgroups, 1, 1);
+
+    fences[region].emplace();
+    return workgroups;
+  }
+} // namespace engine
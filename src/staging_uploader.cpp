@@ -0,0 +1,85 @@
+#include "engine/staging_uploader.hpp"
+
+#include "logger.hpp"
+#include <algorithm>
+
+namespace engine {
+  StagingUploader::StagingUploader(GLuint capacity) : ring(capacity) {
+    ring.getBuffer().label("Staging Uploads");
+  }
+
+  std::optional<gl::MappingRef>
+  StagingUploader::request(const gl::Buffer& destination, GLuint offset,
+                           GLuint size, GLuint alignment) {
+    if (size > ring.capacity()) {
+      engine::Logger::error("Upload of {} bytes does not fit the {} byte "
+                            "staging ring",
+                            size, ring.capacity());
+      return std::nullopt;
+    }
+
+    // The ring only waits on fenced space, which pending data is not yet
+    if (!ring.fits(size, alignment) && !pending.empty()) {
+      flush();
+    }
+    auto allocation = ring.allocate(size, alignment);
+    if (!allocation) {
+      return std::nullopt;
+    }
+
+    pending.push_back({
+        .destination = &destination,
+        .stagingOffset = allocation->offset,
+        .destinationOffset = offset,
+        .size = size,
+    });
+    ++requests;
+    return ring.ref(*allocation);
+  }
+
+  uint64_t StagingUploader::flush() {
+    if (pending.empty()) {
+      return nextBatch == 0 ? 0 : nextBatch - 1;
+    }
+
+    std::stable_sort(pending.begin(), pending.end(),
+                     [](const Copy& a, const Copy& b) {
+                       if (a.destination != b.destination) {
+                         return a.destination->id() < b.destination->id();
+                       }
+                       return a.destinationOffset < b.destinationOffset;
+                     });
+
+    const auto& staging = ring.getBuffer();
+    auto run = pending.front();
+    auto issue = [&](const Copy& copy) {
+      staging.copyTo(*copy.destination, copy.stagingOffset,
+                     copy.destinationOffset, copy.size);
+      ++copies;
+    };
+    for (size_t i = 1; i < pending.size(); ++i) {
+      const auto& copy = pending[i];
+      if (copy.destination == run.destination &&
+          copy.destinationOffset == run.destinationOffset + run.size &&
+          copy.stagingOffset == run.stagingOffset + run.size) {
+        run.size += copy.size;
+        continue;
+      }
+      issue(run);
+      run = copy;
+    }
+    issue(run);
+    pending.clear();
+
+    ring.fence();
+    batches.push_back({.index = nextBatch, .fence = gl::Fence()});
+    return nextBatch++;
+  }
+
+  bool StagingUploader::isComplete(uint64_t batch) {
+    while (!batches.empty() && batches.front().fence.signalled()) {
+      batches.pop_front();
+    }
+    return batches.empty() || batches.front().index > batch;
+  }
+} // namespace engine
@@ -0,0 +1,781 @@
+#include "engine/texture/block_compression.hpp"
+
+#include "logger.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+// S3TC formats are extensions, missing from the core profile loader
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#endif
+
+namespace {
+  using engine::texture::bc::Block;
+  using engine::texture::bc::DecodedBlock;
+
+  template <size_t N> using Vec = std::array<float, N>;
+
+  template <size_t N> inline float distanceSq(const Vec<N>& a, const Vec<N>& b) {
+    float sum = 0.0f;
+    for (size_t c = 0; c < N; ++c) {
+      float d = a[c] - b[c];
+      sum += d * d;
+    }
+    return sum;
+  }
+
+  template <size_t N> inline Vec<N> texel(Block texels, size_t i) {
+    Vec<N> v;
+    for (size_t c = 0; c < N; ++c) {
+      v[c] = texels[i * 4 + c];
+    }
+    return v;
+  }
+
+  /// <summary>
+  /// Principal axis of the texels (the direction of most variance), by power
+  /// iteration of the covariance matrix. Endpoints are fitted along it.
+  /// </summary>
+  template <size_t N>
+  void principalAxis(const std::array<Vec<N>, 16>& points, size_t count,
+                     Vec<N>& mean, Vec<N>& axis) {
+    mean.fill(0.0f);
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t c = 0; c < N; ++c) {
+        mean[c] += points[i][c];
+      }
+    }
+    for (auto& m : mean) {
+      m /= static_cast<float>(count);
+    }
+
+    std::array<Vec<N>, N> covariance{};
+    for (size_t i = 0; i < count; ++i) {
+      for (size_t r = 0; r < N; ++r) {
+        for (size_t c = 0; c < N; ++c) {
+          covariance[r][c] +=
+              (points[i][r] - mean[r]) * (points[i][c] - mean[c]);
+        }
+      }
+    }
+
+    axis.fill(1.0f);
+    for (int iteration = 0; iteration < 8; ++iteration) {
+      Vec<N> next{};
+      for (size_t r = 0; r < N; ++r) {
+        for (size_t c = 0; c < N; ++c) {
+          next[r] += covariance[r][c] * axis[c];
+        }
+      }
+
+      float length = std::sqrt(distanceSq(next, Vec<N>{}));
+      if (length < 1e-6f) {
+        break;
+      }
+      for (size_t c = 0; c < N; ++c) {
+        axis[c] = next[c] / length;
+      }
+    }
+  }
+
+  /// <summary>
+  /// End points of the texels projected on their principal axis.
+  /// </summary>
+  template <size_t N>
+  void fitEndpoints(const std::array<Vec<N>, 16>& points, size_t count,
+                    Vec<N>& start, Vec<N>& end) {
+    Vec<N> mean, axis;
+    principalAxis(points, count, mean, axis);
+
+    float minT = std::numeric_limits<float>::max();
+    float maxT = std::numeric_limits<float>::lowest();
+    for (size_t i = 0; i < count; ++i) {
+      float t = 0.0f;
+      for (size_t c = 0; c < N; ++c) {
+        t += (points[i][c] - mean[c]) * axis[c];
+      }
+      minT = std::min(minT, t);
+      maxT = std::max(maxT, t);
+    }
+
+    for (size_t c = 0; c < N; ++c) {
+      start[c] = std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f);
+      end[c] = std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f);
+    }
+  }
+
+  /// <summary>
+  /// Least squares endpoints for the given interpolation weights, minimising
+  /// the error of sum((1 - w) * a + w * b - x)^2. Returns false when the
+  /// system is singular (every texel on one weight).
+  /// </summary>
+  template <size_t N>
+  bool solveEndpoints(const std::array<Vec<N>, 16>& points,
+                      const std::array<float, 16>& weights, size_t count,
+                      Vec<N>& a, Vec<N>& b) {
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    Vec<N> ax{}, bx{};
+    for (size_t i = 0; i < count; ++i) {
+      float wb = weights[i];
+      float wa = 1.0f - wb;
+      aa += wa * wa;
+      ab += wa * wb;
+      bb += wb * wb;
+      for (size_t c = 0; c < N; ++c) {
+        ax[c] += wa * points[i][c];
+        bx[c] += wb * points[i][c];
+      }
+    }
+
+    float determinant = aa * bb - ab * ab;
+    if (std::abs(determinant) < 1e-6f) {
+      return false;
+    }
+
+    float inverse = 1.0f / determinant;
+    for (size_t c = 0; c < N; ++c) {
+      a[c] = std::clamp((ax[c] * bb - bx[c] * ab) * inverse, 0.0f, 255.0f);
+      b[c] = std::clamp((bx[c] * aa - ax[c] * ab) * inverse, 0.0f, 255.0f);
+    }
+    return true;
+  }
+
+  // BC1 colour block
+
+  inline uint16_t packRGB565(const Vec<3>& c) {
+    auto r = static_cast<uint16_t>(std::lround(c[0] * 31.0f / 255.0f));
+    auto g = static_cast<uint16_t>(std::lround(c[1] * 63.0f / 255.0f));
+    auto b = static_cast<uint16_t>(std::lround(c[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+  }
+
+  inline Vec<3> unpackRGB565(uint16_t c) {
+    uint32_t r = (c >> 11) & 31;
+    uint32_t g = (c >> 5) & 63;
+    uint32_t b = c & 31;
+    return {static_cast<float>((r << 3) | (r >> 2)),
+            static_cast<float>((g << 2) | (g >> 4)),
+            static_cast<float>((b << 3) | (b >> 2))};
+  }
+
+  /// <summary>
+  /// The four colours of a BC1 block. Integer interpolation, matching
+  /// decodeBC1.
+  /// </summary>
+  std::array<Vec<3>, 4> colorPalette(uint16_t c0, uint16_t c1,
+                                     bool fourColor) {
+    auto a = unpackRGB565(c0);
+    auto b = unpackRGB565(c1);
+    std::array<Vec<3>, 4> palette{a, b};
+    for (int c = 0; c < 3; ++c) {
+      auto ia = static_cast<int>(a[c]);
+      auto ib = static_cast<int>(b[c]);
+      if (fourColor) {
+        palette[2][c] = static_cast<float>((2 * ia + ib) / 3);
+        palette[3][c] = static_cast<float>((ia + 2 * ib) / 3);
+      } else {
+        palette[2][c] = static_cast<float>((ia + ib) / 2);
+        palette[3][c] = 0.0f;
+      }
+    }
+    return palette;
+  }
+
+  /// <summary>
+  /// Picks the nearest palette entry for each texel. Transparent texels get
+  /// index 3 in three colour mode.
+  /// </summary>
+  float colorIndices(const std::array<Vec<3>, 16>& colors,
+                     const std::array<bool, 16>& transparent,
+                     const std::array<Vec<3>, 4>& palette, bool fourColor,
+                     uint32_t& indices) {
+    float error = 0.0f;
+    indices = 0;
+    int entries = fourColor ? 4 : 3;
+    for (int i = 0; i < 16; ++i) {
+      uint32_t best = 3;
+      if (!transparent[i]) {
+        float bestError = std::numeric_limits<float>::max();
+        for (int p = 0; p < entries; ++p) {
+          float e = distanceSq(colors[i], palette[p]);
+          if (e < bestError) {
+            bestError = e;
+            best = p;
+          }
+        }
+        error += bestError;
+      }
+      indices |= best << (i * 2);
+    }
+    return error;
+  }
+
+  /// <summary>
+  /// Encodes the colour half of a BC1 or BC3 block.
+  /// </summary>
+  /// <param name="allowTransparent">Use three colour mode with transparent
+  /// texels (BC1 only)</param>
+  void encodeColorBlock(Block texels, bool allowTransparent, uint8_t* out) {
+    std::array<Vec<3>, 16> colors;
+    std::array<bool, 16> transparent{};
+    std::array<Vec<3>, 16> opaque;
+    size_t opaqueCount = 0;
+    for (size_t i = 0; i < 16; ++i) {
+      colors[i] = texel<3>(texels, i);
+      transparent[i] = allowTransparent && texels[i * 4 + 3] < 128;
+      if (!transparent[i]) {
+        opaque[opaqueCount++] = colors[i];
+      }
+    }
+
+    bool fourColor = opaqueCount == 16;
+    uint16_t c0 = 0, c1 = 0;
+    uint32_t indices = 0xffffffff;
+
+    if (opaqueCount > 0) {
+      Vec<3> start, end;
+      fitEndpoints(opaque, opaqueCount, start, end);
+
+      // Inset the endpoints, the extremes are rarely both hit exactly
+      for (int c = 0; c < 3; ++c) {
+        float inset = (end[c] - start[c]) / 16.0f;
+        start[c] += inset;
+        end[c] -= inset;
+      }
+
+      auto encode = [&](const Vec<3>& a, const Vec<3>& b, uint16_t& outC0,
+                        uint16_t& outC1, uint32_t& outIndices) {
+        outC0 = packRGB565(a);
+        outC1 = packRGB565(b);
+        // Four colour mode needs c0 > c1, three colour mode c0 <= c1
+        if ((outC0 < outC1) == fourColor) {
+          std::swap(outC0, outC1);
+        }
+        if (fourColor && outC0 == outC1) {
+          // Equal endpoints decode as three colour mode, index 0 is safe
+          outIndices = 0;
+          auto color = unpackRGB565(outC0);
+          float error = 0.0f;
+          for (const auto& c : colors) {
+            error += distanceSq(c, color);
+          }
+          return error;
+        }
+        return colorIndices(colors, transparent,
+                            colorPalette(outC0, outC1, fourColor), fourColor,
+                            outIndices);
+      };
+
+      float error = encode(end, start, c0, c1, indices);
+
+      // One least squares refinement from the chosen indices
+      static constexpr std::array<float, 4> FOUR_WEIGHTS = {0.0f, 1.0f,
+                                                            1.0f / 3.0f,
+                                                            2.0f / 3.0f};
+      static constexpr std::array<float, 4> THREE_WEIGHTS = {0.0f, 1.0f, 0.5f,
+                                                             0.0f};
+      const auto& table = fourColor ? FOUR_WEIGHTS : THREE_WEIGHTS;
+      std::array<float, 16> weights{};
+      size_t n = 0;
+      for (size_t i = 0; i < 16; ++i) {
+        if (!transparent[i]) {
+          weights[n++] = table[(indices >> (i * 2)) & 3];
+        }
+      }
+
+      Vec<3> a, b;
+      if (solveEndpoints(opaque, weights, opaqueCount, a, b)) {
+        uint16_t r0, r1;
+        uint32_t refined;
+        float refinedError = encode(a, b, r0, r1, refined);
+        if (refinedError < error) {
+          c0 = r0;
+          c1 = r1;
+          indices = refined;
+        }
+      }
+    }
+
+    out[0] = static_cast<uint8_t>(c0);
+    out[1] = static_cast<uint8_t>(c0 >> 8);
+    out[2] = static_cast<uint8_t>(c1);
+    out[3] = static_cast<uint8_t>(c1 >> 8);
+    for (int i = 0; i < 4; ++i) {
+      out[4 + i] = static_cast<uint8_t>(indices >> (i * 8));
+    }
+  }
+
+  void decodeColorBlock(const uint8_t* block, bool allowThreeColor,
+                        DecodedBlock texels) {
+    auto c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+    auto c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+    uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) |
+                       (static_cast<uint32_t>(block[7]) << 24);
+
+    bool fourColor = c0 > c1 || !allowThreeColor;
+    auto palette = colorPalette(c0, c1, fourColor);
+    for (int i = 0; i < 16; ++i) {
+      uint32_t index = (indices >> (i * 2)) & 3;
+      for (int c = 0; c < 3; ++c) {
+        texels[i * 4 + c] = static_cast<uint8_t>(palette[index][c]);
+      }
+      texels[i * 4 + 3] = !fourColor && index == 3 ? 0 : 255;
+    }
+  }
+
+  // BC4 single channel block
+
+  std::array<int, 8> alphaPalette(int a0, int a1) {
+    std::array<int, 8> palette{a0, a1};
+    if (a0 > a1) {
+      for (int i = 1; i < 7; ++i) {
+        palette[i + 1] = ((7 - i) * a0 + i * a1) / 7;
+      }
+    } else {
+      for (int i = 1; i < 5; ++i) {
+        palette[i + 1] = ((5 - i) * a0 + i * a1) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 255;
+    }
+    return palette;
+  }
+
+  int alphaIndices(std::span<const uint8_t, 16> values, int a0, int a1,
+                   uint64_t& indices) {
+    auto palette = alphaPalette(a0, a1);
+    int error = 0;
+    indices = 0;
+    for (int i = 0; i < 16; ++i) {
+      int best = 0;
+      int bestError = std::numeric_limits<int>::max();
+      for (int p = 0; p < 8; ++p) {
+        int e = std::abs(palette[p] - values[i]);
+        if (e < bestError) {
+          bestError = e;
+          best = p;
+        }
+      }
+      error += bestError * bestError;
+      indices |= static_cast<uint64_t>(best) << (i * 3);
+    }
+    return error;
+  }
+
+  // BC7 mode 6
+
+  constexpr std::array<int, 16> BC7_WEIGHTS = {0,  4,  9,  13, 17, 21, 26, 30,
+                                               34, 38, 43, 47, 51, 55, 60, 64};
+
+  inline int bc7Interpolate(int a, int b, int weight) {
+    return ((64 - weight) * a + weight * b + 32) >> 6;
+  }
+
+  struct Mode6Endpoints {
+    std::array<int, 4> a;
+    std::array<int, 4> b;
+    int pA;
+    int pB;
+  };
+
+  /// <summary>
+  /// Quantises an 8 bit endpoint to 7 bits plus the given p-bit.
+  /// </summary>
+  inline int quantizeMode6(float value, int p) {
+    int q = static_cast<int>(std::lround((value - p) / 2.0f));
+    return (std::clamp(q, 0, 127) << 1) | p;
+  }
+
+  float mode6Indices(const std::array<Vec<4>, 16>& points,
+                     const Mode6Endpoints& endpoints,
+                     std::array<uint8_t, 16>& indices) {
+    std::array<Vec<4>, 16> palette;
+    for (int w = 0; w < 16; ++w) {
+      for (int c = 0; c < 4; ++c) {
+        palette[w][c] = static_cast<float>(bc7Interpolate(
+            endpoints.a[c], endpoints.b[c], BC7_WEIGHTS[w]));
+      }
+    }
+
+    float error = 0.0f;
+    for (int i = 0; i < 16; ++i) {
+      float bestError = std::numeric_limits<float>::max();
+      for (int w = 0; w < 16; ++w) {
+        float e = distanceSq(points[i], palette[w]);
+        if (e < bestError) {
+          bestError = e;
+          indices[i] = static_cast<uint8_t>(w);
+        }
+      }
+      error += bestError;
+    }
+    return error;
+  }
+
+  /// <summary>
+  /// Quantises the endpoints with each p-bit pair and keeps the best.
+  /// </summary>
+  float quantizeMode6Endpoints(const std::array<Vec<4>, 16>& points,
+                               const Vec<4>& start, const Vec<4>& end,
+                               Mode6Endpoints& best,
+                               std::array<uint8_t, 16>& bestIndices) {
+    float bestError = std::numeric_limits<float>::max();
+    for (int p = 0; p < 4; ++p) {
+      Mode6Endpoints endpoints{.pA = p & 1, .pB = p >> 1};
+      for (int c = 0; c < 4; ++c) {
+        endpoints.a[c] = quantizeMode6(start[c], endpoints.pA);
+        endpoints.b[c] = quantizeMode6(end[c], endpoints.pB);
+      }
+
+      std::array<uint8_t, 16> indices;
+      float error = mode6Indices(points, endpoints, indices);
+      if (error < bestError) {
+        bestError = error;
+        best = endpoints;
+        bestIndices = indices;
+      }
+    }
+    return bestError;
+  }
+
+  class BitWriter {
+    uint8_t* out;
+    uint32_t bit = 0;
+
+  public:
+    explicit BitWriter(uint8_t* out) : out(out) { std::fill_n(out, 16, 0); }
+
+    void write(uint32_t value, uint32_t bits) {
+      for (uint32_t i = 0; i < bits; ++i, ++bit) {
+        out[bit >> 3] |= static_cast<uint8_t>(((value >> i) & 1)
+                                              << (bit & 7));
+      }
+    }
+  };
+
+  class BitReader {
+    const uint8_t* in;
+    uint32_t bit = 0;
+
+  public:
+    explicit BitReader(const uint8_t* in) : in(in) {}
+
+    uint32_t read(uint32_t bits) {
+      uint32_t value = 0;
+      for (uint32_t i = 0; i < bits; ++i, ++bit) {
+        value |= ((in[bit >> 3] >> (bit & 7)) & 1u) << i;
+      }
+      return value;
+    }
+  };
+} // namespace
+
+namespace engine::texture {
+  GLenum glInternalFormat(BlockFormat format, bool srgb) {
+    switch (format) {
+    case BlockFormat::BC1:
+      return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT
+                  : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+    case BlockFormat::BC3:
+      return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                  : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case BlockFormat::BC5:
+      return GL_COMPRESSED_RG_RGTC2;
+    case BlockFormat::BC7:
+      return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM
+                  : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+    return GL_INVALID_ENUM;
+  }
+
+  namespace bc {
+    void encodeBC1(Block texels, uint8_t* out) {
+      encodeColorBlock(texels, true, out);
+    }
+
+    void encodeBC3(Block texels, uint8_t* out) {
+      std::array<uint8_t, 16> alpha;
+      for (size_t i = 0; i < 16; ++i) {
+        alpha[i] = texels[i * 4 + 3];
+      }
+      encodeBC4(alpha, out);
+      encodeColorBlock(texels, false, out + 8);
+    }
+
+    void encodeBC5(Block texels, uint8_t* out) {
+      std::array<uint8_t, 16> channel;
+      for (size_t c = 0; c < 2; ++c) {
+        for (size_t i = 0; i < 16; ++i) {
+          channel[i] = texels[i * 4 + c];
+        }
+        encodeBC4(channel, out + c * 8);
+      }
+    }
+
+    void encodeBC4(std::span<const uint8_t, 16> values, uint8_t* out) {
+      // Eight value mode over the full range
+      auto [minIt, maxIt] = std::minmax_element(values.begin(), values.end());
+      int a0 = *maxIt;
+      int a1 = *minIt;
+      uint64_t indices;
+      int error = alphaIndices(values, a0, a1, indices);
+
+      // Six value mode over the values other than 0 and 255, which it has
+      // exactly
+      int innerMin = 255, innerMax = 0;
+      for (auto v : values) {
+        if (v != 0 && v != 255) {
+          innerMin = std::min<int>(innerMin, v);
+          innerMax = std::max<int>(innerMax, v);
+        }
+      }
+      if (innerMin <= innerMax && error > 0) {
+        uint64_t sixIndices;
+        int sixError = alphaIndices(values, innerMin, innerMax, sixIndices);
+        if (sixError < error) {
+          a0 = innerMin;
+          a1 = innerMax;
+          indices = sixIndices;
+        }
+      }
+
+      out[0] = static_cast<uint8_t>(a0);
+      out[1] = static_cast<uint8_t>(a1);
+      for (int i = 0; i < 6; ++i) {
+        out[2 + i] = static_cast<uint8_t>(indices >> (i * 8));
+      }
+    }
+
+    void encodeBC7(Block texels, uint8_t* out) {
+      std::array<Vec<4>, 16> points;
+      for (size_t i = 0; i < 16; ++i) {
+        points[i] = texel<4>(texels, i);
+      }
+
+      Vec<4> start, end;
+      fitEndpoints(points, 16, start, end);
+
+      Mode6Endpoints endpoints;
+      std::array<uint8_t, 16> indices;
+      float error =
+          quantizeMode6Endpoints(points, start, end, endpoints, indices);
+
+      // One least squares refinement from the chosen indices
+      std::array<float, 16> weights;
+      for (size_t i = 0; i < 16; ++i) {
+        weights[i] = BC7_WEIGHTS[indices[i]] / 64.0f;
+      }
+      Vec<4> a, b;
+      if (error > 0.0f && solveEndpoints(points, weights, 16, a, b)) {
+        Mode6Endpoints refined;
+        std::array<uint8_t, 16> refinedIndices;
+        if (quantizeMode6Endpoints(points, a, b, refined, refinedIndices) <
+            error) {
+          endpoints = refined;
+          indices = refinedIndices;
+        }
+      }
+
+      // The anchor (first) index is stored without its top bit
+      if (indices[0] & 8) {
+        std::swap(endpoints.a, endpoints.b);
+        std::swap(endpoints.pA, endpoints.pB);
+        for (auto& index : indices) {
+          index = static_cast<uint8_t>(15 - index);
+        }
+      }
+
+      BitWriter writer(out);
+      writer.write(1 << 6, 7);
+      for (int c = 0; c < 4; ++c) {
+        writer.write(endpoints.a[c] >> 1, 7);
+        writer.write(endpoints.b[c] >> 1, 7);
+      }
+      writer.write(endpoints.pA, 1);
+      writer.write(endpoints.pB, 1);
+      writer.write(indices[0], 3);
+      for (size_t i = 1; i < 16; ++i) {
+        writer.write(indices[i], 4);
+      }
+    }
+
+    void decodeBC1(const uint8_t* block, DecodedBlock texels) {
+      decodeColorBlock(block, true, texels);
+    }
+
+    void decodeBC3(const uint8_t* block, DecodedBlock texels) {
+      decodeColorBlock(block + 8, false, texels);
+      std::array<uint8_t, 16> alpha;
+      decodeBC4(block, alpha);
+      for (size_t i = 0; i < 16; ++i) {
+        texels[i * 4 + 3] = alpha[i];
+      }
+    }
+
+    void decodeBC4(const uint8_t* block, std::span<uint8_t, 16> values) {
+      auto palette = alphaPalette(block[0], block[1]);
+      uint64_t indices = 0;
+      for (int i = 0; i < 6; ++i) {
+        indices |= static_cast<uint64_t>(block[2 + i]) << (i * 8);
+      }
+      for (int i = 0; i < 16; ++i) {
+        values[i] = static_cast<uint8_t>(palette[(indices >> (i * 3)) & 7]);
+      }
+    }
+
+    void decodeBC5(const uint8_t* block, DecodedBlock texels) {
+      std::array<uint8_t, 16> channel;
+      for (size_t c = 0; c < 2; ++c) {
+        decodeBC4(block + c * 8, channel);
+        for (size_t i = 0; i < 16; ++i) {
+          texels[i * 4 + c] = channel[i];
+        }
+      }
+      for (size_t i = 0; i < 16; ++i) {
+        texels[i * 4 + 2] = 0;
+        texels[i * 4 + 3] = 255;
+      }
+    }
+
+    bool decodeBC7(const uint8_t* block, DecodedBlock texels) {
+      BitReader reader(block);
+      if (reader.read(7) != 1 << 6) {
+        return false;
+      }
+
+      std::array<int, 4> a, b;
+      for (int c = 0; c < 4; ++c) {
+        a[c] = static_cast<int>(reader.read(7)) << 1;
+        b[c] = static_cast<int>(reader.read(7)) << 1;
+      }
+      int pA = static_cast<int>(reader.read(1));
+      int pB = static_cast<int>(reader.read(1));
+      for (int c = 0; c < 4; ++c) {
+        a[c] |= pA;
+        b[c] |= pB;
+      }
+
+      for (size_t i = 0; i < 16; ++i) {
+        uint32_t index = reader.read(i == 0 ? 3 : 4);
+        for (int c = 0; c < 4; ++c) {
+          texels[i * 4 + c] = static_cast<uint8_t>(
+              bc7Interpolate(a[c], b[c], BC7_WEIGHTS[index]));
+        }
+      }
+      return true;
+    }
+  } // namespace bc
+
+  std::expected<std::vector<uint8_t>, std::string>
+  compress(std::span<const uint8_t> rgba, glm::ivec2 size, BlockFormat format,
+           ThreadPool& pool) {
+    std::vector<uint8_t> blocks(surfaceBytes(format, size));
+    if (size.x <= 0 || size.y <= 0) {
+      return blocks;
+    }
+    if (rgba.size() < static_cast<size_t>(size.x) * size.y * 4) {
+      return std::unexpected("Compressing " + std::to_string(size.x) + "x" +
+                             std::to_string(size.y) + " texels from " +
+                             std::to_string(rgba.size()) + " bytes");
+    }
+
+    auto encode = [format](Block texels, uint8_t* out) {
+      switch (format) {
+      case BlockFormat::BC1:
+        return bc::encodeBC1(texels, out);
+      case BlockFormat::BC3:
+        return bc::encodeBC3(texels, out);
+      case BlockFormat::BC5:
+        return bc::encodeBC5(texels, out);
+      case BlockFormat::BC7:
+        return bc::encodeBC7(texels, out);
+      }
+    };
+
+    size_t blocksX = (static_cast<size_t>(size.x) + 3) / 4;
+    size_t blocksY = (static_cast<size_t>(size.y) + 3) / 4;
+    size_t bytes = blockBytes(format);
+
+    pool.parallelFor(blocksY, 4, [&](size_t begin, size_t end) {
+      std::array<uint8_t, 64> texels;
+      for (size_t by = begin; by < end; ++by) {
+        for (size_t bx = 0; bx < blocksX; ++bx) {
+          for (size_t y = 0; y < 4; ++y) {
+            size_t sy = std::min(by * 4 + y, static_cast<size_t>(size.y) - 1);
+            for (size_t x = 0; x < 4; ++x) {
+              size_t sx =
+                  std::min(bx * 4 + x, static_cast<size_t>(size.x) - 1);
+              std::copy_n(&rgba[(sy * size.x + sx) * 4], 4,
+                          &texels[(y * 4 + x) * 4]);
+            }
+          }
+          encode(texels, &blocks[(by * blocksX + bx) * bytes]);
+        }
+      }
+    });
+
+    return blocks;
+  }
+
+  std::vector<uint8_t> decompress(std::span<const uint8_t> blocks,
+                                  glm::ivec2 size, BlockFormat format) {
+    std::vector<uint8_t> rgba(static_cast<size_t>(std::max(size.x, 0)) *
+                              std::max(size.y, 0) * 4);
+    if (blocks.size() < surfaceBytes(format, size)) {
+      engine::Logger::error("Decompressing {}x{} texels from {} bytes", size.x,
+                            size.y, blocks.size());
+      return rgba;
+    }
+
+    size_t blocksX = (static_cast<size_t>(size.x) + 3) / 4;
+    size_t blocksY = (static_cast<size_t>(size.y) + 3) / 4;
+    size_t bytes = blockBytes(format);
+
+    std::array<uint8_t, 64> texels;
+    for (size_t by = 0; by < blocksY; ++by) {
+      for (size_t bx = 0; bx < blocksX; ++bx) {
+        const uint8_t* block = &blocks[(by * blocksX + bx) * bytes];
+        switch (format) {
+        case BlockFormat::BC1:
+          bc::decodeBC1(block, texels);
+          break;
+        case BlockFormat::BC3:
+          bc::decodeBC3(block, texels);
+          break;
+        case BlockFormat::BC5:
+          bc::decodeBC5(block, texels);
+          break;
+        case BlockFormat::BC7:
+          if (!bc::decodeBC7(block, texels)) {
+            texels.fill(0);
+          }
+          break;
+        }
+
+        for (size_t y = 0; y < 4 && by * 4 + y < static_cast<size_t>(size.y);
+             ++y) {
+          for (size_t x = 0;
+               x < 4 && bx * 4 + x < static_cast<size_t>(size.x); ++x) {
+            std::copy_n(&texels[(y * 4 + x) * 4], 4,
+                        &rgba[((by * 4 + y) * size.x + bx * 4 + x) * 4]);
+          }
+        }
+      }
+    }
+    return rgba;
+  }
+} // namespace engine::texture
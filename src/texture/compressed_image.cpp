@@ -0,0 +1,122 @@
+#include "engine/texture/compressed_image.hpp"
+
+#include "logger.hpp"
+
+namespace engine::texture {
+  std::expected<CompressedImage, std::string>
+  CompressedImage::encode(std::span<const uint8_t> rgba, glm::ivec2 size,
+                          BlockFormat format, bool srgb, bool mipmaps,
+                          ThreadPool& pool) {
+    CompressedImage image{.format = format, .srgb = srgb};
+    if (size.x <= 0 || size.y <= 0) {
+      return image;
+    }
+
+    auto blocks = compress(rgba, size, format, pool);
+    if (!blocks) {
+      return std::unexpected(blocks.error());
+    }
+    image.levels.push_back({.dimensions = size, .data = std::move(*blocks)});
+
+    if (mipmaps) {
+      // Normal maps (BC5) are linear whatever the flag says
+      MipSettings settings{.srgb = srgb && format != BlockFormat::BC5};
+      for (auto& level : generateMips(rgba, size, 4, settings, pool)) {
+        auto levelBlocks =
+            compress(level.data, level.dimensions, format, pool);
+        if (!levelBlocks) {
+          return std::unexpected(levelBlocks.error());
+        }
+        image.levels.push_back({
+            .dimensions = level.dimensions,
+            .data = std::move(*levelBlocks),
+        });
+      }
+    }
+
+    return image;
+  }
+
+  std::expected<CompressedImage, std::string>
+  CompressedImage::encode(const engine::Image& image, BlockFormat format,
+                          bool srgb, bool mipmaps, ThreadPool& pool) {
+    auto size = image.getDimensions();
+    int channels = image.getChannels();
+    const unsigned char* data = image.getData();
+
+    if (channels == 4) {
+      return encode(std::span(data, static_cast<size_t>(size.x) * size.y * 4),
+                    size, format, srgb, mipmaps, pool);
+    }
+
+    std::vector<uint8_t> rgba(static_cast<size_t>(size.x) * size.y * 4);
+    for (size_t i = 0; i < static_cast<size_t>(size.x) * size.y; ++i) {
+      const unsigned char* in = data + i * channels;
+      uint8_t* out = &rgba[i * 4];
+      switch (channels) {
+      case 1:
+        out[0] = out[1] = out[2] = in[0];
+        out[3] = 255;
+        break;
+      case 2:
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = 0;
+        out[3] = 255;
+        break;
+      default:
+        out[0] = in[0];
+        out[1] = in[1];
+        out[2] = in[2];
+        out[3] = 255;
+        break;
+      }
+    }
+    return encode(rgba, size, format, srgb, mipmaps, pool);
+  }
+
+  size_t CompressedImage::byteSize() const {
+    size_t size = 0;
+    for (const auto& level : levels) {
+      size += level.data.size();
+    }
+    return size;
+  }
+
+  void CompressedImage::uploadLevel(const gl::Texture& texture, size_t level,
+                                    GLint textureLevel,
+                                    UploadRing* ring) const {
+    GLenum internalFormat = glInternalFormat(format, srgb);
+    const auto& data = levels[level];
+    if (ring) {
+      if (auto allocation = ring->stage(data.data)) {
+        ring->uploadCompressed(texture, textureLevel, glm::ivec2(0),
+                               data.dimensions, internalFormat, *allocation);
+        return;
+      }
+    }
+    texture.compressedSubImage(textureLevel, 0, 0, data.dimensions.x,
+                               data.dimensions.y, internalFormat,
+                               static_cast<GLsizei>(data.data.size()),
+                               data.data.data());
+  }
+
+  gl::Texture CompressedImage::toTexture(UploadRing* ring) const {
+    gl::Texture texture{};
+    if (levels.empty()) {
+      engine::Logger::error("Creating a texture from an empty image");
+      return texture;
+    }
+
+    GLenum internalFormat = glInternalFormat(format, srgb);
+    texture.storage(static_cast<GLint>(levels.size()), internalFormat,
+                    levels.front().dimensions);
+    for (size_t i = 0; i < levels.size(); ++i) {
+      uploadLevel(texture, i, static_cast<GLint>(i), ring);
+    }
+    if (ring) {
+      ring->fence();
+    }
+    return texture;
+  }
+} // namespace engine::texture
@@ -0,0 +1,338 @@
+#include "engine/texture/ktx2.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace {
+  using engine::texture::BlockFormat;
+
+  constexpr std::array<uint8_t, 12> IDENTIFIER = {
+      0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+  constexpr size_t HEADER_SIZE = 80;
+  constexpr size_t LEVEL_INDEX_ENTRY_SIZE = 24;
+
+  // VkFormat values
+  constexpr uint32_t VK_FORMAT_BC1_RGB_UNORM_BLOCK = 131;
+  constexpr uint32_t VK_FORMAT_BC1_RGB_SRGB_BLOCK = 132;
+  constexpr uint32_t VK_FORMAT_BC1_RGBA_UNORM_BLOCK = 133;
+  constexpr uint32_t VK_FORMAT_BC1_RGBA_SRGB_BLOCK = 134;
+  constexpr uint32_t VK_FORMAT_BC3_UNORM_BLOCK = 137;
+  constexpr uint32_t VK_FORMAT_BC3_SRGB_BLOCK = 138;
+  constexpr uint32_t VK_FORMAT_BC5_UNORM_BLOCK = 141;
+  constexpr uint32_t VK_FORMAT_BC7_UNORM_BLOCK = 145;
+  constexpr uint32_t VK_FORMAT_BC7_SRGB_BLOCK = 146;
+
+  // Khronos data format descriptor values
+  constexpr uint8_t KHR_DF_MODEL_BC1A = 128;
+  constexpr uint8_t KHR_DF_MODEL_BC3 = 130;
+  constexpr uint8_t KHR_DF_MODEL_BC5 = 132;
+  constexpr uint8_t KHR_DF_MODEL_BC7 = 134;
+  constexpr uint8_t KHR_DF_PRIMARIES_BT709 = 1;
+  constexpr uint8_t KHR_DF_TRANSFER_LINEAR = 1;
+  constexpr uint8_t KHR_DF_TRANSFER_SRGB = 2;
+  constexpr uint8_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+
+  uint32_t vkFormat(BlockFormat format, bool srgb) {
+    switch (format) {
+    case BlockFormat::BC1:
+      return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+                  : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+    case BlockFormat::BC3:
+      return srgb ? VK_FORMAT_BC3_SRGB_BLOCK : VK_FORMAT_BC3_UNORM_BLOCK;
+    case BlockFormat::BC5:
+      return VK_FORMAT_BC5_UNORM_BLOCK;
+    case BlockFormat::BC7:
+      return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+    }
+    return 0;
+  }
+
+  bool fromVkFormat(uint32_t vkFormat, BlockFormat& format, bool& srgb) {
+    switch (vkFormat) {
+    case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+    case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+      format = BlockFormat::BC1;
+      srgb = false;
+      return true;
+    case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+    case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+      format = BlockFormat::BC1;
+      srgb = true;
+      return true;
+    case VK_FORMAT_BC3_UNORM_BLOCK:
+    case VK_FORMAT_BC3_SRGB_BLOCK:
+      format = BlockFormat::BC3;
+      srgb = vkFormat == VK_FORMAT_BC3_SRGB_BLOCK;
+      return true;
+    case VK_FORMAT_BC5_UNORM_BLOCK:
+      format = BlockFormat::BC5;
+      srgb = false;
+      return true;
+    case VK_FORMAT_BC7_UNORM_BLOCK:
+    case VK_FORMAT_BC7_SRGB_BLOCK:
+      format = BlockFormat::BC7;
+      srgb = vkFormat == VK_FORMAT_BC7_SRGB_BLOCK;
+      return true;
+    default:
+      return false;
+    }
+  }
+
+  class ByteWriter {
+    std::vector<uint8_t>& out;
+
+  public:
+    explicit ByteWriter(std::vector<uint8_t>& out) : out(out) {}
+
+    template <typename T> void write(T value) {
+      auto bytes = reinterpret_cast<const uint8_t*>(&value);
+      out.insert(out.end(), bytes, bytes + sizeof(T));
+    }
+
+    void pad(size_t alignment) {
+      out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+    }
+
+    size_t size() const { return out.size(); }
+  };
+
+  template <typename T> T readAt(std::span<const uint8_t> data, size_t offset) {
+    T value;
+    std::memcpy(&value, data.data() + offset, sizeof(T));
+    return value;
+  }
+
+  struct Sample {
+    uint16_t bitOffset;
+    uint8_t bitLength;
+    uint8_t channel;
+  };
+
+  /// <summary>
+  /// Writes the data format descriptor: a single basic descriptor block.
+  /// </summary>
+  void writeDescriptor(ByteWriter& writer, BlockFormat format, bool srgb) {
+    uint8_t model = 0;
+    std::vector<Sample> samples;
+    switch (format) {
+    case BlockFormat::BC1:
+      model = KHR_DF_MODEL_BC1A;
+      samples = {{0, 63, 1}}; // Alpha present
+      break;
+    case BlockFormat::BC3:
+      model = KHR_DF_MODEL_BC3;
+      samples = {{0, 63, 15}, {64, 63, 0}}; // Alpha, colour
+      break;
+    case BlockFormat::BC5:
+      model = KHR_DF_MODEL_BC5;
+      samples = {{0, 63, 0}, {64, 63, 1}}; // Red, green
+      break;
+    case BlockFormat::BC7:
+      model = KHR_DF_MODEL_BC7;
+      samples = {{0, 127, 0}}; // Colour
+      break;
+    }
+
+    auto blockSize = static_cast<uint16_t>(24 + 16 * samples.size());
+    writer.write<uint32_t>(4 + blockSize);
+    writer.write<uint32_t>(0); // Khronos vendor, basic descriptor type
+    writer.write<uint16_t>(2); // Version
+    writer.write<uint16_t>(blockSize);
+    writer.write<uint8_t>(model);
+    writer.write<uint8_t>(KHR_DF_PRIMARIES_BT709);
+    writer.write<uint8_t>(srgb ? KHR_DF_TRANSFER_SRGB
+                               : KHR_DF_TRANSFER_LINEAR);
+    writer.write<uint8_t>(0); // Straight alpha
+    // Texel block dimensions, minus one
+    writer.write<uint8_t>(3);
+    writer.write<uint8_t>(3);
+    writer.write<uint8_t>(0);
+    writer.write<uint8_t>(0);
+    // Bytes per plane
+    writer.write<uint8_t>(
+        static_cast<uint8_t>(engine::texture::blockBytes(format)));
+    for (int i = 0; i < 7; ++i) {
+      writer.write<uint8_t>(0);
+    }
+
+    for (const auto& sample : samples) {
+      bool alpha = sample.channel == 15 || (model == KHR_DF_MODEL_BC1A &&
+                                            sample.channel == 1);
+      writer.write<uint16_t>(sample.bitOffset);
+      writer.write<uint8_t>(sample.bitLength);
+      writer.write<uint8_t>(
+          sample.channel |
+          (srgb && alpha ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0));
+      writer.write<uint32_t>(0); // Sample position
+      writer.write<uint32_t>(0);
+      writer.write<uint32_t>(0xffffffff);
+    }
+  }
+} // namespace
+
+namespace engine::texture::ktx2 {
+  std::vector<uint8_t> serialize(const CompressedImage& image) {
+    std::vector<uint8_t> out;
+    ByteWriter writer(out);
+    auto levelCount = static_cast<uint32_t>(image.levels.size());
+    auto size = image.getDimensions();
+
+    out.insert(out.end(), IDENTIFIER.begin(), IDENTIFIER.end());
+    writer.write<uint32_t>(vkFormat(image.format, image.srgb));
+    writer.write<uint32_t>(1); // Type size
+    writer.write<uint32_t>(static_cast<uint32_t>(size.x));
+    writer.write<uint32_t>(static_cast<uint32_t>(size.y));
+    writer.write<uint32_t>(0); // Depth
+    writer.write<uint32_t>(0); // Layers
+    writer.write<uint32_t>(1); // Faces
+    writer.write<uint32_t>(levelCount);
+    writer.write<uint32_t>(0); // Supercompression
+
+    // Index, patched once the descriptor and levels are placed
+    size_t indexOffset = writer.size();
+    writer.write<uint32_t>(0); // DFD offset
+    writer.write<uint32_t>(0); // DFD length
+    writer.write<uint32_t>(0); // Key/value offset
+    writer.write<uint32_t>(0); // Key/value length
+    writer.write<uint64_t>(0); // Supercompression global data offset
+    writer.write<uint64_t>(0); // Supercompression global data length
+
+    size_t levelIndexOffset = writer.size();
+    out.resize(out.size() + LEVEL_INDEX_ENTRY_SIZE * levelCount, 0);
+
+    auto dfdOffset = static_cast<uint32_t>(writer.size());
+    writeDescriptor(writer, image.format, image.srgb);
+    auto dfdLength = static_cast<uint32_t>(writer.size() - dfdOffset);
+    std::memcpy(&out[indexOffset], &dfdOffset, sizeof(uint32_t));
+    std::memcpy(&out[indexOffset + 4], &dfdLength, sizeof(uint32_t));
+
+    // Levels are stored smallest first, each aligned to a block
+    for (uint32_t i = levelCount; i-- > 0;) {
+      writer.pad(blockBytes(image.format));
+
+      const auto& data = image.levels[i].data;
+      std::array<uint64_t, 3> entry = {writer.size(), data.size(),
+                                       data.size()};
+      std::memcpy(&out[levelIndexOffset + i * LEVEL_INDEX_ENTRY_SIZE],
+                  entry.data(), LEVEL_INDEX_ENTRY_SIZE);
+      out.insert(out.end(), data.begin(), data.end());
+    }
+
+    return out;
+  }
+
+  std::expected<CompressedImage, std::string>
+  parse(std::span<const uint8_t> data) {
+    if (data.size() < HEADER_SIZE ||
+        !std::equal(IDENTIFIER.begin(), IDENTIFIER.end(), data.begin())) {
+      return std::unexpected("Not a KTX2 file");
+    }
+
+    auto format = readAt<uint32_t>(data, 12);
+    auto width = readAt<uint32_t>(data, 20);
+    auto height = readAt<uint32_t>(data, 24);
+    auto depth = readAt<uint32_t>(data, 28);
+    auto layers = readAt<uint32_t>(data, 32);
+    auto faces = readAt<uint32_t>(data, 36);
+    auto levelCount = readAt<uint32_t>(data, 40);
+    auto supercompression = readAt<uint32_t>(data, 44);
+
+    CompressedImage image;
+    if (!fromVkFormat(format, image.format, image.srgb)) {
+      return std::unexpected("Unsupported KTX2 format: " +
+                             std::to_string(format));
+    }
+    if (supercompression != 0) {
+      return std::unexpected("Supercompressed KTX2 files are not supported");
+    }
+    if (depth > 1 || layers > 1 || faces != 1) {
+      return std::unexpected("Only single 2D KTX2 images are supported");
+    }
+    if (width == 0 || height == 0 || levelCount == 0) {
+      return std::unexpected("KTX2 file has no image data");
+    }
+    constexpr auto MAX_DIMENSION =
+        static_cast<uint32_t>(std::numeric_limits<int>::max());
+    if (width > MAX_DIMENSION || height > MAX_DIMENSION) {
+      return std::unexpected("KTX2 image is too large");
+    }
+    // Also keeps the level shifts below the width of the dimensions
+    if (levelCount > static_cast<uint32_t>(
+                         std::bit_width(std::max(width, height)))) {
+      return std::unexpected("KTX2 file has more levels than its mip chain");
+    }
+    if (data.size() < HEADER_SIZE + LEVEL_INDEX_ENTRY_SIZE * levelCount) {
+      return std::unexpected("KTX2 level index is truncated");
+    }
+
+    image.levels.resize(levelCount);
+    for (uint32_t i = 0; i < levelCount; ++i) {
+      size_t entry = HEADER_SIZE + i * LEVEL_INDEX_ENTRY_SIZE;
+      auto offset = readAt<uint64_t>(data, entry);
+      auto length = readAt<uint64_t>(data, entry + 8);
+
+      glm::ivec2 dimensions(std::max(width >> i, 1u),
+                            std::max(height >> i, 1u));
+      if (length != surfaceBytes(image.format, dimensions)) {
+        return std::unexpected("KTX2 level " + std::to_string(i) +
+                               " has the wrong size");
+      }
+      if (offset > data.size() || length > data.size() - offset) {
+        return std::unexpected("KTX2 level " + std::to_string(i) +
+                               " is out of bounds");
+      }
+
+      auto first = data.begin() + static_cast<ptrdiff_t>(offset);
+      image.levels[i] = {
+          .dimensions = dimensions,
+          .data = std::vector<uint8_t>(
+              first, first + static_cast<ptrdiff_t>(length)),
+      };
+    }
+
+    return image;
+  }
+
+  std::optional<std::string> write(const std::string& path,
+                                   const CompressedImage& image) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+      return "Could not open " + path + " for writing";
+    }
+
+    auto data = serialize(image);
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      return "Failed to write " + path;
+    }
+    return std::nullopt;
+  }
+
+  std::expected<CompressedImage, std::string> read(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+      return std::unexpected("Could not open " + path);
+    }
+
+    auto size = static_cast<size_t>(file.tellg());
+    std::vector<uint8_t> data(size);
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(data.data()),
+              static_cast<std::streamsize>(size));
+    if (!file) {
+      return std::unexpected("Failed to read " + path);
+    }
+
+    auto image = parse(data);
+    if (!image) {
+      return std::unexpected(image.error() + " (" + path + ")");
+    }
+    return image;
+  }
+} // namespace engine::texture::ktx2
@@ -0,0 +1,326 @@
+#include "engine/texture/mip_generator.hpp"
+
+#include "logger.hpp"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE2__) || defined(_M_X64) ||                                    \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENGINE_MIPS_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+  using engine::texture::MipFilter;
+  using engine::texture::MipSettings;
+
+  /// <summary>
+  /// Rows per batch handed to a worker.
+  /// </summary>
+  constexpr size_t ROW_BATCH = 16;
+
+  /// <summary>
+  /// Half width of the Kaiser filter, in output texels.
+  /// </summary>
+  constexpr float KAISER_RADIUS = 1.5f;
+
+  /// <summary>
+  /// Working image, RGBA float per texel whatever the channel count.
+  /// </summary>
+  struct FloatImage {
+    glm::ivec2 size;
+    std::vector<float> texels;
+
+    float* row(int y) { return &texels[static_cast<size_t>(y) * size.x * 4]; }
+    const float* row(int y) const {
+      return &texels[static_cast<size_t>(y) * size.x * 4];
+    }
+  };
+
+  /// <summary>
+  /// Weights of each output texel along one axis, a fixed number of taps
+  /// each. Indices are clamped to the edge.
+  /// </summary>
+  struct AxisFilter {
+    int taps = 0;
+    std::vector<int> indices;
+    std::vector<float> weights;
+  };
+
+  float besselI0(float x) {
+    // Power series, converges quickly for the small arguments used here
+    float sum = 1.0f;
+    float term = 1.0f;
+    float halfX = x * 0.5f;
+    for (int k = 1; k < 32; ++k) {
+      term *= (halfX / k) * (halfX / k);
+      sum += term;
+      if (term < sum * 1e-7f) {
+        break;
+      }
+    }
+    return sum;
+  }
+
+  float kaiserSinc(float x, float alpha) {
+    float ratio = x / KAISER_RADIUS;
+    if (std::abs(ratio) >= 1.0f) {
+      return 0.0f;
+    }
+
+    float sinc = 1.0f;
+    if (std::abs(x) > 1e-6f) {
+      float px = std::numbers::pi_v<float> * x;
+      sinc = std::sin(px) / px;
+    }
+    float window = besselI0(alpha * std::sqrt(1.0f - ratio * ratio)) /
+                   besselI0(alpha);
+    return sinc * window;
+  }
+
+  AxisFilter buildAxisFilter(int source, int destination,
+                             const MipSettings& settings) {
+    float scale = static_cast<float>(source) / destination;
+    bool box = settings.filter == MipFilter::BOX;
+    float radius = box ? scale * 0.5f : KAISER_RADIUS * scale;
+
+    AxisFilter filter;
+    filter.taps = static_cast<int>(std::ceil(radius * 2.0f)) + 1;
+    filter.indices.resize(static_cast<size_t>(destination) * filter.taps);
+    filter.weights.resize(filter.indices.size());
+
+    for (int i = 0; i < destination; ++i) {
+      float centre = (i + 0.5f) * scale;
+      int first = static_cast<int>(std::floor(centre - radius));
+      float total = 0.0f;
+
+      for (int t = 0; t < filter.taps; ++t) {
+        int j = first + t;
+        float weight;
+        if (box) {
+          // Coverage of source texel j by the output texel's footprint
+          float low = std::max(centre - radius, static_cast<float>(j));
+          float high = std::min(centre + radius, static_cast<float>(j + 1));
+          weight = std::max(high - low, 0.0f);
+        } else {
+          weight = kaiserSinc((j + 0.5f - centre) / scale,
+                              settings.kaiserAlpha);
+        }
+
+        size_t slot = static_cast<size_t>(i) * filter.taps + t;
+        filter.indices[slot] = std::clamp(j, 0, source - 1);
+        filter.weights[slot] = weight;
+        total += weight;
+      }
+
+      if (total != 0.0f) {
+        for (int t = 0; t < filter.taps; ++t) {
+          filter.weights[static_cast<size_t>(i) * filter.taps + t] /= total;
+        }
+      }
+    }
+    return filter;
+  }
+
+  /// <summary>
+  /// out += in * weight, for count RGBA texels.
+  /// </summary>
+  inline void accumulate(float* out, const float* in, float weight,
+                         size_t count) {
+#ifdef ENGINE_MIPS_SSE2
+    __m128 w = _mm_set1_ps(weight);
+    for (size_t i = 0; i < count; ++i) {
+      __m128 o = _mm_loadu_ps(out + i * 4);
+      _mm_storeu_ps(out + i * 4,
+                    _mm_add_ps(o, _mm_mul_ps(w, _mm_loadu_ps(in + i * 4))));
+    }
+#else
+    for (size_t i = 0; i < count * 4; ++i) {
+      out[i] += in[i] * weight;
+    }
+#endif
+  }
+
+  /// <summary>
+  /// Filters a level down to the given size, horizontally then vertically.
+  /// </summary>
+  FloatImage downsample(const FloatImage& source, glm::ivec2 size,
+                        const MipSettings& settings,
+                        engine::ThreadPool& pool) {
+    auto horizontal = buildAxisFilter(source.size.x, size.x, settings);
+    auto vertical = buildAxisFilter(source.size.y, size.y, settings);
+
+    FloatImage wide{.size = {size.x, source.size.y}};
+    wide.texels.assign(static_cast<size_t>(size.x) * source.size.y * 4, 0.0f);
+    pool.parallelFor(
+        static_cast<size_t>(source.size.y), ROW_BATCH,
+        [&](size_t begin, size_t end) {
+          for (size_t y = begin; y < end; ++y) {
+            const float* in = source.row(static_cast<int>(y));
+            float* out = wide.row(static_cast<int>(y));
+            for (int x = 0; x < size.x; ++x) {
+              for (int t = 0; t < horizontal.taps; ++t) {
+                size_t slot = static_cast<size_t>(x) * horizontal.taps + t;
+                accumulate(out + x * 4, in + horizontal.indices[slot] * 4,
+                           horizontal.weights[slot], 1);
+              }
+            }
+          }
+        });
+
+    FloatImage result{.size = size};
+    result.texels.assign(static_cast<size_t>(size.x) * size.y * 4, 0.0f);
+    pool.parallelFor(static_cast<size_t>(size.y), ROW_BATCH,
+                     [&](size_t begin, size_t end) {
+                       for (size_t y = begin; y < end; ++y) {
+                         float* out = result.row(static_cast<int>(y));
+                         for (int t = 0; t < vertical.taps; ++t) {
+                           size_t slot = y * vertical.taps + t;
+                           accumulate(out,
+                                      wide.row(vertical.indices[slot]),
+                                      vertical.weights[slot],
+                                      static_cast<size_t>(size.x));
+                         }
+                       }
+                     });
+
+    return result;
+  }
+
+  const std::array<float, 256>& srgbToLinearTable() {
+    static const auto table = [] {
+      std::array<float, 256> t;
+      for (int i = 0; i < 256; ++i) {
+        float c = i / 255.0f;
+        t[i] = c <= 0.04045f ? c / 12.92f
+                             : std::pow((c + 0.055f) / 1.055f, 2.4f);
+      }
+      return t;
+    }();
+    return table;
+  }
+
+  /// <summary>
+  /// Linear to 8 bit sRGB, indexed by linear value * LINEAR_TO_SRGB_SCALE.
+  /// Fine enough that every dark sRGB value is reachable.
+  /// </summary>
+  constexpr int LINEAR_TO_SRGB_SCALE = 1 << 16;
+
+  const std::vector<uint8_t>& linearToSrgbTable() {
+    static const auto table = [] {
+      std::vector<uint8_t> t(LINEAR_TO_SRGB_SCALE + 1);
+      for (int i = 0; i <= LINEAR_TO_SRGB_SCALE; ++i) {
+        float c = static_cast<float>(i) / LINEAR_TO_SRGB_SCALE;
+        float s = c <= 0.0031308f ? c * 12.92f
+                                  : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+        t[i] = static_cast<uint8_t>(std::lround(s * 255.0f));
+      }
+      return t;
+    }();
+    return table;
+  }
+
+  inline int alphaChannel(int channels) {
+    return channels == 2 ? 1 : channels == 4 ? 3 : -1;
+  }
+
+  FloatImage toFloat(std::span<const uint8_t> texels, glm::ivec2 size,
+                     int channels, bool srgb, engine::ThreadPool& pool) {
+    const auto& toLinear = srgbToLinearTable();
+    int alpha = alphaChannel(channels);
+
+    FloatImage image{.size = size};
+    image.texels.assign(static_cast<size_t>(size.x) * size.y * 4, 1.0f);
+    pool.parallelFor(static_cast<size_t>(size.y), ROW_BATCH,
+                     [&](size_t begin, size_t end) {
+                       for (size_t y = begin; y < end; ++y) {
+                         const uint8_t* in =
+                             &texels[y * size.x * channels];
+                         float* out = image.row(static_cast<int>(y));
+                         for (int x = 0; x < size.x; ++x) {
+                           for (int c = 0; c < channels; ++c) {
+                             uint8_t v = in[x * channels + c];
+                             out[x * 4 + c] = srgb && c != alpha
+                                                  ? toLinear[v]
+                                                  : v / 255.0f;
+                           }
+                         }
+                       }
+                     });
+    return image;
+  }
+
+  std::vector<uint8_t> toBytes(const FloatImage& image, int channels,
+                               bool srgb, engine::ThreadPool& pool) {
+    const auto& toSrgb = linearToSrgbTable();
+    int alpha = alphaChannel(channels);
+
+    std::vector<uint8_t> bytes(static_cast<size_t>(image.size.x) *
+                               image.size.y * channels);
+    pool.parallelFor(
+        static_cast<size_t>(image.size.y), ROW_BATCH,
+        [&](size_t begin, size_t end) {
+          for (size_t y = begin; y < end; ++y) {
+            const float* in = image.row(static_cast<int>(y));
+            uint8_t* out = &bytes[y * image.size.x * channels];
+            for (int x = 0; x < image.size.x; ++x) {
+              for (int c = 0; c < channels; ++c) {
+                // Kaiser lobes can overshoot
+                float v = std::clamp(in[x * 4 + c], 0.0f, 1.0f);
+                out[x * channels + c] =
+                    srgb && c != alpha
+                        ? toSrgb[static_cast<size_t>(
+                              v * LINEAR_TO_SRGB_SCALE + 0.5f)]
+                        : static_cast<uint8_t>(v * 255.0f + 0.5f);
+              }
+            }
+          }
+        });
+    return bytes;
+  }
+} // namespace
+
+namespace engine::texture {
+  std::vector<MipLevel> generateMips(std::span<const uint8_t> texels,
+                                     glm::ivec2 size, int channels,
+                                     const MipSettings& settings,
+                                     ThreadPool& pool) {
+    std::vector<MipLevel> levels;
+    if (size.x <= 0 || size.y <= 0 || channels < 1 || channels > 4) {
+      engine::Logger::error("Cannot generate mips of a {}x{} image with {} "
+                            "channels",
+                            size.x, size.y, channels);
+      return levels;
+    }
+#ifndef NDEBUG
+    if (texels.size() < static_cast<size_t>(size.x) * size.y * channels) {
+      engine::Logger::error("Generating mips of {}x{} texels from {} bytes",
+                            size.x, size.y, texels.size());
+      return levels;
+    }
+#endif
+
+    int fullChain = static_cast<int>(std::floor(std::log2(
+        static_cast<float>(std::max(size.x, size.y)))));
+    int count = settings.levels < 0 ? fullChain
+                                    : std::min(settings.levels, fullChain);
+    if (count == 0) {
+      return levels;
+    }
+
+    auto level = toFloat(texels, size, channels, settings.srgb, pool);
+    levels.reserve(count);
+    for (int i = 0; i < count; ++i) {
+      glm::ivec2 half(std::max(level.size.x / 2, 1),
+                      std::max(level.size.y / 2, 1));
+      level = downsample(level, half, settings, pool);
+      levels.push_back({
+          .dimensions = half,
+          .data = toBytes(level, channels, settings.srgb, pool),
+      });
+    }
+    return levels;
+  }
+} // namespace engine::texture
@@ -0,0 +1,244 @@
+#include "engine/texture/texture_atlas.hpp"
+
+#include "engine/texture/mip_generator.hpp"
+#include "logger.hpp"
+#include <algorithm>
+#include <limits>
+
+namespace {
+  /// <summary>
+  /// Copies an image into an RGBA buffer of the given size, with the image
+  /// at offset and its edge texels repeated over the padding around it.
+  /// </summary>
+  std::vector<uint8_t> padToRgba(const engine::Image& image, glm::ivec2 size,
+                                 int offset) {
+    auto dimensions = image.getDimensions();
+    int channels = image.getChannels();
+    const unsigned char* data = image.getData();
+
+    std::vector<uint8_t> rgba(static_cast<size_t>(size.x) * size.y * 4);
+    for (int y = 0; y < size.y; ++y) {
+      int sy = std::clamp(y - offset, 0, dimensions.y - 1);
+      for (int x = 0; x < size.x; ++x) {
+        int sx = std::clamp(x - offset, 0, dimensions.x - 1);
+        const unsigned char* in =
+            data + (static_cast<size_t>(sy) * dimensions.x + sx) * channels;
+        uint8_t* out = &rgba[(static_cast<size_t>(y) * size.x + x) * 4];
+        switch (channels) {
+        case 1:
+          out[0] = out[1] = out[2] = in[0];
+          out[3] = 255;
+          break;
+        case 2:
+          out[0] = in[0];
+          out[1] = in[1];
+          out[2] = 0;
+          out[3] = 255;
+          break;
+        case 3:
+          out[0] = in[0];
+          out[1] = in[1];
+          out[2] = in[2];
+          out[3] = 255;
+          break;
+        default:
+          std::copy_n(in, 4, out);
+          break;
+        }
+      }
+    }
+    return rgba;
+  }
+
+  int roundUp(int value, int alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+  }
+} // namespace
+
+namespace engine::texture {
+  SkylinePacker::SkylinePacker(glm::ivec2 size) : size(size) { clear(); }
+
+  void SkylinePacker::clear() {
+    skyline.assign(1, {.x = 0, .y = 0, .width = size.x});
+    usedArea = 0;
+  }
+
+  std::optional<int> SkylinePacker::restingHeight(size_t index,
+                                                  int width) const {
+    if (skyline[index].x + width > size.x) {
+      return std::nullopt;
+    }
+
+    int height = 0;
+    int remaining = width;
+    for (size_t i = index; remaining > 0; ++i) {
+      height = std::max(height, skyline[i].y);
+      remaining -= skyline[i].width;
+    }
+    return height;
+  }
+
+  std::optional<glm::ivec2> SkylinePacker::insert(glm::ivec2 rect) {
+    if (rect.x <= 0 || rect.y <= 0) {
+      return std::nullopt;
+    }
+
+    size_t best = skyline.size();
+    int bestTop = std::numeric_limits<int>::max();
+    int bestWaste = std::numeric_limits<int>::max();
+    for (size_t i = 0; i < skyline.size(); ++i) {
+      auto y = restingHeight(i, rect.x);
+      if (!y || *y + rect.y > size.y) {
+        continue;
+      }
+
+      // Area left unusable under the rectangle
+      int waste = 0;
+      int remaining = rect.x;
+      for (size_t j = i; remaining > 0; ++j) {
+        int covered = std::min(remaining, skyline[j].width);
+        waste += (*y - skyline[j].y) * covered;
+        remaining -= covered;
+      }
+
+      int top = *y + rect.y;
+      if (top < bestTop || (top == bestTop && waste < bestWaste)) {
+        best = i;
+        bestTop = top;
+        bestWaste = waste;
+      }
+    }
+    if (best == skyline.size()) {
+      return std::nullopt;
+    }
+
+    glm::ivec2 position(skyline[best].x, bestTop - rect.y);
+    Segment placed{.x = position.x, .y = bestTop, .width = rect.x};
+
+    // Cut the segments now under the rectangle
+    size_t next = best;
+    int right = position.x + rect.x;
+    while (next < skyline.size() && skyline[next].x < right) {
+      int end = skyline[next].x + skyline[next].width;
+      if (end <= right) {
+        ++next;
+        continue;
+      }
+      skyline[next].width = end - right;
+      skyline[next].x = right;
+      break;
+    }
+    skyline.erase(skyline.begin() + best, skyline.begin() + next);
+    skyline.insert(skyline.begin() + best, placed);
+
+    // Merge neighbours of equal height
+    for (size_t i = 0; i + 1 < skyline.size();) {
+      if (skyline[i].y == skyline[i + 1].y) {
+        skyline[i].width += skyline[i + 1].width;
+        skyline.erase(skyline.begin() + i + 1);
+      } else {
+        ++i;
+      }
+    }
+
+    usedArea += static_cast<int64_t>(rect.x) * rect.y;
+    return position;
+  }
+
+  TextureAtlas::TextureAtlas(const AtlasSettings& settings)
+      : settings(settings) {}
+
+  gl::TextureArray& TextureAtlas::getArray(size_t channel) {
+    auto& array = arrays[channel];
+    if (!array) {
+      array.emplace();
+      // Diffuse holds colour, the other channels data
+      GLenum format = channel == 0 ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+      array->storage(settings.mipLevels, format,
+                     {settings.layerSize, settings.layerSize,
+                      settings.layers});
+      array->setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+      array->setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      array->setParameter(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      array->setParameter(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+      array->label(channel == 0 ? "Atlas Diffuse"
+                   : channel == 1 ? "Atlas Bump"
+                                  : "Atlas Material");
+      gl::TextureHandle(array->createHandle()).use();
+    }
+    return *array;
+  }
+
+  std::optional<AtlasRegion>
+  TextureAtlas::add(const std::array<const engine::Image*, CHANNELS>& images) {
+    std::optional<glm::ivec2> size;
+    for (const auto* image : images) {
+      if (!image) {
+        continue;
+      }
+      if (size && *size != image->getDimensions()) {
+        return std::nullopt;
+      }
+      size = image->getDimensions();
+    }
+    if (!size || !accepts(*size)) {
+      return std::nullopt;
+    }
+
+    int pad = padding();
+    glm::ivec2 rect(roundUp(size->x + 2 * pad, pad),
+                    roundUp(size->y + 2 * pad, pad));
+
+    std::optional<glm::ivec2> position;
+    uint32_t layer = 0;
+    for (; layer < packers.size() && !position; ++layer) {
+      position = packers[layer].insert(rect);
+    }
+    if (!position) {
+      if (packers.size() >= static_cast<size_t>(settings.layers)) {
+        return std::nullopt;
+      }
+      position = packers.emplace_back(glm::ivec2(settings.layerSize))
+                     .insert(rect);
+      layer = static_cast<uint32_t>(packers.size());
+      if (!position) {
+        packers.pop_back();
+        return std::nullopt;
+      }
+    }
+    --layer;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t channel = 0; channel < CHANNELS; ++channel) {
+      if (!images[channel]) {
+        continue;
+      }
+
+      auto& array = getArray(channel);
+      auto rgba = padToRgba(*images[channel], rect, pad);
+      array.subImage(0, position->x, position->y, static_cast<GLint>(layer),
+                     rect.x, rect.y, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                     rgba.data());
+
+      // Padding and alignment keep every level inside the region
+      MipSettings mipSettings{.srgb = channel == 0,
+                              .levels = settings.mipLevels - 1};
+      auto levels = generateMips(rgba, rect, 4, mipSettings);
+      for (size_t i = 0; i < levels.size(); ++i) {
+        int level = static_cast<int>(i) + 1;
+        array.subImage(level, position->x >> level, position->y >> level,
+                       static_cast<GLint>(layer), levels[i].dimensions.x,
+                       levels[i].dimensions.y, 1, GL_RGBA, GL_UNSIGNED_BYTE,
+                       levels[i].data.data());
+      }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    float layerSize = static_cast<float>(settings.layerSize);
+    return AtlasRegion{
+        .layer = layer,
+        .uvScale = glm::vec2(*size) / layerSize,
+        .uvOffset = glm::vec2(*position + pad) / layerSize,
+    };
+  }
+} // namespace engine::texture
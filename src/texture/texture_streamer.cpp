@@ -0,0 +1,216 @@
+#include "engine/texture/texture_streamer.hpp"
+
+#include "logger.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace engine::texture {
+  TextureStreamer::TextureId
+  TextureStreamer::add(CompressedImage&& image,
+                       HandleCallback onHandleChanged) {
+    auto id = static_cast<TextureId>(textures.size());
+    auto& texture = textures.emplace_back();
+    texture.source = std::move(image);
+    texture.onHandleChanged = std::move(onHandleChanged);
+
+    if (texture.source.levels.empty()) {
+      engine::Logger::error("Streaming texture {} has no levels", id);
+      return id;
+    }
+
+    auto levelCount = static_cast<uint32_t>(texture.source.levels.size());
+    texture.coarseLevel = levelCount - 1;
+    for (uint32_t i = 0; i < levelCount; ++i) {
+      auto size = texture.source.levels[i].dimensions;
+      if (std::max(size.x, size.y) <= settings.coarseSize) {
+        texture.coarseLevel = i;
+        break;
+      }
+    }
+
+    texture.wantedLevel = texture.coarseLevel;
+    texture.lastUsed = frame;
+    texture.resident = true;
+    upload(texture, texture.coarseLevel);
+    if (uploadRing) {
+      uploadRing->fence();
+    }
+    return id;
+  }
+
+  void TextureStreamer::request(TextureId id, float screenSize) {
+#ifndef NDEBUG
+    if (id >= textures.size()) {
+      engine::Logger::error("Requested unknown streamed texture {}", id);
+      return;
+    }
+#endif
+    auto& texture = textures[id];
+    texture.lastUsed = frame;
+    if (texture.source.levels.empty()) {
+      return;
+    }
+
+    // The level whose size matches the texels on screen
+    uint32_t level = 0;
+    if (screenSize > 0.0f) {
+      auto size = texture.source.levels.front().dimensions;
+      float ratio = static_cast<float>(std::max(size.x, size.y)) / screenSize;
+      if (ratio > 1.0f) {
+        level = std::min(static_cast<uint32_t>(std::log2(ratio)),
+                         texture.coarseLevel);
+      }
+    }
+    texture.wantedLevel = std::min(texture.wantedLevel, level);
+  }
+
+  void TextureStreamer::update() {
+    std::vector<TextureId> refinements;
+    for (TextureId id = 0; id < textures.size(); ++id) {
+      auto& texture = textures[id];
+      if (texture.lastUsed == frame) {
+        setResident(texture, true);
+        if (texture.wantedLevel < texture.residentLevel) {
+          refinements.push_back(id);
+        }
+      } else if (texture.resident &&
+                 frame - texture.lastUsed > settings.idleFrames) {
+        if (texture.residentLevel < texture.coarseLevel) {
+          upload(texture, texture.coarseLevel);
+        }
+        setResident(texture, false);
+      }
+    }
+
+    // Largest improvements first
+    std::sort(refinements.begin(), refinements.end(),
+              [&](TextureId a, TextureId b) {
+                const auto& ta = textures[a];
+                const auto& tb = textures[b];
+                return ta.residentLevel - ta.wantedLevel >
+                       tb.residentLevel - tb.wantedLevel;
+              });
+
+    uint32_t uploads = 0;
+    for (auto id : refinements) {
+      if (uploads >= settings.maxUploadsPerFrame) {
+        break;
+      }
+
+      auto& texture = textures[id];
+      size_t extra =
+          levelBytes(texture, texture.wantedLevel) - texture.bytes;
+      if (residentBytes + extra > settings.budget &&
+          !makeRoom(extra, texture)) {
+        continue;
+      }
+
+      upload(texture, texture.wantedLevel);
+      ++uploads;
+    }
+
+    for (auto& texture : textures) {
+      texture.wantedLevel = texture.coarseLevel;
+    }
+    if (uploadRing) {
+      uploadRing->fence();
+    }
+
+    while (!retired.empty() &&
+           retired.front().frame + FRAMES_IN_FLIGHT <= frame) {
+      auto& old = retired.front();
+      if (old.resident) {
+        gl::TextureHandle(old.handle).unuse();
+      }
+      retired.pop_front();
+    }
+
+    ++frame;
+  }
+
+  void TextureStreamer::upload(StreamedTexture& texture, uint32_t level) {
+    const auto& source = texture.source;
+    GLenum internalFormat = glInternalFormat(source.format, source.srgb);
+    auto levelCount = static_cast<uint32_t>(source.levels.size()) - level;
+
+    gl::Texture replacement{};
+    replacement.storage(static_cast<GLint>(levelCount), internalFormat,
+                        source.levels[level].dimensions);
+    for (uint32_t i = 0; i < levelCount; ++i) {
+      source.uploadLevel(replacement, level + i, static_cast<GLint>(i),
+                         uploadRing);
+    }
+    replacement.setParameter(GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    replacement.setParameter(GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    gl::RawTextureHandle handle = replacement.createHandle();
+    if (texture.resident) {
+      gl::TextureHandle(handle).use();
+    }
+
+    if (texture.handle != 0) {
+      retired.push_back({
+          .frame = frame,
+          .texture = std::move(texture.texture),
+          .handle = texture.handle,
+          .resident = texture.resident,
+      });
+    }
+
+    size_t bytes = levelBytes(texture, level);
+    residentBytes = residentBytes - texture.bytes + bytes;
+    texture.bytes = bytes;
+    texture.texture = std::move(replacement);
+    texture.handle = handle;
+    texture.residentLevel = level;
+
+    if (texture.onHandleChanged) {
+      texture.onHandleChanged(handle);
+    }
+  }
+
+  void TextureStreamer::setResident(StreamedTexture& texture, bool resident) {
+    if (texture.resident == resident || texture.handle == 0) {
+      return;
+    }
+
+    gl::TextureHandle handle(texture.handle);
+    if (resident) {
+      handle.use();
+    } else {
+      handle.unuse();
+    }
+    texture.resident = resident;
+  }
+
+  size_t TextureStreamer::levelBytes(const StreamedTexture& texture,
+                                     uint32_t level) const {
+    size_t bytes = 0;
+    for (size_t i = level; i < texture.source.levels.size(); ++i) {
+      bytes += texture.source.levels[i].data.size();
+    }
+    return bytes;
+  }
+
+  bool TextureStreamer::makeRoom(size_t bytes, const StreamedTexture& keep) {
+    std::vector<StreamedTexture*> candidates;
+    for (auto& texture : textures) {
+      if (&texture != &keep && texture.lastUsed != frame &&
+          texture.residentLevel < texture.coarseLevel) {
+        candidates.push_back(&texture);
+      }
+    }
+    std::sort(candidates.begin(), candidates.end(),
+              [](const StreamedTexture* a, const StreamedTexture* b) {
+                return a->lastUsed < b->lastUsed;
+              });
+
+    for (auto* texture : candidates) {
+      if (residentBytes + bytes <= settings.budget) {
+        break;
+      }
+      upload(*texture, texture->coarseLevel);
+    }
+    return residentBytes + bytes <= settings.budget;
+  }
+} // namespace engine::texture
@@ -0,0 +1,139 @@
+#include "engine/texture/upload_ring.hpp"
+
+#include "logger.hpp"
+#include <cstring>
+
+namespace engine::texture {
+  UploadRing::UploadRing(GLuint capacity)
+      : buffer({capacity, nullptr,
+                gl::Buffer::Usage::WRITE | gl::Buffer::Usage::PERSISTENT |
+                    gl::Buffer::Usage::COHERENT}) {
+    mapping = buffer.map(gl::Buffer::Mapping::COHERENT |
+                         gl::Buffer::Mapping::PERSISTENT |
+                         gl::Buffer::Mapping::WRITE);
+    buffer.label("Texture Upload Ring");
+    base = static_cast<uint8_t*>(mapping.get());
+  }
+
+  std::optional<UploadRing::Allocation> UploadRing::allocate(GLuint bytes,
+                                                             GLuint alignment) {
+    if (bytes > capacity()) {
+      engine::Logger::warn("Upload of {} bytes does not fit the {} byte ring",
+                           bytes, capacity());
+      return std::nullopt;
+    }
+
+    release(false);
+    auto offset = findSpace(bytes, alignment);
+    if (!offset) {
+      ++stalls;
+      // Uploads not yet fenced may be what is in the way
+      fence();
+      do {
+        release(true);
+        offset = findSpace(bytes, alignment);
+      } while (!offset && !segments.empty());
+    }
+    if (!offset) {
+      engine::Logger::error("Upload ring has no space for {} bytes", bytes);
+      return std::nullopt;
+    }
+
+    // Padding, or the end of the ring when wrapping, is consumed too
+    GLuint consumed =
+        *offset >= head ? *offset - head + bytes : capacity() - head + bytes;
+    used += consumed;
+    unfenced += consumed;
+    head = *offset + bytes;
+
+    return Allocation{
+        .data = std::span(base + *offset, bytes),
+        .offset = *offset,
+    };
+  }
+
+  std::optional<UploadRing::Allocation>
+  UploadRing::stage(std::span<const uint8_t> data) {
+    auto allocation = allocate(static_cast<GLuint>(data.size()));
+    if (allocation) {
+      std::memcpy(allocation->data.data(), data.data(), data.size());
+    }
+    return allocation;
+  }
+
+  void UploadRing::upload(const gl::Texture& texture, GLint level,
+                          glm::ivec2 offset, glm::ivec2 size, GLenum format,
+                          GLenum type, const Allocation& allocation) const {
+    buffer.bind(gl::Buffer::BasicTarget::PIXEL_UNPACK);
+    // With an unpack buffer bound, the pointer is an offset into it
+    texture.subImage(level, offset.x, offset.y, size.x, size.y, format, type,
+                     reinterpret_cast<const void*>(
+                         static_cast<uintptr_t>(allocation.offset)));
+    gl::Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  void UploadRing::uploadCompressed(const gl::Texture& texture, GLint level,
+                                    glm::ivec2 offset, glm::ivec2 size,
+                                    GLenum internalFormat,
+                                    const Allocation& allocation) const {
+    buffer.bind(gl::Buffer::BasicTarget::PIXEL_UNPACK);
+    texture.compressedSubImage(
+        level, offset.x, offset.y, size.x, size.y, internalFormat,
+        static_cast<GLsizei>(allocation.data.size()),
+        reinterpret_cast<const void*>(
+            static_cast<uintptr_t>(allocation.offset)));
+    gl::Buffer::unbind(GL_PIXEL_UNPACK_BUFFER);
+  }
+
+  void UploadRing::fence() {
+    if (unfenced == 0) {
+      return;
+    }
+    segments.push_back({.end = head, .bytes = unfenced, .fence = gl::Fence()});
+    unfenced = 0;
+  }
+
+  std::optional<GLuint> UploadRing::findSpace(GLuint bytes,
+                                              GLuint alignment) const {
+    if (used == 0) {
+      return 0;
+    }
+
+    GLuint aligned = gl::Buffer::roundToAlignment(head, alignment);
+    if (head > tail) {
+      // Free space is after the head, then before the tail when wrapping
+      if (aligned + bytes <= capacity()) {
+        return aligned;
+      }
+      if (bytes <= tail) {
+        return 0;
+      }
+      return std::nullopt;
+    }
+
+    // Free space is between the head and the tail, none if the ring is full
+    if (aligned + bytes <= tail) {
+      return aligned;
+    }
+    return std::nullopt;
+  }
+
+  void UploadRing::release(bool wait) {
+    bool block = wait;
+    while (!segments.empty()) {
+      auto& segment = segments.front();
+      if (block ? !segment.fence.wait() : !segment.fence.signalled()) {
+        break;
+      }
+      block = false;
+
+      tail = segment.end;
+      used -= segment.bytes;
+      segments.pop_front();
+    }
+
+    if (used == 0) {
+      head = tail = 0;
+    }
+  }
+} // namespace engine::texture
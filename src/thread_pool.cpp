@@ -0,0 +1,132 @@
+#include "engine/thread_pool.hpp"
+
+#include "engine/cpu_profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+namespace engine {
+  ThreadPool::ThreadPool(unsigned int threadCount) {
+    workers.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; ++i) {
+      workers.emplace_back([this]() { workerLoop(); });
+    }
+  }
+
+  ThreadPool::~ThreadPool() {
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  unsigned int ThreadPool::defaultThreadCount() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 1 ? hardware - 1 : 0;
+  }
+
+  ThreadPool& ThreadPool::global() {
+    static ThreadPool pool;
+    return pool;
+  }
+
+  void ThreadPool::enqueue(std::move_only_function<void()>&& job) {
+    {
+      std::lock_guard lock(mutex);
+      jobs.emplace_back(std::move(job));
+    }
+    condition.notify_one();
+  }
+
+  void ThreadPool::workerLoop() {
+    ENGINE_PROFILE_THREAD("Worker");
+    while (true) {
+      std::move_only_function<void()> job;
+      {
+        std::unique_lock lock(mutex);
+        condition.wait(lock, [this]() { return stopping || !jobs.empty(); });
+        if (stopping && jobs.empty()) {
+          return;
+        }
+        job = std::move(jobs.front());
+        jobs.pop_front();
+      }
+      job();
+    }
+  }
+
+  void ThreadPool::parallelFor(size_t count, size_t minBatchSize,
+                               const std::function<void(size_t, size_t)>& func) {
+    if (count == 0) {
+      return;
+    }
+
+    minBatchSize = std::max<size_t>(minBatchSize, 1);
+    size_t maxBatches = (count + minBatchSize - 1) / minBatchSize;
+    size_t batchCount = std::min<size_t>(maxBatches, workers.size() + 1);
+
+    if (batchCount <= 1) {
+      func(0, count);
+      return;
+    }
+
+    // Shared so that helpers which only get scheduled after every batch is done
+    // still have valid state to look at.
+    struct State {
+      std::atomic<size_t> nextBatch = 0;
+      std::atomic<size_t> finishedBatches = 0;
+      size_t batchCount;
+      size_t batchSize;
+      size_t count;
+      const std::function<void(size_t, size_t)>* func;
+      std::mutex mutex;
+      std::condition_variable done;
+    };
+
+    auto state = std::make_shared<State>();
+    state->batchCount = batchCount;
+    state->batchSize = (count + batchCount - 1) / batchCount;
+    state->count = count;
+    state->func = &func;
+
+    auto runBatches = [](State& s) {
+      while (true) {
+        size_t batch = s.nextBatch.fetch_add(1, std::memory_order_relaxed);
+        if (batch >= s.batchCount) {
+          return;
+        }
+
+        size_t begin = batch * s.batchSize;
+        size_t end = std::min(begin + s.batchSize, s.count);
+        if (begin < end) {
+          ENGINE_PROFILE_ZONE("parallelFor batch");
+          (*s.func)(begin, end);
+        }
+
+        if (s.finishedBatches.fetch_add(1, std::memory_order_acq_rel) + 1 ==
+            s.batchCount) {
+          std::lock_guard lock(s.mutex);
+          s.done.notify_all();
+        }
+      }
+    };
+
+    for (size_t i = 1; i < batchCount; ++i) {
+      enqueue([state, runBatches]() { runBatches(*state); });
+    }
+
+    runBatches(*state);
+
+    // Only wait on batches, not helpers, so nested calls from a worker can
+    // never deadlock on helpers stuck in the queue behind them.
+    std::unique_lock lock(state->mutex);
+    state->done.wait(lock, [&]() {
+      return state->finishedBatches.load(std::memory_order_acquire) ==
+             state->batchCount;
+    });
+  }
+} // namespace engine
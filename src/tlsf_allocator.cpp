@@ -0,0 +1,296 @@
+#include "engine/tlsf_allocator.hpp"
+
+#include "logger.hpp"
+#include <algorithm>
+#include <bit>
+
+namespace {
+  uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+  }
+} // namespace
+
+namespace engine {
+  TlsfAllocator::TlsfAllocator(uint64_t capacity)
+      : totalSize(capacity & ~(GRANULARITY - 1)) {
+    for (auto& lists : freeLists) {
+      lists.fill(NO_BLOCK);
+    }
+
+    if (totalSize == 0) {
+      return;
+    }
+    auto block = newBlock();
+    blocks[block].size = totalSize;
+    lastBlock = block;
+    insertFree(block);
+  }
+
+  void TlsfAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+    if (size < (1ull << FL_SHIFT)) {
+      fl = 0;
+      sl = static_cast<uint32_t>(size >> GRANULARITY_SHIFT);
+      return;
+    }
+    uint32_t bit = static_cast<uint32_t>(std::bit_width(size)) - 1;
+    sl = static_cast<uint32_t>(size >> (bit - SL_BITS)) ^ SL_COUNT;
+    fl = bit - FL_SHIFT + 1;
+  }
+
+  uint32_t TlsfAllocator::newBlock() {
+    if (!unusedBlocks.empty()) {
+      auto block = unusedBlocks.back();
+      unusedBlocks.pop_back();
+      blocks[block] = {};
+      return block;
+    }
+    blocks.emplace_back();
+    return static_cast<uint32_t>(blocks.size() - 1);
+  }
+
+  void TlsfAllocator::insertFree(uint32_t index) {
+    auto& block = blocks[index];
+    uint32_t fl, sl;
+    mapping(block.size, fl, sl);
+
+    auto& head = freeLists[fl][sl];
+    block.free = true;
+    block.prevFree = NO_BLOCK;
+    block.nextFree = head;
+    if (head != NO_BLOCK) {
+      blocks[head].prevFree = index;
+    }
+    head = index;
+    flBitmap |= 1ull << fl;
+    slBitmaps[fl] |= 1u << sl;
+  }
+
+  void TlsfAllocator::removeFree(uint32_t index) {
+    auto& block = blocks[index];
+    uint32_t fl, sl;
+    mapping(block.size, fl, sl);
+
+    if (block.prevFree != NO_BLOCK) {
+      blocks[block.prevFree].nextFree = block.nextFree;
+    } else {
+      freeLists[fl][sl] = block.nextFree;
+      if (block.nextFree == NO_BLOCK) {
+        slBitmaps[fl] &= ~(1u << sl);
+        if (slBitmaps[fl] == 0) {
+          flBitmap &= ~(1ull << fl);
+        }
+      }
+    }
+    if (block.nextFree != NO_BLOCK) {
+      blocks[block.nextFree].prevFree = block.prevFree;
+    }
+    block.free = false;
+    block.prevFree = block.nextFree = NO_BLOCK;
+  }
+
+  uint32_t TlsfAllocator::findFree(uint64_t size) const {
+    // Round up to the next class so any block found is large enough
+    if (size >= (1ull << FL_SHIFT)) {
+      uint32_t bit = static_cast<uint32_t>(std::bit_width(size)) - 1;
+      size += (1ull << (bit - SL_BITS)) - 1;
+    }
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+    if (fl >= FL_COUNT) {
+      return NO_BLOCK;
+    }
+
+    uint32_t slMap = sl < SL_COUNT ? slBitmaps[fl] & (~0u << sl) : 0;
+    if (slMap == 0) {
+      uint64_t flMap =
+          fl + 1 < 64 ? flBitmap & (~0ull << (fl + 1)) : 0;
+      if (flMap == 0) {
+        return NO_BLOCK;
+      }
+      fl = static_cast<uint32_t>(std::countr_zero(flMap));
+      slMap = slBitmaps[fl];
+    }
+    sl = static_cast<uint32_t>(std::countr_zero(slMap));
+    return freeLists[fl][sl];
+  }
+
+  TlsfAllocator::Allocation TlsfAllocator::carve(uint32_t index,
+                                                 uint64_t offset,
+                                                 uint64_t size) {
+    removeFree(index);
+
+    // Space before the allocation becomes a free block of its own
+    uint64_t gap = offset - blocks[index].offset;
+    if (gap > 0) {
+      auto front = newBlock();
+      auto& block = blocks[index];
+      blocks[front].offset = block.offset;
+      blocks[front].size = gap;
+      blocks[front].prevPhysical = block.prevPhysical;
+      blocks[front].nextPhysical = index;
+      if (block.prevPhysical != NO_BLOCK) {
+        blocks[block.prevPhysical].nextPhysical = front;
+      }
+      block.prevPhysical = front;
+      block.offset = offset;
+      block.size -= gap;
+      insertFree(front);
+    }
+
+    // And so does the space after it
+    uint64_t rest = blocks[index].size - size;
+    if (rest > 0) {
+      auto back = newBlock();
+      auto& block = blocks[index];
+      blocks[back].offset = offset + size;
+      blocks[back].size = rest;
+      blocks[back].prevPhysical = index;
+      blocks[back].nextPhysical = block.nextPhysical;
+      if (block.nextPhysical != NO_BLOCK) {
+        blocks[block.nextPhysical].prevPhysical = back;
+      } else {
+        lastBlock = back;
+      }
+      block.nextPhysical = back;
+      block.size = size;
+      insertFree(back);
+    }
+
+    usedBytes += size;
+    ++allocationCount;
+    return {.offset = offset, .size = size, .block = index};
+  }
+
+  std::optional<TlsfAllocator::Allocation>
+  TlsfAllocator::allocate(uint64_t size, uint64_t alignment) {
+#ifndef NDEBUG
+    if (!std::has_single_bit(alignment)) {
+      engine::Logger::error("Allocation alignment {} is not a power of two",
+                            alignment);
+      return std::nullopt;
+    }
+#endif
+    alignment = std::max(alignment, GRANULARITY);
+    size = alignUp(std::max<uint64_t>(size, 1), GRANULARITY);
+
+    // Room to align within whatever block is found
+    auto index = findFree(size + alignment - GRANULARITY);
+    if (index == NO_BLOCK) {
+      return std::nullopt;
+    }
+    return carve(index, alignUp(blocks[index].offset, alignment), size);
+  }
+
+  std::optional<TlsfAllocator::Allocation>
+  TlsfAllocator::allocateBelow(uint64_t size, uint64_t alignment,
+                               uint64_t limit, uint32_t& budget) {
+    alignment = std::max(alignment, GRANULARITY);
+    size = alignUp(std::max<uint64_t>(size, 1), GRANULARITY);
+
+    // Every class from size's own may hold a block that fits
+    uint32_t fl, sl;
+    mapping(size, fl, sl);
+    for (; fl < FL_COUNT && budget > 0; ++fl, sl = 0) {
+      uint32_t slMap =
+          (flBitmap >> fl) & 1 ? slBitmaps[fl] & (~0u << sl) : 0;
+      for (; slMap != 0 && budget > 0; slMap &= slMap - 1) {
+        auto list = static_cast<uint32_t>(std::countr_zero(slMap));
+        for (auto index = freeLists[fl][list];
+             index != NO_BLOCK && budget > 0;
+             index = blocks[index].nextFree) {
+          --budget;
+          const auto& block = blocks[index];
+          uint64_t offset = alignUp(block.offset, alignment);
+          if (offset + size <= block.offset + block.size &&
+              offset + size <= limit) {
+            return carve(index, offset, size);
+          }
+        }
+      }
+    }
+    return std::nullopt;
+  }
+
+  void TlsfAllocator::free(uint32_t index) {
+#ifndef NDEBUG
+    if (index >= blocks.size() || blocks[index].free ||
+        blocks[index].size == 0) {
+      engine::Logger::error("Freeing invalid allocator block {}", index);
+      return;
+    }
+#endif
+    usedBytes -= blocks[index].size;
+    --allocationCount;
+
+    // Merge with free neighbours, keeping the lower block
+    auto prev = blocks[index].prevPhysical;
+    if (prev != NO_BLOCK && blocks[prev].free) {
+      removeFree(prev);
+      blocks[prev].size += blocks[index].size;
+      blocks[prev].nextPhysical = blocks[index].nextPhysical;
+      if (blocks[index].nextPhysical != NO_BLOCK) {
+        blocks[blocks[index].nextPhysical].prevPhysical = prev;
+      } else {
+        lastBlock = prev;
+      }
+      blocks[index].size = 0;
+      unusedBlocks.push_back(index);
+      index = prev;
+    }
+
+    auto next = blocks[index].nextPhysical;
+    if (next != NO_BLOCK && blocks[next].free) {
+      removeFree(next);
+      blocks[index].size += blocks[next].size;
+      blocks[index].nextPhysical = blocks[next].nextPhysical;
+      if (blocks[next].nextPhysical != NO_BLOCK) {
+        blocks[blocks[next].nextPhysical].prevPhysical = index;
+      } else {
+        lastBlock = index;
+      }
+      blocks[next].size = 0;
+      unusedBlocks.push_back(next);
+    }
+
+    insertFree(index);
+  }
+
+  std::optional<TlsfAllocator::Allocation>
+  TlsfAllocator::previousAllocated(uint32_t block) const {
+    auto index = block == NO_BLOCK ? lastBlock : blocks[block].prevPhysical;
+    while (index != NO_BLOCK && blocks[index].free) {
+      index = blocks[index].prevPhysical;
+    }
+    if (index == NO_BLOCK) {
+      return std::nullopt;
+    }
+    return Allocation{.offset = blocks[index].offset,
+                      .size = blocks[index].size,
+                      .block = index};
+  }
+
+  uint64_t TlsfAllocator::getLargestFreeBlock() const {
+    if (flBitmap == 0) {
+      return 0;
+    }
+    // Only the highest non-empty class can hold the largest block
+    uint32_t fl = 63 - static_cast<uint32_t>(std::countl_zero(flBitmap));
+    uint32_t sl = 31 - static_cast<uint32_t>(std::countl_zero(slBitmaps[fl]));
+
+    uint64_t largest = 0;
+    for (auto index = freeLists[fl][sl]; index != NO_BLOCK;
+         index = blocks[index].nextFree) {
+      largest = std::max(largest, blocks[index].size);
+    }
+    return largest;
+  }
+
+  float TlsfAllocator::getFragmentation() const {
+    uint64_t freeBytes = getFreeBytes();
+    if (freeBytes == 0) {
+      return 0.0f;
+    }
+    return 1.0f - static_cast<float>(getLargestFreeBlock()) /
+                      static_cast<float>(freeBytes);
+  }
+} // namespace engine